@@ -0,0 +1,365 @@
+#pragma once
+// asyncwriter.hpp - 异步文件写入器
+// 解码线程只负责投递"创建/写入/关闭"操作，由写线程完成实际的文件I/O，使解码与I/O重叠
+// 条目路径来自归档时用open_at经过safepath::Root打开，不会跟随符号链接写到解压目录之外
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <filesystem>
+#include <utility>
+
+#include "bufferpool.hpp"
+#include "safepath.hpp"
+
+#ifdef _WIN32
+    #include <fstream>
+    #include <chrono>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+class AsyncFileWriter {
+private:
+    enum class OpType { Open, Write, Close };
+
+    struct Op {
+        OpType type;
+        uint64_t handle;
+        std::string path;        // Open使用
+        uint64_t size = 0;       // Open时为预分配大小，Write时为数据长度
+        std::vector<char> data;  // Write使用
+        time_t mtime = 0;        // Close使用，0表示不修改
+#ifndef _WIN32
+        safepath::Root* root = nullptr;  // Open使用，不为空时path是root下的相对路径
+        safepath::Existing existing = safepath::Existing::Replace;
+#endif
+    };
+
+#ifndef _WIN32
+    // 写线程中打开的文件：经过Root打开时由Output管理（提交时才替换已有文件），否则直接持有描述符
+    struct File {
+        std::string path;
+        int fd = -1;
+        safepath::Root* root = nullptr;
+        safepath::Output output;
+
+        File() = default;
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+        File(File&& other) noexcept
+            : path(std::move(other.path)), fd(std::exchange(other.fd, -1)), root(other.root), output(std::move(other.output)) {}
+        File& operator=(File&& other) noexcept {
+            if (this != &other) {
+                if (!root && fd >= 0) ::close(fd);
+                path = std::move(other.path);
+                fd = std::exchange(other.fd, -1);
+                root = other.root;
+                output = std::move(other.output);
+            }
+            return *this;
+        }
+        // 未关闭就被丢弃（写入器析构）时关闭描述符，经过Root打开的文件删除临时文件
+        ~File() {
+            if (!root && fd >= 0) ::close(fd);
+        }
+    };
+#endif
+
+    // 每个写线程有自己的队列，同一文件的操作总是交给同一线程，保证顺序
+    struct Worker {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<Op> ops;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<uint64_t> next_handle_{0};
+    std::atomic<bool> stopping_{false};
+
+    // 已投递但尚未写出的字节数，超过上限时阻塞解码线程（背压）
+    std::mutex pending_mtx_;
+    std::condition_variable pending_cv_;
+    size_t pending_bytes_ = 0;
+    size_t pending_ops_ = 0;
+    size_t max_pending_bytes_;
+
+    std::mutex error_mtx_;
+    std::vector<std::pair<std::string, int>> errors_;
+
+    // 写完的数据块归还到这里，供生产者复用
+    BufferPool<char>* pool_;
+
+public:
+    // threads为0时使用硬件并发数；max_pending_bytes限制在途数据量；pool不为空时写完的数据块归还到池中
+    explicit AsyncFileWriter(unsigned threads = 0, size_t max_pending_bytes = 64 * 1024 * 1024,
+                             BufferPool<char>* pool = nullptr)
+        : max_pending_bytes_(max_pending_bytes), pool_(pool) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back(new Worker());
+        }
+        for (auto& w : workers_) {
+            Worker* worker = w.get();
+            worker->thread = std::thread([this, worker] { run(*worker); });
+        }
+    }
+
+    ~AsyncFileWriter() {
+        wait();
+        stopping_ = true;
+        for (auto& w : workers_) {
+            {
+                // 持锁后再通知，避免工作线程错过唤醒
+                std::lock_guard<std::mutex> lock(w->mtx);
+            }
+            w->cv.notify_all();
+        }
+        for (auto& w : workers_) w->thread.join();
+    }
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    // 创建（截断）文件，size已知时预分配空间；返回文件句柄
+    uint64_t open(const std::string& path, uint64_t size = 0) {
+        Op op;
+        op.type = OpType::Open;
+        op.handle = next_handle_++;
+        op.path = path;
+        op.size = size;
+        uint64_t handle = op.handle;
+        submit(std::move(op));
+        return handle;
+    }
+
+#ifndef _WIN32
+    // 在root之下创建文件，rel为条目的相对路径；已有文件按existing处理（跳过时丢弃写入的数据，不算错误）
+    // root必须在写入器wait()之后才能销毁
+    uint64_t open_at(safepath::Root& root, const std::string& rel, safepath::Existing existing, uint64_t size = 0) {
+        Op op;
+        op.type = OpType::Open;
+        op.handle = next_handle_++;
+        op.path = rel;
+        op.size = size;
+        op.root = &root;
+        op.existing = existing;
+        uint64_t handle = op.handle;
+        submit(std::move(op));
+        return handle;
+    }
+#endif
+
+    // 追加写入一块数据，数据的所有权转移给写线程
+    void write(uint64_t handle, std::vector<char>&& data) {
+        Op op;
+        op.type = OpType::Write;
+        op.handle = handle;
+        op.size = data.size();
+        op.data = std::move(data);
+        submit(std::move(op));
+    }
+
+    // 关闭文件，mtime不为0时设置修改时间
+    void close(uint64_t handle, time_t mtime = 0) {
+        Op op;
+        op.type = OpType::Close;
+        op.handle = handle;
+        op.mtime = mtime;
+        submit(std::move(op));
+    }
+
+    // 等待所有已投递的操作完成
+    void wait() {
+        std::unique_lock<std::mutex> lock(pending_mtx_);
+        pending_cv_.wait(lock, [this] { return pending_ops_ == 0; });
+    }
+
+    // 失败的路径和errno
+    std::vector<std::pair<std::string, int>> errors() {
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        return errors_;
+    }
+
+private:
+    void submit(Op&& op) {
+        {
+            std::unique_lock<std::mutex> lock(pending_mtx_);
+            // 单块数据超过上限时也要放行，否则会永远等待
+            pending_cv_.wait(lock, [this, &op] {
+                return pending_bytes_ == 0 || pending_bytes_ + op.data.size() <= max_pending_bytes_;
+            });
+            pending_bytes_ += op.data.size();
+            ++pending_ops_;
+        }
+        Worker& worker = *workers_[op.handle % workers_.size()];
+        {
+            std::lock_guard<std::mutex> lock(worker.mtx);
+            worker.ops.push_back(std::move(op));
+        }
+        worker.cv.notify_one();
+    }
+
+    void finished(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(pending_mtx_);
+            pending_bytes_ -= bytes;
+            --pending_ops_;
+        }
+        pending_cv_.notify_all();
+    }
+
+    void fail(const std::string& path, int err) {
+        std::lock_guard<std::mutex> lock(error_mtx_);
+        errors_.emplace_back(path, err);
+    }
+
+    void run(Worker& worker) {
+#ifdef _WIN32
+        std::map<uint64_t, std::pair<std::string, std::unique_ptr<std::ofstream>>> files;
+#else
+        std::map<uint64_t, File> files;
+#endif
+        for (;;) {
+            Op op;
+            {
+                std::unique_lock<std::mutex> lock(worker.mtx);
+                worker.cv.wait(lock, [this, &worker] { return stopping_ || !worker.ops.empty(); });
+                if (worker.ops.empty()) return;
+                op = std::move(worker.ops.front());
+                worker.ops.pop_front();
+            }
+
+            size_t bytes = op.data.size();
+            auto it = files.find(op.handle);
+            switch (op.type) {
+                case OpType::Open:
+                    files[op.handle] = open_file(op);
+                    break;
+                case OpType::Write:
+                    if (it != files.end()) write_file(it->second, op.data);
+                    if (pool_) pool_->release(std::move(op.data));
+                    break;
+                case OpType::Close:
+                    if (it != files.end()) {
+                        close_file(it->second, op.mtime);
+                        files.erase(it);
+                    }
+                    break;
+            }
+            finished(bytes);
+        }
+    }
+
+#ifdef _WIN32
+    std::pair<std::string, std::unique_ptr<std::ofstream>> open_file(const Op& op) {
+        const std::string& path = op.path;
+        std::filesystem::path p(path);
+        std::error_code ec;
+        std::filesystem::create_directories(p.parent_path(), ec);
+        std::unique_ptr<std::ofstream> file(new std::ofstream(p, std::ios::binary | std::ios::trunc));
+        if (!file->is_open()) {
+            fail(path, errno);
+            file.reset();
+        }
+        return {path, std::move(file)};
+    }
+
+    void write_file(std::pair<std::string, std::unique_ptr<std::ofstream>>& file, const std::vector<char>& data) {
+        if (!file.second) return;
+        file.second->write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (file.second->fail()) {
+            fail(file.first, errno);
+            file.second.reset();
+        }
+    }
+
+    void close_file(std::pair<std::string, std::unique_ptr<std::ofstream>>& file, time_t mtime) {
+        if (!file.second) return;
+        file.second->close();
+        if (mtime != 0) {
+            std::error_code ec;
+            auto now = std::filesystem::file_time_type::clock::now();
+            auto diff = std::chrono::system_clock::from_time_t(mtime) - std::chrono::system_clock::now();
+            std::filesystem::last_write_time(file.first,
+                now + std::chrono::duration_cast<std::filesystem::file_time_type::duration>(diff), ec);
+        }
+    }
+#else
+    File open_file(const Op& op) {
+        File file;
+        file.path = op.path;
+        file.root = op.root;
+        if (op.root) {
+            file.output = op.root->create(op.path, op.existing);
+            file.fd = file.output.fd();
+            if (!file.output && !file.output.skipped()) fail(op.path, errno);
+        } else {
+            file.fd = ::open(op.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            if (file.fd < 0 && errno == ENOENT) {
+                // 父目录尚未创建时补建后重试
+                std::error_code ec;
+                std::filesystem::create_directories(std::filesystem::path(op.path).parent_path(), ec);
+                file.fd = ::open(op.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            }
+            if (file.fd < 0) fail(op.path, errno);
+        }
+    #ifdef __linux__
+        // 只预留空间不改变文件大小，预分配失败（文件系统不支持等）不影响写入
+        if (file.fd >= 0 && op.size > 0) ::fallocate(file.fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(op.size));
+    #endif
+        return file;
+    }
+
+    void write_file(File& file, const std::vector<char>& data) {
+        if (file.fd < 0) return;
+        const char* ptr = data.data();
+        size_t left = data.size();
+        while (left > 0) {
+            ssize_t n = ::write(file.fd, ptr, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail(file.path, errno);
+                // 经过Root打开的文件在析构时删除临时文件
+                if (file.root) {
+                    file.output = safepath::Output();
+                } else {
+                    ::close(file.fd);
+                }
+                file.fd = -1;
+                return;
+            }
+            ptr += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    void close_file(File& file, time_t mtime) {
+        if (file.fd < 0) return;
+        if (mtime != 0) {
+            struct timespec times[2];
+            times[0].tv_sec = 0;
+            times[0].tv_nsec = UTIME_OMIT;
+            times[1].tv_sec = mtime;
+            times[1].tv_nsec = 0;
+            ::futimens(file.fd, times);
+        }
+        bool ok = file.root ? file.root->commit(file.output) : ::close(file.fd) == 0;
+        if (!ok) fail(file.path, errno);
+        file.fd = -1;
+    }
+#endif
+};
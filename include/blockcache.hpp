@@ -0,0 +1,126 @@
+#pragma once
+// blockcache.hpp - 解码数据块的LRU缓存
+// 随机读取归档条目时，解码得到的数据按固定大小的块缓存，所有读取句柄共享同一个缓存，
+// 回退或重复读取已缓存的范围时不必再次解码。缓存的总字节数有上限，超出时淘汰最久未使用的块。
+// 块以shared_ptr保存：被淘汰的块在读取者仍持有时不会释放，因此复制数据时不需要持锁。
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+class BlockCache {
+public:
+    using Data = std::shared_ptr<const std::vector<char>>;
+
+    struct Stats {
+        size_t capacity = 0;
+        size_t used = 0;        // 缓存的块的总字节数（含每块的键和簿记开销）
+        size_t entries = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    static constexpr size_t kDefaultCapacity = 256u << 20;
+
+    explicit BlockCache(size_t capacity) : capacity_(capacity) {}
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    static BlockCache& global() {
+        static BlockCache cache(kDefaultCapacity);
+        return cache;
+    }
+
+    // 找到时把块移到最近使用的位置，找不到时返回空指针
+    Data get(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = lookup_.find(key);
+        if (it == lookup_.end()) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+    }
+
+    // 放入一块（已存在时替换），大于容量的块不缓存
+    void put(const std::string& key, Data data) {
+        if (!data) return;
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = lookup_.find(key);
+        if (it != lookup_.end()) {
+            used_ -= cost(it->second->first, *it->second->second);
+            lru_.erase(it->second);
+            lookup_.erase(it);
+        }
+        if (cost(key, *data) > capacity_) return;
+        used_ += cost(key, *data);
+        lru_.emplace_front(key, std::move(data));
+        lookup_[key] = lru_.begin();
+        evict_locked();
+    }
+
+    // 缩小容量时立即淘汰多出的块
+    void set_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        capacity_ = capacity;
+        evict_locked();
+    }
+
+    size_t capacity() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return capacity_;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        lru_.clear();
+        lookup_.clear();
+        used_ = 0;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Stats stats;
+        stats.capacity = capacity_;
+        stats.used = used_;
+        stats.entries = lookup_.size();
+        stats.hits = hits_;
+        stats.misses = misses_;
+        return stats;
+    }
+
+private:
+    using Node = std::pair<std::string, Data>;
+
+    static constexpr size_t kEntryOverhead = 128;
+
+    // 很小的块主要占用键和节点的内存，也计入容量
+    static size_t cost(const std::string& key, const std::vector<char>& data) {
+        return data.size() + key.size() + kEntryOverhead;
+    }
+
+    void evict_locked() {
+        while (used_ > capacity_ && !lru_.empty()) {
+            used_ -= cost(lru_.back().first, *lru_.back().second);
+            lookup_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+    mutable std::mutex mtx_;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    std::list<Node> lru_;
+    std::unordered_map<std::string, std::list<Node>::iterator> lookup_;
+};
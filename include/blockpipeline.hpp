@@ -0,0 +1,160 @@
+#pragma once
+// blockpipeline.hpp - 有序的并行块处理流水线
+// 调用线程按顺序读取数据块，工作线程并行处理，写线程按块的原始顺序输出处理结果（类似pigz）。
+// 同时在途的块数有上限，因此内存占用只与线程数和块大小有关，与输入大小无关。
+// 任何一个阶段抛出异常都会停止整个流水线，第一个异常在run()中重新抛出。
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <cstdint>
+#include <cstddef>
+
+template<typename Block>
+class OrderedBlockPipeline {
+public:
+    // 读取下一块，没有更多数据时返回false
+    using Reader = std::function<bool(Block& in)>;
+    // 处理一块：worker为工作线程编号（0到threads-1，可用于线程私有的资源），index为块序号
+    using Worker = std::function<void(unsigned worker, uint64_t index, const Block& in, Block& out)>;
+    // 按序号顺序输出一块
+    using Writer = std::function<void(uint64_t index, const Block& in, Block& out)>;
+
+    // window为同时在途（已读取但未输出）的块数上限，0表示线程数的2倍
+    explicit OrderedBlockPipeline(unsigned threads, size_t window = 0)
+        : threads_(threads == 0 ? 1 : threads), window_(window == 0 ? 2 * static_cast<size_t>(threads_) : window) {}
+
+    OrderedBlockPipeline(const OrderedBlockPipeline&) = delete;
+    OrderedBlockPipeline& operator=(const OrderedBlockPipeline&) = delete;
+
+    unsigned threads() const { return threads_; }
+
+    void run(const Reader& read, const Worker& work, const Writer& write) {
+        std::vector<std::thread> workers;
+        workers.reserve(threads_);
+        for (unsigned i = 0; i < threads_; ++i) {
+            workers.emplace_back([this, i, &work] { work_loop(i, work); });
+        }
+        std::thread writer([this, &write] { write_loop(write); });
+
+        try {
+            read_loop(read);
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            read_done_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto& t : workers) t.join();
+        writer.join();
+        if (error_) std::rethrow_exception(error_);
+    }
+
+private:
+    struct Slot {
+        Block in;
+        Block out;
+        bool done = false;
+    };
+
+    unsigned threads_;
+    size_t window_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::map<uint64_t, Slot> slots_;   // 在途的块，节点地址在插入/删除其他节点时保持不变
+    std::deque<uint64_t> pending_;     // 等待处理的块序号
+    bool read_done_ = false;
+    bool failed_ = false;
+    std::exception_ptr error_;
+
+    void fail(std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!failed_) {
+                failed_ = true;
+                error_ = error;
+            }
+        }
+        cv_.notify_all();
+    }
+
+    void read_loop(const Reader& read) {
+        for (uint64_t index = 0;; ++index) {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return failed_ || slots_.size() < window_; });
+                if (failed_) return;
+            }
+            Block in;
+            if (!read(in)) return;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                slots_[index].in = std::move(in);
+                pending_.push_back(index);
+            }
+            cv_.notify_all();
+        }
+    }
+
+    void work_loop(unsigned worker, const Worker& work) {
+        for (;;) {
+            uint64_t index;
+            Slot* slot;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return failed_ || !pending_.empty() || read_done_; });
+                if (failed_ || pending_.empty()) return;
+                index = pending_.front();
+                pending_.pop_front();
+                slot = &slots_[index];
+            }
+            try {
+                work(worker, index, slot->in, slot->out);
+            } catch (...) {
+                fail(std::current_exception());
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                slot->done = true;
+            }
+            cv_.notify_all();
+        }
+    }
+
+    void write_loop(const Writer& write) {
+        for (uint64_t next = 0;; ++next) {
+            Slot* slot;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this, next] {
+                    auto it = slots_.find(next);
+                    return failed_ || (it != slots_.end() && it->second.done) || (read_done_ && slots_.empty());
+                });
+                if (failed_) return;
+                auto it = slots_.find(next);
+                if (it == slots_.end()) return;  // 已全部输出
+                slot = &it->second;
+            }
+            try {
+                write(next, slot->in, slot->out);
+            } catch (...) {
+                fail(std::current_exception());
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                slots_.erase(next);
+            }
+            cv_.notify_all();
+        }
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+// bufferpool.hpp - 可复用的缓冲区池
+// 解压到内存时反复申请/释放大块缓冲区会带来分配器开销和缺页中断，池中保留用过的缓冲区供下次使用
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+
+template<typename T>
+class BufferPool {
+public:
+    // 统计信息
+    struct Stats {
+        uint64_t hits = 0;      // 从池中取到缓冲区的次数
+        uint64_t misses = 0;    // 池中没有合适的缓冲区、需要新分配的次数
+        uint64_t released = 0;  // 归还的次数
+        uint64_t dropped = 0;   // 归还时因超出上限而直接释放的次数
+        size_t held_bytes = 0;  // 池中当前保留的字节数
+        size_t held_buffers = 0;// 池中当前保留的缓冲区个数
+    };
+
+private:
+    mutable std::mutex mtx_;
+    std::multimap<size_t, std::vector<T>> free_;  // 按容量排序的空闲缓冲区
+    size_t max_bytes_;
+    size_t max_buffers_;
+    Stats stats_;
+
+public:
+    explicit BufferPool(size_t max_bytes = 64 * 1024 * 1024, size_t max_buffers = 64)
+        : max_bytes_(max_bytes), max_buffers_(max_buffers) {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 取一个容量至少为min_capacity的空缓冲区
+    std::vector<T> acquire(size_t min_capacity) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = free_.lower_bound(min_capacity);
+            if (it != free_.end()) {
+                std::vector<T> buf = std::move(it->second);
+                free_.erase(it);
+                stats_.held_bytes -= buf.capacity() * sizeof(T);
+                --stats_.held_buffers;
+                ++stats_.hits;
+                return buf;
+            }
+            ++stats_.misses;
+        }
+        std::vector<T> buf;
+        buf.reserve(min_capacity);
+        return buf;
+    }
+
+    // 归还缓冲区；超出上限时先淘汰池中最小的缓冲区，仍放不下则直接释放
+    void release(std::vector<T>&& buf) {
+        size_t bytes = buf.capacity() * sizeof(T);
+        buf.clear();
+        std::lock_guard<std::mutex> lock(mtx_);
+        ++stats_.released;
+        if (bytes == 0 || bytes > max_bytes_ || max_buffers_ == 0) {
+            ++stats_.dropped;
+            return;
+        }
+        while (!free_.empty() && (stats_.held_bytes + bytes > max_bytes_ || stats_.held_buffers >= max_buffers_)) {
+            auto smallest = free_.begin();
+            stats_.held_bytes -= smallest->second.capacity() * sizeof(T);
+            --stats_.held_buffers;
+            ++stats_.dropped;
+            free_.erase(smallest);
+        }
+        free_.emplace(buf.capacity(), std::move(buf));
+        stats_.held_bytes += bytes;
+        ++stats_.held_buffers;
+    }
+
+    // 释放缓冲区直到保留的字节数不超过max_bytes（优先释放大的）
+    void trim(size_t max_bytes = 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        while (!free_.empty() && stats_.held_bytes > max_bytes) {
+            auto largest = std::prev(free_.end());
+            stats_.held_bytes -= largest->second.capacity() * sizeof(T);
+            --stats_.held_buffers;
+            free_.erase(largest);
+        }
+    }
+
+    void set_limits(size_t max_bytes, size_t max_buffers) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            max_bytes_ = max_bytes;
+            max_buffers_ = max_buffers;
+            while (!free_.empty() && stats_.held_buffers > max_buffers_) {
+                auto smallest = free_.begin();
+                stats_.held_bytes -= smallest->second.capacity() * sizeof(T);
+                --stats_.held_buffers;
+                free_.erase(smallest);
+            }
+        }
+        trim(max_bytes);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return stats_;
+    }
+};
+
+// 每个线程一个缓冲区池，避免线程之间争用；所有线程的池登记在一起，便于汇总统计和统一调整
+template<typename T>
+class ThreadBufferPools {
+private:
+    struct Registry {
+        std::mutex mtx;
+        std::vector<std::weak_ptr<BufferPool<T>>> pools;
+        size_t max_bytes = 64 * 1024 * 1024;
+        size_t max_buffers = 64;
+    };
+
+    static Registry& registry() {
+        static Registry reg;
+        return reg;
+    }
+
+    template<typename Fn>
+    static void for_each(Fn fn) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        for (auto it = reg.pools.begin(); it != reg.pools.end();) {
+            if (auto pool = it->lock()) {
+                fn(*pool);
+                ++it;
+            } else {
+                // 线程已退出，它的池随之释放
+                it = reg.pools.erase(it);
+            }
+        }
+    }
+
+public:
+    // 当前线程的缓冲区池
+    static BufferPool<T>& local() {
+        thread_local std::shared_ptr<BufferPool<T>> pool = [] {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mtx);
+            auto created = std::make_shared<BufferPool<T>>(reg.max_bytes, reg.max_buffers);
+            reg.pools.push_back(created);
+            return created;
+        }();
+        return *pool;
+    }
+
+    // 所有线程的统计之和
+    static typename BufferPool<T>::Stats stats() {
+        typename BufferPool<T>::Stats total;
+        for_each([&total](BufferPool<T>& pool) {
+            auto s = pool.stats();
+            total.hits += s.hits;
+            total.misses += s.misses;
+            total.released += s.released;
+            total.dropped += s.dropped;
+            total.held_bytes += s.held_bytes;
+            total.held_buffers += s.held_buffers;
+        });
+        return total;
+    }
+
+    // 设置每个线程的池的上限（对已有的池和之后新建的池都生效）
+    static void set_limits(size_t max_bytes, size_t max_buffers) {
+        {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mtx);
+            reg.max_bytes = max_bytes;
+            reg.max_buffers = max_buffers;
+        }
+        for_each([max_bytes, max_buffers](BufferPool<T>& pool) { pool.set_limits(max_bytes, max_buffers); });
+    }
+
+    static void trim(size_t max_bytes = 0) {
+        for_each([max_bytes](BufferPool<T>& pool) { pool.trim(max_bytes); });
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+// crc32.hpp - CRC32（IEEE 802.3，与zip/7z/gzip使用的相同）
+// x86上使用PCLMULQDQ进行无进位乘法折叠（运行时检测CPU是否支持），ARMv8上使用CRC32指令，其他情况使用slicing-by-8查表
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define CRC32_X86 1
+    #include <emmintrin.h>
+    #include <smmintrin.h>
+    #include <wmmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+    #define CRC32_ARM 1
+    #include <arm_acle.h>
+#endif
+
+namespace checksum {
+
+namespace detail {
+
+// slicing-by-8的查找表，table[0]为普通的逐字节表
+struct Crc32Table {
+    uint32_t table[8][256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+            table[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+    }
+};
+
+inline const Crc32Table& crc32_table() {
+    static const Crc32Table table;
+    return table;
+}
+
+// crc为取反后的内部状态
+inline uint32_t crc32_software(uint32_t crc, const unsigned char* buf, size_t len) {
+    const auto& t = crc32_table().table;
+    while (len >= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, buf, 4);
+        std::memcpy(&hi, buf + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32_X86
+    #if defined(__GNUC__) || defined(__clang__)
+        #define CRC32_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+    #else
+        #define CRC32_TARGET_CLMUL
+    #endif
+
+// 按Intel白皮书《Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction》的方法：
+// 4路并行把数据折叠到128位，再折叠到64位，最后用Barrett约简得到32位CRC
+// 要求len >= 64且为16的倍数；crc为取反后的内部状态
+CRC32_TARGET_CLMUL inline uint32_t crc32_clmul(uint32_t crc, const unsigned char* buf, size_t len) {
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    buf += 64;
+    len -= 64;
+
+    // 4路并行折叠
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // 折叠到128位
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // 剩余的16字节块
+    while (len >= 16) {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128位折叠到64位
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett约简到32位
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+inline bool has_clmul() {
+    static const bool supported = [] {
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 19)) != 0;
+    #else
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    #endif
+    }();
+    return supported;
+}
+#endif
+
+#ifdef CRC32_ARM
+inline uint32_t crc32_arm(uint32_t crc, const unsigned char* buf, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, buf, 8);
+        crc = __crc32d(crc, v);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) crc = __crc32b(crc, *buf++);
+    return crc;
+}
+#endif
+
+} // namespace detail
+
+// 在crc（上一段数据的CRC32，首段为0）的基础上继续计算
+inline uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* buf = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+#if defined(CRC32_ARM)
+    crc = detail::crc32_arm(crc, buf, len);
+#else
+    #if defined(CRC32_X86)
+    if (len >= 64 && detail::has_clmul()) {
+        size_t blocks = len & ~static_cast<size_t>(15);
+        crc = detail::crc32_clmul(crc, buf, blocks);
+        buf += blocks;
+        len -= blocks;
+    }
+    #endif
+    crc = detail::crc32_software(crc, buf, len);
+#endif
+    return ~crc;
+}
+
+inline uint32_t crc32(const void* data, size_t len) {
+    return crc32_update(0, data, len);
+}
+
+} // namespace checksum
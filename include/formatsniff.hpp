@@ -0,0 +1,345 @@
+#pragma once
+// formatsniff.hpp - 根据文件签名识别归档格式
+// 只读取文件头尾各一段数据，用固定偏移比较和SIMD多模式扫描找出格式，结果按(路径, 大小, 修改时间)缓存
+// 格式名与绑定中FORMAT_*常量的后缀一致（如"7Z"、"ZIP"），识别不出时为空字符串
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FORMATSNIFF_SSE2 1
+#endif
+
+#ifdef _WIN32
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+namespace sniff {
+
+// 读取的文件头、文件尾长度；ISO/UDF的卷描述符在0x8001之后，所以文件头取64KB
+constexpr size_t kHeadSize = 64 * 1024;
+constexpr size_t kTailSize = 4 * 1024;
+
+// 固定偏移的签名；offset为负数时表示从文件末尾算起
+struct Signature {
+    const char* format;
+    int64_t offset;
+    const char* bytes;
+    size_t length;
+};
+
+// 识别结果；embedded表示归档不在文件开头（自解压程序、前面拼接了其他数据的ZIP等）
+struct Detection {
+    std::string format;
+    bool embedded = false;
+};
+
+#define SNIFF_SIG(format, offset, bytes) { format, offset, bytes, sizeof(bytes) - 1 }
+
+// 按优先级排列：长而明确的签名在前，短签名（容易误判）在后
+inline const std::vector<Signature>& fixed_signatures() {
+    static const std::vector<Signature> table = {
+        SNIFF_SIG("7Z", 0, "7z\xBC\xAF\x27\x1C"),
+        SNIFF_SIG("RAR5", 0, "Rar!\x1A\x07\x01\x00"),
+        SNIFF_SIG("RAR", 0, "Rar!\x1A\x07\x00"),
+        SNIFF_SIG("XZ", 0, "\xFD" "7zXZ\x00"),
+        SNIFF_SIG("ZIP", 0, "PK\x03\x04"),
+        SNIFF_SIG("ZIP", 0, "PK\x05\x06"),
+        SNIFF_SIG("ZIP", 0, "PK\x07\x08"),
+        SNIFF_SIG("COMPOUND", 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"),
+        SNIFF_SIG("CAB", 0, "MSCF\x00\x00\x00\x00"),
+        SNIFF_SIG("WIM", 0, "MSWIM\x00\x00\x00"),
+        SNIFF_SIG("WIM", 0, "WLPWM\x00\x00\x00"),
+        SNIFF_SIG("VHDX", 0, "vhdxfile"),
+        SNIFF_SIG("VHD", 0, "conectix"),
+        SNIFF_SIG("HXS", 0, "ITOLITLS"),
+        SNIFF_SIG("MSLZ", 0, "SZDD\x88\xF0\x27\x33"),
+        SNIFF_SIG("DEB", 0, "!<arch>\ndebian"),
+        SNIFF_SIG("CHM", 0, "ITSF\x03\x00\x00\x00"),
+        SNIFF_SIG("GPT", 512, "EFI PART"),
+        SNIFF_SIG("NTFS", 3, "NTFS    "),
+        SNIFF_SIG("TAR", 257, "ustar"),
+        SNIFF_SIG("CPIO", 0, "070701"),
+        SNIFF_SIG("CPIO", 0, "070702"),
+        SNIFF_SIG("CPIO", 0, "070707"),
+        SNIFF_SIG("XAR", 0, "xar!"),
+        SNIFF_SIG("VMDK", 0, "KDMV"),
+        SNIFF_SIG("QCOW", 0, "QFI\xFB"),
+        SNIFF_SIG("VDI", 0x40, "\x7F\x10\xDA\xBE"),
+        SNIFF_SIG("RPM", 0, "\xED\xAB\xEE\xDB"),
+        SNIFF_SIG("PPMD", 0, "\x8F\xAF\xAC\x84"),
+        SNIFF_SIG("FLV", 0, "FLV\x01"),
+        SNIFF_SIG("SQUASHFS", 0, "hsqs"),
+        SNIFF_SIG("SQUASHFS", 0, "sqsh"),
+        SNIFF_SIG("SQUASHFS", 0, "shsq"),
+        SNIFF_SIG("SQUASHFS", 0, "qshs"),
+        SNIFF_SIG("CRAMFS", 0, "\x45\x3D\xCD\x28"),
+        SNIFF_SIG("CRAMFS", 0, "\x28\xCD\x3D\x45"),
+        SNIFF_SIG("MACHO", 0, "\xCE\xFA\xED\xFE"),
+        SNIFF_SIG("MACHO", 0, "\xCF\xFA\xED\xFE"),
+        SNIFF_SIG("MACHO", 0, "\xFE\xED\xFA\xCE"),
+        SNIFF_SIG("MACHO", 0, "\xFE\xED\xFA\xCF"),
+        SNIFF_SIG("MUB", 0, "\xCA\xFE\xBA\xBE"),
+        SNIFF_SIG("MUB", 0, "\xBE\xBA\xFE\xCA"),
+        SNIFF_SIG("HFS", 1024, "H+\x00\x04"),
+        SNIFF_SIG("HFS", 1024, "HX\x00\x05"),
+        SNIFF_SIG("BZIP2", 0, "BZh"),
+        SNIFF_SIG("GZIP", 0, "\x1F\x8B\x08"),
+        SNIFF_SIG("SWF", 0, "FWS"),
+        SNIFF_SIG("SWFC", 0, "CWS"),
+        SNIFF_SIG("SWFC", 0, "ZWS"),
+        SNIFF_SIG("DMG", -512, "koly"),
+        SNIFF_SIG("VHD", -512, "conectix"),
+        SNIFF_SIG("EXT", 0x438, "\x53\xEF"),
+        SNIFF_SIG("Z", 0, "\x1F\x9D"),
+        SNIFF_SIG("ARJ", 0, "\x60\xEA"),
+        SNIFF_SIG("TE", 0, "VZ"),
+    };
+    return table;
+}
+
+// 可能出现在任意位置的签名（自解压程序中嵌入的归档），需要扫描文件头
+inline const std::vector<Signature>& embedded_signatures() {
+    static const std::vector<Signature> table = {
+        SNIFF_SIG("7Z", 0, "7z\xBC\xAF\x27\x1C"),
+        SNIFF_SIG("RAR5", 0, "Rar!\x1A\x07\x01\x00"),
+        SNIFF_SIG("RAR", 0, "Rar!\x1A\x07\x00"),
+        SNIFF_SIG("ZIP", 0, "PK\x03\x04"),
+    };
+    return table;
+}
+
+#undef SNIFF_SIG
+
+// 在data中查找多个模式中最早出现的一个，返回模式下标，找不到时返回-1
+// SSE2下每次比较16个字节与所有模式的首字节和次字节，只对两者都命中的位置做完整比较
+inline int find_first_of(const char* data, size_t size, const std::vector<Signature>& patterns, size_t* position = nullptr) {
+    auto verify = [&](size_t pos) -> int {
+        for (size_t k = 0; k < patterns.size(); ++k) {
+            const Signature& p = patterns[k];
+            if (pos + p.length <= size && std::memcmp(data + pos, p.bytes, p.length) == 0) {
+                return static_cast<int>(k);
+            }
+        }
+        return -1;
+    };
+
+    size_t i = 0;
+#ifdef FORMATSNIFF_SSE2
+    // 首字节和次字节相同的模式只需比较一次；模式过多时只用下面的逐字节比较
+    constexpr size_t kMaxPairs = 16;
+    __m128i first[kMaxPairs], second[kMaxPairs];
+    char pairs[kMaxPairs][2];
+    size_t count = 0;
+    for (const Signature& p : patterns) {
+        bool found = false;
+        for (size_t k = 0; k < count; ++k) {
+            if (pairs[k][0] == p.bytes[0] && pairs[k][1] == p.bytes[1]) found = true;
+        }
+        if (found) continue;
+        if (count == kMaxPairs) {
+            count = 0;
+            break;
+        }
+        pairs[count][0] = p.bytes[0];
+        pairs[count][1] = p.bytes[1];
+        first[count] = _mm_set1_epi8(p.bytes[0]);
+        second[count] = _mm_set1_epi8(p.bytes[1]);
+        ++count;
+    }
+    for (; count > 0 && i + 17 <= size; i += 16) {
+        __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        int mask = 0;
+        for (size_t k = 0; k < count; ++k) {
+            mask |= _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block0, first[k]), _mm_cmpeq_epi8(block1, second[k])));
+        }
+        while (mask != 0) {
+    #if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanForward(&bit, static_cast<unsigned long>(mask));
+    #else
+            int bit = __builtin_ctz(static_cast<unsigned>(mask));
+    #endif
+            int k = verify(i + bit);
+            if (k >= 0) {
+                if (position) *position = i + bit;
+                return k;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i + 1 < size; ++i) {
+        int k = verify(i);
+        if (k >= 0) {
+            if (position) *position = i;
+            return k;
+        }
+    }
+    return -1;
+}
+
+// 根据文件头（从偏移0开始）、文件尾（文件最后tail_size字节）识别格式
+inline Detection detect_buffer(const char* head, size_t head_size, const char* tail, size_t tail_size, uint64_t file_size) {
+    auto match = [&](const Signature& s) {
+        if (s.offset >= 0) {
+            uint64_t off = static_cast<uint64_t>(s.offset);
+            return off + s.length <= head_size && std::memcmp(head + off, s.bytes, s.length) == 0;
+        }
+        uint64_t back = static_cast<uint64_t>(-s.offset);
+        if (back > file_size || back > tail_size || back < s.length) return false;
+        return std::memcmp(tail + (tail_size - back), s.bytes, s.length) == 0;
+    };
+
+    // UDF光盘通常同时带有ISO9660的卷描述符，先找UDF的NSR描述符
+    for (uint64_t off = 0x8001; off + 5 <= head_size && off < 0x8001 + 8 * 0x800; off += 0x800) {
+        if (std::memcmp(head + off, "NSR02", 5) == 0 || std::memcmp(head + off, "NSR03", 5) == 0) return { "UDF" };
+    }
+    if (head_size >= 0x8006 && std::memcmp(head + 0x8001, "CD001", 5) == 0) return { "ISO" };
+
+    for (const Signature& s : fixed_signatures()) {
+        if (match(s)) return { s.format };
+    }
+
+    // 可执行文件可能是自解压归档，其中嵌入的归档优先
+    bool is_pe = head_size >= 2 && head[0] == 'M' && head[1] == 'Z';
+    bool is_elf = head_size >= 4 && std::memcmp(head, "\x7F" "ELF", 4) == 0;
+    int k = find_first_of(head, head_size, embedded_signatures());
+    if (k >= 0) return { embedded_signatures()[static_cast<size_t>(k)].format, true };
+    if (is_pe) return { "PE" };
+    if (is_elf) return { "ELF" };
+
+    // 开头不是本地文件头的ZIP（如前面拼接了其他数据），看结尾的中央目录结束记录
+    static const std::vector<Signature> eocd = { { "ZIP", 0, "PK\x05\x06", 4 } };
+    if (find_first_of(tail, tail_size, eocd) >= 0) return { "ZIP", true };
+
+    if (head_size >= 7 && head[2] == '-' && head[3] == 'l' && head[4] == 'h' && head[6] == '-') return { "LZH" };
+    if (head_size >= 512 && static_cast<unsigned char>(head[510]) == 0x55 && static_cast<unsigned char>(head[511]) == 0xAA) {
+        if ((head_size >= 62 && std::memcmp(head + 54, "FAT1", 4) == 0) ||
+            (head_size >= 90 && std::memcmp(head + 82, "FAT32", 5) == 0)) return { "FAT" };
+        return { "MBR" };
+    }
+    return {};
+}
+
+// 读取文件头尾并识别格式
+inline Detection detect_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return {};
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    std::vector<char> head(static_cast<size_t>(size < kHeadSize ? size : kHeadSize));
+    file.read(head.data(), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<size_t>(file.gcount()));
+
+    // 小文件的文件尾就在已读的文件头中
+    if (size <= head.size()) {
+        size_t tail_size = head.size() < kTailSize ? head.size() : kTailSize;
+        return detect_buffer(head.data(), head.size(), head.data() + head.size() - tail_size, tail_size, size);
+    }
+    std::vector<char> tail(static_cast<size_t>(size < kTailSize ? size : kTailSize));
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(size - tail.size()));
+    file.read(tail.data(), static_cast<std::streamsize>(tail.size()));
+    tail.resize(static_cast<size_t>(file.gcount()));
+    return detect_buffer(head.data(), head.size(), tail.data(), tail.size(), size);
+}
+
+// 带缓存的识别器：文件大小和修改时间都未变时直接返回上次的结果
+class FormatCache {
+private:
+    struct Entry {
+        uint64_t size;
+        int64_t mtime_ns;
+        Detection detection;
+    };
+
+    std::mutex mtx_;
+    std::unordered_map<std::string, Entry> entries_;
+    size_t max_entries_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    static bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime_ns) {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (::_stat64(path.c_str(), &st) != 0) return false;
+        size = static_cast<uint64_t>(st.st_size);
+        mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) return false;
+        size = static_cast<uint64_t>(st.st_size);
+    #if defined(__APPLE__)
+        mtime_ns = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+    #else
+        mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    #endif
+#endif
+        return true;
+    }
+
+public:
+    explicit FormatCache(size_t max_entries = 4096) : max_entries_(max_entries) {}
+
+    Detection detect(const std::string& path) {
+        uint64_t size;
+        int64_t mtime_ns;
+        if (!stat_file(path, size, mtime_ns)) return {};
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = entries_.find(path);
+            if (it != entries_.end() && it->second.size == size && it->second.mtime_ns == mtime_ns) {
+                ++hits_;
+                return it->second.detection;
+            }
+            ++misses_;
+        }
+        // 识别过程不持锁，多个线程可同时读取不同的文件
+        Detection detection = detect_file(path);
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (entries_.size() >= max_entries_ && entries_.find(path) == entries_.end()) {
+            entries_.erase(entries_.begin());
+        }
+        entries_[path] = Entry{ size, mtime_ns, detection };
+        return detection;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        entries_.clear();
+        hits_ = misses_ = 0;
+    }
+
+    uint64_t hits() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return hits_;
+    }
+
+    uint64_t misses() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return misses_;
+    }
+
+    // 进程内共享的缓存
+    static FormatCache& global() {
+        static FormatCache cache;
+        return cache;
+    }
+};
+
+} // namespace sniff
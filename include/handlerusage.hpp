@@ -0,0 +1,195 @@
+#pragma once
+// handlerusage.hpp - 对象的并发使用登记
+// 无GIL的Python中多个线程可以同时使用同一个压缩器/解压器：操作只读取对象的设置，可以并发执行；
+// 修改设置（写）必须等待使用该对象的所有操作结束，读取设置只需等待正在进行的写。
+// 写优先：有写在等待时，新的使用和读取先等写完成，因此持续的操作和读取不会让写一直等下去；
+// 已在使用对象的线程（以及对象正在使用时的读取，例如操作的回调在其他线程上读取设置）不等待，避免与等待空闲的写互相等待。
+// 需要在操作期间临时改写对象设置的操作以独占方式使用对象。
+// 以对象地址为键登记，不需要在对象内部保存任何状态；同一线程嵌套的共享使用（例如在回调中）不会等待自己，
+// 会等待自己而死锁的情况（在自己的操作中修改设置、再次独占）直接抛出异常。
+// 已归还到池中的对象（retire）在被再次借出或销毁之前不能使用，对它的使用和读写直接抛出异常。
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+class HandlerRegistry {
+public:
+    enum class Mode { Shared, Exclusive };
+
+    static HandlerRegistry& global() {
+        static HandlerRegistry registry;
+        return registry;
+    }
+
+    // 开始使用对象：共享使用等待独占使用和写（包括等待中的写）结束，独占使用还要等待其他使用结束
+    void acquire(const void* handler, Mode mode) {
+        Shard& shard = shard_of(handler);
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        check_retired(shard, handler);
+        State& state = shard.states[handler];
+        std::thread::id self = std::this_thread::get_id();
+        bool nested = std::find(state.users.begin(), state.users.end(), self) != state.users.end();
+        if (nested && mode == Mode::Exclusive) {
+            cleanup(shard, handler, state);
+            throw std::runtime_error("The object is already used by an operation of this thread, "
+                                     "so it cannot be used exclusively (for example from a callback)");
+        }
+        if (!nested) {
+            ++state.waiters;
+            shard.cv.wait(lock, [&state, mode] {
+                return !state.exclusive && !state.writing && state.pending_writes == 0 &&
+                       (mode == Mode::Shared || state.users.empty());
+            });
+            --state.waiters;
+        }
+        state.users.push_back(self);
+        if (mode == Mode::Exclusive) state.exclusive = true;
+    }
+
+    // 结束使用；owner为acquire时的线程（使用可以在另一个线程上结束）
+    void release(const void* handler, std::thread::id owner) {
+        Shard& shard = shard_of(handler);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            auto it = shard.states.find(handler);
+            if (it == shard.states.end()) return;
+            State& state = it->second;
+            auto user = std::find(state.users.begin(), state.users.end(), owner);
+            if (user != state.users.end()) state.users.erase(user);
+            if (state.users.empty()) state.exclusive = false;
+            cleanup(shard, handler, state);
+        }
+        shard.cv.notify_all();
+    }
+
+    // 开始写设置：等待其他读写结束；idle为true时（普通的修改）还要等待所有使用结束
+    void begin_write(const void* handler, bool idle) {
+        Shard& shard = shard_of(handler);
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        check_retired(shard, handler);
+        State& state = shard.states[handler];
+        if (idle && std::find(state.users.begin(), state.users.end(), std::this_thread::get_id()) != state.users.end()) {
+            cleanup(shard, handler, state);
+            throw std::runtime_error("The object cannot be changed while an operation of this thread is using it "
+                                     "(for example from a callback or with an open writer)");
+        }
+        ++state.waiters;
+        ++state.pending_writes;
+        if (idle) ++state.pending_idle_writes;
+        shard.cv.wait(lock, [&state, idle] {
+            return !state.writing && state.readers == 0 && (!idle || state.users.empty());
+        });
+        --state.waiters;
+        --state.pending_writes;
+        if (idle) --state.pending_idle_writes;
+        state.writing = true;
+    }
+
+    void end_write(const void* handler) {
+        Shard& shard = shard_of(handler);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            State& state = shard.states[handler];
+            state.writing = false;
+            cleanup(shard, handler, state);
+        }
+        shard.cv.notify_all();
+    }
+
+    // 读设置：等待正在进行的写；有写在等待时也先等它，除非读取的线程正在使用对象，
+    // 或者对象正在使用而等待的都是要等空闲的写（这时读取可能来自操作的回调，写要等操作结束才能进行）
+    void begin_read(const void* handler) {
+        Shard& shard = shard_of(handler);
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        check_retired(shard, handler);
+        State& state = shard.states[handler];
+        std::thread::id self = std::this_thread::get_id();
+        bool user = std::find(state.users.begin(), state.users.end(), self) != state.users.end();
+        ++state.waiters;
+        shard.cv.wait(lock, [&state, user] {
+            return !state.writing && (state.pending_writes == 0 || user ||
+                   (!state.users.empty() && state.pending_writes == state.pending_idle_writes));
+        });
+        --state.waiters;
+        ++state.readers;
+    }
+
+    void end_read(const void* handler) {
+        Shard& shard = shard_of(handler);
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            State& state = shard.states[handler];
+            --state.readers;
+            cleanup(shard, handler, state);
+        }
+        shard.cv.notify_all();
+    }
+
+    // 对象已归还到池中，别处留下的引用不能再使用它
+    void retire(const void* handler) {
+        Shard& shard = shard_of(handler);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.retired.insert(handler);
+    }
+
+    // 对象从池中再次借出，或者被销毁（地址可能被复用）
+    void restore(const void* handler) {
+        Shard& shard = shard_of(handler);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.retired.erase(handler);
+    }
+
+    // 当前登记的对象个数（调试用）
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            total += shard.states.size();
+        }
+        return total;
+    }
+
+private:
+    struct State {
+        std::vector<std::thread::id> users;  // 正在使用对象的线程（嵌套使用时会出现多次）
+        bool exclusive = false;
+        bool writing = false;
+        int readers = 0;
+        int pending_writes = 0;       // 等待中的写
+        int pending_idle_writes = 0;  // 其中要等所有使用结束的写
+        int waiters = 0;  // 正在等待的线程，它们持有State的引用
+    };
+
+    // 按地址分片，减少不同对象之间的锁竞争
+    struct Shard {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::unordered_map<const void*, State> states;
+        std::unordered_set<const void*> retired;
+    };
+
+    static constexpr size_t kShards = 16;
+    Shard shards_[kShards];
+
+    Shard& shard_of(const void* handler) {
+        return shards_[(reinterpret_cast<uintptr_t>(handler) >> 4) % kShards];
+    }
+
+    static void check_retired(const Shard& shard, const void* handler) {
+        if (!shard.retired.empty() && shard.retired.count(handler) != 0) {
+            throw std::runtime_error("The object has been returned to its pool, it cannot be used anymore");
+        }
+    }
+
+    // 空闲的对象不保留登记，对象销毁后地址可能被复用
+    static void cleanup(Shard& shard, const void* handler, const State& state) {
+        if (state.users.empty() && !state.writing && state.readers == 0 && state.waiters == 0) shard.states.erase(handler);
+    }
+};
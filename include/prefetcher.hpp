@@ -0,0 +1,135 @@
+#pragma once
+// prefetcher.hpp - 压缩输入的并行预读器
+// 读线程按压缩器的消费顺序提前打开并读取文件，使其进入页缓存，压缩线程读取时不再等待冷缓存I/O
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <fstream>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+class FilePrefetcher {
+private:
+    std::vector<std::string> paths_;
+    std::vector<uint64_t> offsets_;  // 文件大小的前缀和，用于计算窗口内的字节数
+    std::map<std::string, size_t> index_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    size_t next_ = 0;                // 下一个要预读的文件
+    size_t consumed_ = 0;            // 压缩器已经开始处理的文件数
+    uint64_t consumed_bytes_ = 0;    // 以及这些文件的总大小
+    std::vector<bool> done_;
+    bool stopping_ = false;
+
+    size_t window_files_;
+    uint64_t window_bytes_;
+    uint64_t large_file_;
+    std::vector<std::thread> threads_;
+
+public:
+    // paths和sizes按压缩器的消费顺序排列；names为可选的归档内名称，用于识别文件回调的参数
+    // 预读窗口同时受文件数和字节数限制；不小于large_file的文件交给内核异步预读
+    // 窗口按已处理的文件数和字节数前移，压缩器局部调整顺序（如7z按类型分组）时也不会停住
+    FilePrefetcher(std::vector<std::string> paths, const std::vector<uint64_t>& sizes,
+                   const std::vector<std::string>& names = {}, unsigned threads = 4,
+                   size_t window_files = 1024, uint64_t window_bytes = 256ULL * 1024 * 1024,
+                   uint64_t large_file = 1024 * 1024)
+        : paths_(std::move(paths)), window_files_(window_files), window_bytes_(window_bytes),
+          large_file_(large_file) {
+        offsets_.resize(paths_.size() + 1, 0);
+        done_.resize(paths_.size(), false);
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            offsets_[i + 1] = offsets_[i] + (i < sizes.size() ? sizes[i] : 0);
+            index_.emplace(paths_[i], i);
+            if (i < names.size()) index_.emplace(names[i], i);
+        }
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~FilePrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    // 压缩器开始处理某个文件时调用（路径或归档内名称均可），预读窗口随之前移
+    void consumed(const std::string& name) {
+        auto it = index_.find(name);
+        if (it == index_.end()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            size_t i = it->second;
+            if (done_[i]) return;
+            done_[i] = true;
+            ++consumed_;
+            consumed_bytes_ += offsets_[i + 1] - offsets_[i];
+            // 压缩器追上预读进度时，跳过已经来不及的文件
+            if (next_ <= i) next_ = i + 1;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    bool in_window() const {
+        return next_ < paths_.size() &&
+               next_ < consumed_ + window_files_ &&
+               offsets_[next_] < consumed_bytes_ + window_bytes_;
+    }
+
+    void run() {
+        std::unique_ptr<char[]> buffer(new char[256 * 1024]);
+        for (;;) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return stopping_ || next_ >= paths_.size() || in_window(); });
+                if (stopping_ || next_ >= paths_.size()) return;
+                i = next_++;
+            }
+            prefetch(paths_[i], offsets_[i + 1] - offsets_[i], buffer.get(), 256 * 1024);
+        }
+    }
+
+    void prefetch(const std::string& path, uint64_t size, char* buffer, size_t buffer_size) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+    #if defined(POSIX_FADV_WILLNEED)
+        if (size >= large_file_) {
+            // 大文件只提示内核异步预读，不占用读线程
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+            return;
+        }
+    #endif
+        while (::read(fd, buffer, buffer_size) > 0) {
+        }
+        ::close(fd);
+#else
+        (void)size;
+        std::ifstream file(path, std::ios::binary);
+        while (file.read(buffer, static_cast<std::streamsize>(buffer_size)) || file.gcount() > 0) {
+        }
+#endif
+    }
+};
@@ -10,6 +10,14 @@
 #include <ctime>
 #include <chrono>
 #include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <iterator>
+#include <exception>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -33,6 +41,18 @@
     #include <unistd.h>
     #include <dirent.h>
     #include <pwd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+    #include <sys/syscall.h>
+    #include <sys/sendfile.h>
+    #include <sys/ioctl.h>
+    #include <cerrno>
+    #ifndef FICLONE
+        #define FICLONE _IOW(0x94, 9, int)
+    #endif
 #endif
 
 namespace os {
@@ -40,6 +60,469 @@ namespace os {
 // 命名空间别名，方便使用
 namespace fs = std::filesystem;
 
+// ===================== 内部工具 =====================
+
+namespace {
+
+// 通配符匹配，支持*和?
+bool wildcard_match(const char* pat, const char* str) {
+    const char* star = nullptr;
+    const char* back = nullptr;
+    while (*str) {
+        if (*pat == '?' || *pat == *str) {
+            ++pat;
+            ++str;
+        } else if (*pat == '*') {
+            star = pat++;
+            back = str;
+        } else if (star) {
+            pat = star + 1;
+            str = ++back;
+        } else {
+            return false;
+        }
+    }
+    while (*pat == '*') ++pat;
+    return *pat == '\0';
+}
+
+// 不含/的模式匹配文件名，否则匹配相对路径
+bool match_any(const std::vector<std::string>& patterns, const char* name, const std::string& rel) {
+    for (const auto& p : patterns) {
+        const char* target = (p.find('/') != std::string::npos) ? rel.c_str() : name;
+        if (wildcard_match(p.c_str(), target)) return true;
+    }
+    return false;
+}
+
+unsigned worker_count(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+// 并行遍历的任务队列：pending统计排队中和处理中的任务，归零即遍历结束
+template<typename Task>
+class TaskQueue {
+public:
+    void push(Task task) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (aborted_) return;
+        tasks_.push_back(std::move(task));
+        ++pending_;
+        cv_.notify_one();
+    }
+
+    bool pop(Task& task) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return !tasks_.empty() || pending_ == 0 || aborted_; });
+        if (tasks_.empty() || aborted_) return false;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+        return true;
+    }
+
+    void done() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (--pending_ == 0) cv_.notify_all();
+    }
+
+    // 出错时丢弃排队中的任务，工作线程处理完手头的任务后退出
+    void abort() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_ -= tasks_.size();
+        tasks_.clear();
+        aborted_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    size_t pending_ = 0;
+    bool aborted_ = false;
+};
+
+// 用工作线程处理目录任务，visit(task, queue, worker_id)可以继续提交子任务
+// 单个目录的失败由visit自己记录；visit抛出的异常（如内存不足）终止遍历，等所有线程结束后重新抛出第一个
+template<typename Task, typename Visit>
+void parallel_visit(std::vector<Task> roots, unsigned threads, Visit visit) {
+    TaskQueue<Task> queue;
+    for (auto& t : roots) queue.push(std::move(t));
+
+    std::mutex error_mtx;
+    std::exception_ptr error;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(error_mtx);
+            if (!error) error = e;
+        }
+        queue.abort();
+    };
+
+    std::vector<std::thread> workers;
+    unsigned n = worker_count(threads);
+    try {
+        for (unsigned i = 0; i < n; ++i) {
+            workers.emplace_back([&queue, &visit, &fail, i] {
+                Task task;
+                while (queue.pop(task)) {
+                    try {
+                        visit(task, queue, i);
+                    } catch (...) {
+                        fail(std::current_exception());
+                    }
+                    queue.done();
+                }
+            });
+        }
+    } catch (...) {
+        // 无法创建更多线程
+        fail(std::current_exception());
+    }
+    for (auto& w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// 拼接目录与文件名
+std::string child_path(const std::string& dir, const char* name) {
+    std::string full = dir;
+    if (!full.empty() && full.back() != '/' && full.back() != '\\') full += '/';
+    full += name;
+    return full;
+}
+
+struct ScanTask {
+    std::string dir; // 目录完整路径
+    std::string rel; // 相对于根目录的路径，根目录为空
+    int owner = -1;  // 目录条目所在结果分片的线程号，没有条目时为-1
+    size_t index = 0; // 目录条目在分片中的位置
+};
+
+// 扫描到的目录条目数，遍历结束后再写回目录条目（分片在遍历中还在增长）
+struct ChildCount {
+    unsigned owner;
+    size_t index;
+    uint64_t count;
+};
+
+#ifdef __linux__
+// getdents64返回的目录项（glibc未提供该结构）
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+bool stat_at(int dirfd, const char* name, DirEntry& e) {
+#ifdef STATX_BASIC_STATS
+    struct statx stx;
+    if (::statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) != 0) {
+        return false;
+    }
+    e.size = stx.stx_size;
+    e.mtime = static_cast<time_t>(stx.stx_mtime.tv_sec);
+    e.mode = stx.stx_mode;
+    e.inode = stx.stx_ino;
+#else
+    struct stat st;
+    if (::fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    e.size = static_cast<uint64_t>(st.st_size);
+    e.mtime = st.st_mtime;
+    e.mode = st.st_mode;
+    e.inode = st.st_ino;
+#endif
+    return true;
+}
+
+// 离开作用域时关闭的文件描述符，visit抛出异常时也不会泄漏
+struct FdGuard {
+    int fd;
+    explicit FdGuard(int f) : fd(f) {}
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+    FdGuard(const FdGuard&) = delete;
+    FdGuard& operator=(const FdGuard&) = delete;
+    // 显式关闭并返回是否成功（写入的文件需要检查）
+    bool close() {
+        int f = fd;
+        fd = -1;
+        return ::close(f) == 0;
+    }
+};
+
+void scan_dir(const ScanTask& task, TaskQueue<ScanTask>& queue, const ScanOptions& options, unsigned id,
+              std::vector<DirEntry>& out, std::vector<ChildCount>& counts, std::vector<char>& buf) {
+    int fd = ::open(task.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    FdGuard guard(fd);
+
+    uint64_t children = 0;
+    for (;;) {
+        long n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<linux_dirent64*>(buf.data() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            ++children;
+
+            std::string rel = task.rel.empty() ? std::string(name) : task.rel + '/' + name;
+            if (!options.exclude.empty() && match_any(options.exclude, name, rel)) continue;
+
+            // 不需要目录条目时，d_type已足够判断，省掉一次statx
+            if (d->d_type == DT_DIR && !options.include_dirs) {
+                queue.push({child_path(task.dir, name), std::move(rel)});
+                continue;
+            }
+
+            DirEntry e;
+            if (!stat_at(fd, name, e)) continue;
+            e.path = child_path(task.dir, name);
+            if (e.is_dir()) {
+                if (!options.include_dirs) {
+                    queue.push({e.path, std::move(rel)});
+                    continue;
+                }
+                queue.push({e.path, std::move(rel), static_cast<int>(id), out.size()});
+                out.push_back(std::move(e));
+                continue;
+            }
+            if (!options.include.empty() && !match_any(options.include, name, rel)) continue;
+            out.push_back(std::move(e));
+        }
+    }
+    if (task.owner >= 0) counts.push_back({static_cast<unsigned>(task.owner), task.index, children});
+}
+#endif
+
+#ifdef __linux__
+// 写满size字节，处理被信号中断和部分写入
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 在内核中完成复制：依次尝试reflink、copy_file_range、sendfile，最后退回到read/write
+// 各方式都使用文件的当前偏移，某一方式中途失败时后面的方式从断点继续
+bool copy_fd(int in, int out, uint64_t size) {
+    if (size > 0 && ::ioctl(out, FICLONE, in) == 0) return true;
+
+    const uint64_t chunk = 1ULL << 30;
+    uint64_t copied = 0;
+    while (copied < size) {
+        ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, (std::min)(size - copied, chunk), 0);
+        if (n <= 0) break;
+        copied += static_cast<uint64_t>(n);
+    }
+    while (copied < size) {
+        ssize_t n = ::sendfile(out, in, nullptr, (std::min)(size - copied, chunk));
+        if (n <= 0) break;
+        copied += static_cast<uint64_t>(n);
+    }
+
+    if (size > 0 && copied == size) return true;
+
+    // 大小未知（如/proc下的文件）或内核复制不可用时读到文件末尾
+    const size_t buf_size = 1 << 20;
+    std::unique_ptr<char[]> buf(new char[buf_size]);
+    for (;;) {
+        ssize_t n = ::read(in, buf.get(), buf_size);
+        if (n == 0) return true;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (!write_all(out, buf.get(), static_cast<size_t>(n))) return false;
+    }
+}
+
+// 每个工作线程独立累计结果，结束后合并，避免争用
+void merge_results(std::vector<TreeResult>& parts, TreeResult& result) {
+    for (auto& p : parts) {
+        result.count += p.count;
+        result.bytes += p.bytes;
+        std::move(p.errors.begin(), p.errors.end(), std::back_inserter(result.errors));
+    }
+}
+
+// 待删除的目录：pending为1（自身的列举）加上未删完的子目录数，归零时删除自身并通知父目录
+struct RemoveNode {
+    std::string path;
+    std::shared_ptr<RemoveNode> parent;
+    std::atomic<size_t> pending{1};
+};
+
+void finish_remove(std::shared_ptr<RemoveNode> node, TreeResult& result) {
+    while (node && --node->pending == 0) {
+        if (::rmdir(node->path.c_str()) == 0) {
+            ++result.count;
+        } else {
+            result.errors.emplace_back(node->path, errno);
+        }
+        node = node->parent;
+    }
+}
+
+void remove_dir(const std::shared_ptr<RemoveNode>& node, TaskQueue<std::shared_ptr<RemoveNode>>& queue,
+                TreeResult& result, std::vector<char>& buf) {
+    int fd = ::open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        result.errors.emplace_back(node->path, errno);
+        finish_remove(node, result);
+        return;
+    }
+    FdGuard guard(fd);
+
+    for (;;) {
+        long n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<linux_dirent64*>(buf.data() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+            bool is_dir = d->d_type == DT_DIR;
+            if (d->d_type == DT_UNKNOWN) {
+                struct stat st;
+                is_dir = ::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+            }
+            if (is_dir) {
+                auto child = std::make_shared<RemoveNode>();
+                child->path = child_path(node->path, name);
+                child->parent = node;
+                ++node->pending;
+                queue.push(std::move(child));
+            } else if (::unlinkat(fd, name, 0) == 0) {
+                ++result.count;
+            } else {
+                result.errors.emplace_back(child_path(node->path, name), errno);
+            }
+        }
+    }
+    guard.close();
+    finish_remove(node, result);
+}
+
+struct CopyTask {
+    std::string src;
+    std::string dst;
+};
+
+// 创建的目录和源目录的权限；目录创建时加上了S_IRWXU，复制完成后恢复
+struct DirMode {
+    std::string path;
+    mode_t mode;
+};
+
+// 所有子项复制完成后恢复目录的权限，子目录先于父目录（父目录可能不可进入）
+void restore_modes(std::vector<DirMode>& modes, TreeResult& result) {
+    std::sort(modes.begin(), modes.end(), [](const DirMode& a, const DirMode& b) { return a.path > b.path; });
+    for (const auto& dir : modes) {
+        if (::fchmodat(AT_FDCWD, dir.path.c_str(), dir.mode, 0) != 0) {
+            result.errors.emplace_back(dir.path, errno);
+        }
+    }
+}
+
+void copy_dir(const CopyTask& task, TaskQueue<CopyTask>& queue, TreeResult& result, std::vector<DirMode>& modes,
+              std::vector<char>& buf) {
+    int src_fd = ::open(task.src.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (src_fd < 0) {
+        result.errors.emplace_back(task.src, errno);
+        return;
+    }
+    FdGuard src_guard(src_fd);
+    int dst_fd = ::open(task.dst.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dst_fd < 0) {
+        result.errors.emplace_back(task.dst, errno);
+        return;
+    }
+    FdGuard dst_guard(dst_fd);
+
+    for (;;) {
+        long n = ::syscall(SYS_getdents64, src_fd, buf.data(), buf.size());
+        if (n <= 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<linux_dirent64*>(buf.data() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+            struct stat st;
+            if (::fstatat(src_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                result.errors.emplace_back(child_path(task.src, name), errno);
+                continue;
+            }
+
+            if (S_ISDIR(st.st_mode)) {
+                // 保证自己可写，否则只读目录里无法创建子项
+                std::string dst = child_path(task.dst, name);
+                if (::mkdirat(dst_fd, name, (st.st_mode & 07777) | S_IRWXU) == 0) {
+                    modes.push_back({dst, st.st_mode & 07777});
+                } else if (errno != EEXIST) {
+                    result.errors.emplace_back(dst, errno);
+                    continue;
+                }
+                ++result.count;
+                queue.push({child_path(task.src, name), std::move(dst)});
+            } else if (S_ISLNK(st.st_mode)) {
+                std::string target(static_cast<size_t>(st.st_size) + 1, '\0');
+                ssize_t len = ::readlinkat(src_fd, name, &target[0], target.size());
+                if (len < 0) {
+                    result.errors.emplace_back(child_path(task.src, name), errno);
+                    continue;
+                }
+                target.resize(static_cast<size_t>(len));
+                ::unlinkat(dst_fd, name, 0);
+                if (::symlinkat(target.c_str(), dst_fd, name) != 0) {
+                    result.errors.emplace_back(child_path(task.dst, name), errno);
+                    continue;
+                }
+                ++result.count;
+            } else if (S_ISREG(st.st_mode)) {
+                FdGuard in(::openat(src_fd, name, O_RDONLY | O_CLOEXEC));
+                if (in.fd < 0) {
+                    result.errors.emplace_back(child_path(task.src, name), errno);
+                    continue;
+                }
+                FdGuard out(::openat(dst_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777));
+                if (out.fd < 0) {
+                    result.errors.emplace_back(child_path(task.dst, name), errno);
+                    continue;
+                }
+                bool ok = copy_fd(in.fd, out.fd, static_cast<uint64_t>(st.st_size));
+                in.close();
+                if (!out.close()) ok = false;
+                if (ok) {
+                    ++result.count;
+                    result.bytes += static_cast<uint64_t>(st.st_size);
+                } else {
+                    result.errors.emplace_back(child_path(task.dst, name), errno);
+                }
+            }
+            // 设备文件、管道等特殊文件不复制
+        }
+    }
+}
+#endif
+
+} // namespace
+
 // ===================== os.path 命名空间实现 =====================
 
 namespace path {
@@ -195,11 +678,7 @@ bool rmdir(const std::string& path) {
 }
 
 uint64_t removedirs(const std::string& path) {
-    try {
-        return static_cast<uint64_t>(fs::remove_all(fs::path(path)));
-    } catch (...) {
-        return 0;
-    }
+    return rmtree(path).count;
 }
 
 bool rename(const std::string& oldpath, const std::string& newpath) {
@@ -212,12 +691,39 @@ bool rename(const std::string& oldpath, const std::string& newpath) {
 }
 
 bool copyfile(const std::string& src, const std::string& dst) {
+#ifdef __linux__
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+
+    struct stat src_stat, dst_stat;
+    if (::fstat(in, &src_stat) != 0 || !S_ISREG(src_stat.st_mode)) {
+        ::close(in);
+        return false;
+    }
+    // 源和目标是同一个文件时，O_TRUNC会清空源文件
+    if (::stat(dst.c_str(), &dst_stat) == 0 &&
+        dst_stat.st_dev == src_stat.st_dev && dst_stat.st_ino == src_stat.st_ino) {
+        ::close(in);
+        return false;
+    }
+
+    int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, src_stat.st_mode & 07777);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+    bool ok = copy_fd(in, out, static_cast<uint64_t>(src_stat.st_size));
+    ::close(in);
+    if (::close(out) != 0) ok = false;
+    return ok;
+#else
     try {
         fs::copy_file(fs::path(src), fs::path(dst), fs::copy_options::overwrite_existing);
         return true;
     } catch (...) {
         return false;
     }
+#endif
 }
 
 std::string getenv(const std::string& key) {
@@ -312,15 +818,191 @@ std::string urandom(size_t length) {
 
 std::vector<std::string> walk(const std::string& root) {
     std::vector<std::string> result;
+    for (auto& entry : scantree(root)) {
+        // 与fs::is_regular_file一致，指向普通文件的符号链接也算作文件
+        if (entry.is_file() || (entry.is_symlink() && path::isfile(entry.path))) {
+            result.push_back(std::move(entry.path));
+        }
+    }
+    return result;
+}
+
+// ===================== 并行目录扫描实现 =====================
+
+std::vector<DirEntry> scantree(const std::string& root, const ScanOptions& options) {
+    std::vector<DirEntry> result;
+#ifdef __linux__
+    unsigned n = worker_count(options.threads);
+    std::vector<std::vector<DirEntry>> parts(n);
+    std::vector<std::vector<ChildCount>> counts(n);
+    std::vector<std::vector<char>> buffers(n, std::vector<char>(64 * 1024));
+
+    parallel_visit<ScanTask>({{root, ""}}, n,
+        [&](const ScanTask& task, TaskQueue<ScanTask>& queue, unsigned id) {
+            scan_dir(task, queue, options, id, parts[id], counts[id], buffers[id]);
+        });
+    for (const auto& c : counts) {
+        for (const auto& count : c) parts[count.owner][count.index].children = count.count;
+    }
+
+    size_t total = 0;
+    for (const auto& p : parts) total += p.size();
+    result.reserve(total);
+    for (auto& p : parts) {
+        std::move(p.begin(), p.end(), std::back_inserter(result));
+    }
+#else
+    // 其他平台退回到单线程的std::filesystem实现
     try {
-        for (const auto& entry : fs::recursive_directory_iterator(root)) {
-            if (entry.is_regular_file()) {
-                result.push_back(entry.path().string());
+        std::error_code ec;
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && it != end; it.increment(ec)) {
+            std::string full = it->path().string();
+            std::string rel = full.substr((std::min)(full.size(), root.size() + 1));
+            std::replace(rel.begin(), rel.end(), '\\', '/');
+            std::string name = it->path().filename().string();
+            if (!options.exclude.empty() && match_any(options.exclude, name.c_str(), rel)) {
+                if (it->is_directory(ec)) it.disable_recursion_pending();
+                continue;
             }
+
+            DirEntry e;
+            fs::file_status st = it->symlink_status(ec);
+            if (fs::is_symlink(st)) {
+                e.mode = 0120000 | 0777;
+            } else if (fs::is_directory(st)) {
+                e.mode = 0040000 | static_cast<uint32_t>(st.permissions() & fs::perms::mask);
+            } else {
+                e.mode = 0100000 | static_cast<uint32_t>(st.permissions() & fs::perms::mask);
+                e.size = static_cast<uint64_t>(it->file_size(ec));
+            }
+            e.mtime = path::getmtime(full);
+            e.path = std::move(full);
+            if (e.is_dir()) {
+                if (options.include_dirs) {
+                    for (fs::directory_iterator child(it->path(), ec), last; !ec && child != last; child.increment(ec)) {
+                        ++e.children;
+                    }
+                    ec.clear();
+                    result.push_back(std::move(e));
+                }
+                continue;
+            }
+            if (!options.include.empty() && !match_any(options.include, name.c_str(), rel)) continue;
+            result.push_back(std::move(e));
         }
     } catch (...) {
         // 忽略错误
     }
+#endif
+    if (options.sort) {
+        std::sort(result.begin(), result.end(),
+                  [](const DirEntry& a, const DirEntry& b) { return a.path < b.path; });
+    }
+    return result;
+}
+
+// ===================== 并行删除与复制实现 =====================
+
+TreeResult rmtree(const std::string& path, unsigned threads) {
+    TreeResult result;
+#ifdef __linux__
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0) {
+        return result;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (::unlink(path.c_str()) == 0) {
+            result.count = 1;
+        } else {
+            result.errors.emplace_back(path, errno);
+        }
+        return result;
+    }
+
+    unsigned n = worker_count(threads);
+    std::vector<TreeResult> parts(n);
+    std::vector<std::vector<char>> buffers(n, std::vector<char>(64 * 1024));
+    auto root = std::make_shared<RemoveNode>();
+    root->path = path;
+
+    parallel_visit<std::shared_ptr<RemoveNode>>({root}, n,
+        [&](const std::shared_ptr<RemoveNode>& node, TaskQueue<std::shared_ptr<RemoveNode>>& queue, unsigned id) {
+            remove_dir(node, queue, parts[id], buffers[id]);
+        });
+    merge_results(parts, result);
+#else
+    std::error_code ec;
+    result.count = static_cast<uint64_t>(fs::remove_all(fs::path(path), ec));
+    if (ec) {
+        result.count = 0;
+        result.errors.emplace_back(path, ec.value());
+    }
+#endif
+    return result;
+}
+
+TreeResult copytree(const std::string& src, const std::string& dst, unsigned threads) {
+    TreeResult result;
+#ifdef __linux__
+    struct stat st;
+    if (::stat(src.c_str(), &st) != 0) {
+        result.errors.emplace_back(src, errno);
+        return result;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        result.errors.emplace_back(src, ENOTDIR);
+        return result;
+    }
+    std::vector<std::vector<DirMode>> modes(1);
+    if (::mkdir(dst.c_str(), (st.st_mode & 07777) | S_IRWXU) == 0) {
+        modes[0].push_back({dst, st.st_mode & 07777});
+    } else if (errno != EEXIST) {
+        result.errors.emplace_back(dst, errno);
+        return result;
+    }
+
+    unsigned n = worker_count(threads);
+    std::vector<TreeResult> parts(n);
+    modes.resize(n + 1);
+    std::vector<std::vector<char>> buffers(n, std::vector<char>(64 * 1024));
+
+    parallel_visit<CopyTask>({{src, dst}}, n,
+        [&](const CopyTask& task, TaskQueue<CopyTask>& queue, unsigned id) {
+            copy_dir(task, queue, parts[id], modes[id + 1], buffers[id]);
+        });
+    merge_results(parts, result);
+    std::vector<DirMode> created;
+    for (auto& m : modes) {
+        std::move(m.begin(), m.end(), std::back_inserter(created));
+    }
+    restore_modes(created, result);
+#else
+    // 其他平台退回到单线程的std::filesystem实现
+    std::error_code ec;
+    fs::create_directories(fs::path(dst), ec);
+    fs::recursive_directory_iterator it(src, fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        fs::path target = fs::path(dst) / fs::relative(it->path(), src, ec);
+        std::error_code item_ec;
+        fs::file_status st = it->symlink_status(item_ec);
+        if (fs::is_directory(st)) {
+            fs::create_directories(target, item_ec);
+        } else if (fs::is_symlink(st)) {
+            fs::copy_symlink(it->path(), target, item_ec);
+        } else if (fs::is_regular_file(st)) {
+            fs::copy_file(it->path(), target, fs::copy_options::overwrite_existing, item_ec);
+            if (!item_ec) result.bytes += static_cast<uint64_t>(it->file_size(item_ec));
+        } else {
+            continue;
+        }
+        if (item_ec) {
+            result.errors.emplace_back(target.string(), item_ec.value());
+        } else {
+            ++result.count;
+        }
+    }
+#endif
     return result;
 }
 
@@ -332,19 +1014,50 @@ std::string read_file(const std::string& filename) {
         return "";
     }
     
-    std::ostringstream ss;
-    ss << file.rdbuf();
-    return ss.str();
+    // 按文件大小一次分配并直接读入结果，避免经过ostringstream的多次拷贝
+    // （不能用std::ios::ate打开，/proc下的文件无法定位到末尾，会导致打开失败）
+    std::string content;
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.clear();
+    file.seekg(0);
+    if (size > 0) {
+        content.resize(static_cast<size_t>(size));
+        file.read(&content[0], size);
+        content.resize(static_cast<size_t>(file.gcount()));
+    }
+
+    // 大小未知（如/proc下的文件）或读取期间文件增长时，继续读到末尾
+    char chunk[64 * 1024];
+    while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+        content.append(chunk, static_cast<size_t>(file.gcount()));
+    }
+    return content;
 }
 
 bool write_file(const std::string& filename, const std::string& content) {
+    return write_file(filename, content.data(), content.size());
+}
+
+bool write_file(const std::string& filename, const char* data, size_t size) {
+#ifdef __linux__
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = write_all(fd, data, size);
+    if (::close(fd) != 0) ok = false;
+    return ok;
+#else
     std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
-    file << content;
+    file.write(data, static_cast<std::streamsize>(size));
     return !file.fail();
+#endif
 }
 
 bool append_file(const std::string& filename, const std::string& content) {
@@ -357,4 +1070,128 @@ bool append_file(const std::string& filename, const std::string& content) {
     return !file.fail();
 }
 
+// ===================== 内存映射实现 =====================
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(other.data_), size_(other.size_), valid_(other.valid_) {
+#ifdef _WIN32
+    mapping_ = other.mapping_;
+    other.mapping_ = nullptr;
+#endif
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.valid_ = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = other.data_;
+        size_ = other.size_;
+        valid_ = other.valid_;
+#ifdef _WIN32
+        mapping_ = other.mapping_;
+        other.mapping_ = nullptr;
+#endif
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.valid_ = false;
+    }
+    return *this;
+}
+
+void MappedFile::close() {
+    if (data_) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(static_cast<HANDLE>(mapping_));
+        mapping_ = nullptr;
+#else
+        ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+    valid_ = false;
+}
+
+bool MappedFile::advise(Advice advice) const {
+    if (!data_) return false;
+#ifdef _WIN32
+  #if _WIN32_WINNT >= 0x0602
+    if (advice == Advice::WillNeed) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<char*>(data_);
+        range.NumberOfBytes = size_;
+        return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+    }
+  #endif
+    return false;
+#else
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case Advice::Normal: flag = MADV_NORMAL; break;
+        case Advice::Sequential: flag = MADV_SEQUENTIAL; break;
+        case Advice::Random: flag = MADV_RANDOM; break;
+        case Advice::WillNeed: flag = MADV_WILLNEED; break;
+        case Advice::DontNeed: flag = MADV_DONTNEED; break;
+    }
+    return ::madvise(const_cast<char*>(data_), size_, flag) == 0;
+#endif
+}
+
+MappedFile map_file(const std::string& filename) {
+    MappedFile mapped;
+#ifdef _WIN32
+    HANDLE file = CreateFileW(fs::path(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return mapped;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size)) {
+        if (size.QuadPart == 0) {
+            mapped.valid_ = true;
+        } else {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view) {
+                    mapped.data_ = static_cast<const char*>(view);
+                    mapped.size_ = static_cast<size_t>(size.QuadPart);
+                    mapped.mapping_ = mapping;
+                    mapped.valid_ = true;
+                } else {
+                    CloseHandle(mapping);
+                }
+            }
+        }
+    }
+    // 映射对象持有文件的引用，文件句柄可以立即关闭
+    CloseHandle(file);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return mapped;
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            mapped.valid_ = true;
+        } else {
+            void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                mapped.data_ = static_cast<const char*>(view);
+                mapped.size_ = static_cast<size_t>(st.st_size);
+                mapped.valid_ = true;
+            }
+        }
+    }
+    ::close(fd);
+#endif
+    return mapped;
+}
+
 } // namespace os
\ No newline at end of file
@@ -77,6 +77,67 @@ PYOS_API std::string gettempdir();
 PYOS_API std::string urandom(size_t length);
 PYOS_API std::vector<std::string> walk(const std::string& root);
 
+// ===================== 并行目录扫描 =====================
+
+/**
+ * 扫描得到的条目，一次遍历同时带回stat信息（类似os.DirEntry）
+ * mode统一使用POSIX编码（Windows上由文件类型和权限合成）
+ */
+struct DirEntry {
+    std::string path;   // 完整路径
+    uint64_t size = 0;  // 文件大小（字节）
+    time_t mtime = 0;   // 最后修改时间
+    uint32_t mode = 0;  // st_mode，包含文件类型位
+    uint64_t inode = 0; // inode号（Windows上为0）
+    uint64_t children = 0; // 目录在磁盘上的条目数，包括被过滤掉的（仅目录条目）
+
+    bool is_dir() const { return (mode & 0170000) == 0040000; }
+    bool is_file() const { return (mode & 0170000) == 0100000; }
+    bool is_symlink() const { return (mode & 0170000) == 0120000; }
+};
+
+/**
+ * 扫描选项
+ * 通配符支持 * 和 ?；不含路径分隔符的模式匹配文件名，否则匹配相对于根目录的路径（以/分隔）
+ */
+struct ScanOptions {
+    std::vector<std::string> include; // 只保留匹配的文件（为空表示全部）
+    std::vector<std::string> exclude; // 排除匹配的文件和目录（目录被排除时跳过整棵子树）
+    unsigned threads = 0;             // 工作线程数，0表示使用硬件并发数
+    bool include_dirs = false;        // 结果中是否包含目录条目
+    bool sort = true;                 // 是否按路径排序结果
+};
+
+/**
+ * 多线程遍历目录树，返回所有条目及其大小、修改时间、模式和inode
+ * Linux上使用openat/getdents64/statx，每个条目只stat一次
+ * 无法打开的目录被跳过；工作线程中的其他错误（如内存不足）等所有线程结束后抛出
+ */
+PYOS_API std::vector<DirEntry> scantree(const std::string& root, const ScanOptions& options = ScanOptions());
+
+// ===================== 并行删除与复制 =====================
+
+/**
+ * 目录树批量操作的结果（单个条目的失败记录在errors中，其他错误以异常抛出）
+ */
+struct TreeResult {
+    uint64_t count = 0; // 成功删除或复制的条目数（包括目录）
+    uint64_t bytes = 0; // 复制的字节数（删除时为0）
+    std::vector<std::pair<std::string, int>> errors; // 失败的路径和对应的errno
+};
+
+/**
+ * 多线程删除整个目录树（类似shutil.rmtree），路径是文件时直接删除
+ * Linux上每个目录由工作线程用getdents64和unlinkat处理，子目录清空后再rmdir
+ */
+PYOS_API TreeResult rmtree(const std::string& path, unsigned threads = 0);
+
+/**
+ * 多线程复制整个目录树（类似shutil.copytree(dirs_exist_ok=True)）
+ * 文件按copyfile的方式在内核中复制并保留权限，符号链接按原样复制
+ */
+PYOS_API TreeResult copytree(const std::string& src, const std::string& dst, unsigned threads = 0);
+
 /**
  * 行结束符（类似os.linesep）
  */
@@ -112,8 +173,61 @@ inline char pathsep() {
 
 PYOS_API std::string read_file(const std::string& filename);
 PYOS_API bool write_file(const std::string& filename, const std::string& content);
+PYOS_API bool write_file(const std::string& filename, const char* data, size_t size);
 PYOS_API bool append_file(const std::string& filename, const std::string& content);
 
+// ===================== 零拷贝文件读写 =====================
+
+/**
+ * 内存映射的访问模式提示（对应madvise）
+ */
+enum class Advice {
+    Normal,
+    Sequential,
+    Random,
+    WillNeed,
+    DontNeed
+};
+
+/**
+ * 只读内存映射的文件视图，只能移动不能复制，析构时自动解除映射
+ */
+class PYOS_API MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool valid() const { return valid_; }
+
+    /**
+     * 设置访问模式提示（Windows上仅支持WillNeed）
+     */
+    bool advise(Advice advice) const;
+    void close();
+
+private:
+    friend PYOS_API MappedFile map_file(const std::string& filename);
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
+/**
+ * 以只读方式映射整个文件，失败时返回valid()为false的对象
+ * 空文件返回valid()为true、size()为0的对象
+ */
+PYOS_API MappedFile map_file(const std::string& filename);
+
 } // namespace os
 
 #endif // PYOS_HPP
\ No newline at end of file
@@ -0,0 +1,295 @@
+#pragma once
+// safepath.hpp - 在解压目录之下安全地创建文件、目录和符号链接
+// 条目路径来自归档，不可信：父目录逐级用openat(O_NOFOLLOW|O_DIRECTORY)打开，任何一级是符号链接时失败
+// （无论是磁盘上已有的链接还是归档中先解压出来的链接），因此不会写到解压目录之外；最后一级同样不跟随链接。
+// 已有的条目按覆盖模式处理：替换时先写入同一目录下的临时文件，提交时改名覆盖，
+// 这样既不会经过硬链接写到别处，失败或取消时原文件也保持不变。
+// Root记录本次创建的文件和目录，remove_created()只删除它们，运行前已存在的文件不受影响。
+// 只在非Windows平台上提供（available为false时由7-Zip解压）。
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <system_error>
+#include <filesystem>
+#include <cerrno>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#endif
+
+namespace safepath {
+
+#ifdef _WIN32
+constexpr bool available = false;
+#else
+constexpr bool available = true;
+
+// 目标已存在时的处理：替换、跳过、失败（errno为EEXIST）
+enum class Existing { Replace, Skip, Fail };
+
+// 把条目路径拆成各级名称，忽略空名称和"."；空路径、绝对路径和含".."的路径返回false
+inline bool split(const std::string& path, std::vector<std::string>& parts) {
+    parts.clear();
+    if (path.empty() || path[0] == '/') return false;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) end = path.size();
+        std::string name = path.substr(pos, end - pos);
+        if (name == ".." || name.find('\0') != std::string::npos) return false;
+        if (!name.empty() && name != ".") parts.push_back(std::move(name));
+        pos = end + 1;
+    }
+    return !parts.empty();
+}
+
+// 正在写入的输出文件；提交前析构时关闭文件并删除临时文件（被替换的原文件保持不变）
+class Output {
+public:
+    Output() = default;
+    ~Output() { reset(); }
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+    Output(Output&& other) noexcept { *this = std::move(other); }
+    Output& operator=(Output&& other) noexcept {
+        if (this != &other) {
+            reset();
+            fd_ = std::exchange(other.fd_, -1);
+            dir_ = std::exchange(other.dir_, -1);
+            name_ = std::move(other.name_);
+            temp_ = std::move(other.temp_);
+            skipped_ = std::exchange(other.skipped_, false);
+        }
+        return *this;
+    }
+
+    int fd() const { return fd_; }
+    explicit operator bool() const { return fd_ >= 0; }
+    // 目标已存在且覆盖模式为跳过
+    bool skipped() const { return skipped_; }
+
+private:
+    friend class Root;
+
+    void reset() {
+        if (fd_ >= 0) ::close(fd_);
+        if (!temp_.empty()) ::unlinkat(dir_, temp_.c_str(), 0);
+        if (dir_ >= 0) ::close(dir_);
+        fd_ = -1;
+        dir_ = -1;
+        temp_.clear();
+    }
+
+    int fd_ = -1;
+    int dir_ = -1;
+    std::string name_;
+    std::string temp_;
+    bool skipped_ = false;
+};
+
+// 解压目录；各方法可以在多个线程中同时调用，失败时返回false（或无效的Output）并设置errno
+class Root {
+public:
+    // 打开（必要时创建）解压目录，解压目录本身是调用者给出的，可以是符号链接
+    explicit Root(const std::string& dir) {
+        std::string path = dir.empty() ? "." : dir;
+        std::error_code ec;
+        std::filesystem::create_directories(path, ec);
+        fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    ~Root() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Root(const Root&) = delete;
+    Root& operator=(const Root&) = delete;
+
+    bool valid() const { return fd_ >= 0; }
+
+    // 逐级创建目录（已存在的保留）
+    bool make_dirs(const std::string& rel) {
+        std::vector<std::string> parts;
+        if (!split(rel, parts)) return invalid();
+        int dir = walk(parts, parts.size(), true);
+        if (dir < 0) return false;
+        ::close(dir);
+        return true;
+    }
+
+    // 打开已有的目录（用于设置权限和时间），调用者关闭返回的描述符；失败时返回-1
+    int open_dir(const std::string& rel) {
+        std::vector<std::string> parts;
+        if (!split(rel, parts)) {
+            invalid();
+            return -1;
+        }
+        return walk(parts, parts.size(), false);
+    }
+
+    // 创建要写入的普通文件，缺少的父目录一并创建；跳过时返回的Output无效且skipped()为true
+    Output create(const std::string& rel, Existing existing, mode_t mode = 0666) {
+        Output out;
+        std::vector<std::string> parts;
+        if (!split(rel, parts)) {
+            invalid();
+            return out;
+        }
+        out.dir_ = walk(parts, parts.size() - 1, true);
+        if (out.dir_ < 0) return out;
+        out.name_ = parts.back();
+        const char* name = out.name_.c_str();
+        out.fd_ = ::openat(out.dir_, name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode);
+        if (out.fd_ >= 0) {
+            record(rel, false);
+            return out;
+        }
+        if (errno != EEXIST || !replace(out.dir_, name, existing, out.skipped_)) {
+            return out;
+        }
+        for (int attempt = 0; attempt < 100 && out.fd_ < 0; ++attempt) {
+            out.temp_ = temp_name();
+            out.fd_ = ::openat(out.dir_, out.temp_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode);
+            if (out.fd_ < 0 && errno != EEXIST) break;
+        }
+        if (out.fd_ < 0) out.temp_.clear();
+        return out;
+    }
+
+    // 关闭写完的文件，替换时把临时文件改名为目标名称
+    bool commit(Output& out) {
+        int fd = std::exchange(out.fd_, -1);
+        bool ok = fd >= 0 && ::close(fd) == 0;
+        if (ok && !out.temp_.empty()) {
+            ok = ::renameat(out.dir_, out.temp_.c_str(), out.dir_, out.name_.c_str()) == 0;
+            if (ok) out.temp_.clear();
+        }
+        int error = errno;
+        out.reset();
+        errno = error;
+        return ok;
+    }
+
+    // 创建符号链接，目标原样保存（链接本身不会被跟随）；跳过时skipped为true
+    bool symlink(const std::string& rel, const std::string& target, Existing existing, bool& skipped) {
+        skipped = false;
+        std::vector<std::string> parts;
+        if (!split(rel, parts)) return invalid();
+        int dir = walk(parts, parts.size() - 1, true);
+        if (dir < 0) return false;
+        const char* name = parts.back().c_str();
+        bool ok = ::symlinkat(target.c_str(), dir, name) == 0;
+        if (ok) {
+            record(rel, false);
+        } else if (errno == EEXIST && replace(dir, name, existing, skipped)) {
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                std::string temp = temp_name();
+                if (::symlinkat(target.c_str(), dir, temp.c_str()) == 0) {
+                    ok = ::renameat(dir, temp.c_str(), dir, name) == 0;
+                    if (!ok) ::unlinkat(dir, temp.c_str(), 0);
+                    break;
+                }
+                if (errno != EEXIST) break;
+            }
+        }
+        int error = errno;
+        ::close(dir);
+        errno = error;
+        return ok;
+    }
+
+    // 删除本次创建的文件和（变空的）目录，按创建的逆序
+    void remove_created() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto it = created_.rbegin(); it != created_.rend(); ++it) {
+            std::vector<std::string> parts;
+            if (!split(it->first, parts)) continue;
+            int dir = walk(parts, parts.size() - 1, false);
+            if (dir < 0) continue;
+            ::unlinkat(dir, parts.back().c_str(), it->second ? AT_REMOVEDIR : 0);
+            ::close(dir);
+        }
+        created_.clear();
+    }
+
+    // 本次创建的条目（相对路径，是否为目录）
+    std::vector<std::pair<std::string, bool>> created() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return created_;
+    }
+
+private:
+    static bool invalid() {
+        errno = EINVAL;
+        return false;
+    }
+
+    static std::string temp_name() {
+        static std::atomic<unsigned> counter{0};
+        return ".bit7z-" + std::to_string(::getpid()) + "-" + std::to_string(counter++);
+    }
+
+    // 目标已存在时按覆盖模式判断能否替换；目录不能被文件或链接替换（EISDIR）
+    static bool replace(int dir, const char* name, Existing existing, bool& skipped) {
+        if (existing == Existing::Skip) {
+            skipped = true;
+            return false;
+        }
+        if (existing == Existing::Fail) {
+            errno = EEXIST;
+            return false;
+        }
+        struct stat st;
+        if (::fstatat(dir, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return false;
+        if (S_ISDIR(st.st_mode)) {
+            errno = EISDIR;
+            return false;
+        }
+        return true;
+    }
+
+    // 打开parts的前count级组成的目录，create时创建缺少的目录；经过符号链接时errno为ELOOP或ENOTDIR
+    int walk(const std::vector<std::string>& parts, size_t count, bool create) {
+        int dir = ::fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+        std::string rel;
+        for (size_t i = 0; i < count && dir >= 0; ++i) {
+            const char* name = parts[i].c_str();
+            rel += (i == 0 ? "" : "/") + parts[i];
+            int next = ::openat(dir, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (next < 0 && errno == ENOENT && create) {
+                if (::mkdirat(dir, name, 0777) == 0) {
+                    record(rel, true);
+                } else if (errno != EEXIST) {
+                    int error = errno;
+                    ::close(dir);
+                    errno = error;
+                    return -1;
+                }
+                next = ::openat(dir, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            }
+            int error = errno;
+            ::close(dir);
+            errno = error;
+            dir = next;
+        }
+        return dir;
+    }
+
+    void record(const std::string& rel, bool dir) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        created_.emplace_back(rel, dir);
+    }
+
+    int fd_ = -1;
+    std::mutex mtx_;
+    std::vector<std::pair<std::string, bool>> created_;
+};
+#endif
+
+} // namespace safepath
@@ -0,0 +1,262 @@
+#pragma once
+// streamsplit.hpp - 把gzip/bzip2/xz单文件压缩流切分成可以独立解码的片段
+// pigz --independent、pbzip2等工具（以及本项目的分块压缩）输出多个首尾相接的gzip成员/bzip2流，
+// xz -T、pixz输出的xz流由多个独立的块组成，块的位置和大小记录在文件末尾的索引中。
+// gzip/bzip2没有索引，只能扫描成员头：候选的成员头可能是压缩数据中的巧合，
+// 因此切分结果必须在解码失败时退回整体解码（解码器会校验每个成员的CRC和长度，错误的切分一定会失败）。
+// xz按索引切分：每组块加上新的流头、索引和流尾组成一个完整的xz流，可以交给任何xz解码器。
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "crc32.hpp"
+
+namespace streamsplit {
+
+enum class Kind { GZip, BZip2 };
+
+// gzip成员头：1F 8B 08，FLG的保留位为0，XFL为0/2/4，OS为0-13或255
+inline bool is_gzip_header(const unsigned char* p, size_t avail) {
+    if (avail < 10) return false;
+    return p[0] == 0x1F && p[1] == 0x8B && p[2] == 0x08 && (p[3] & 0xE0) == 0 &&
+           (p[8] == 0 || p[8] == 2 || p[8] == 4) && (p[9] <= 13 || p[9] == 255);
+}
+
+// bzip2流头："BZh1"-"BZh9"，后面是块头（π的BCD）或空流的流尾（√π的BCD）
+inline bool is_bzip2_header(const unsigned char* p, size_t avail) {
+    static const unsigned char block[] = { 0x31, 0x41, 0x59, 0x26, 0x53, 0x59 };
+    static const unsigned char eos[] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 };
+    if (avail < 10) return false;
+    return p[0] == 'B' && p[1] == 'Z' && p[2] == 'h' && p[3] >= '1' && p[3] <= '9' &&
+           (std::memcmp(p + 4, block, 6) == 0 || std::memcmp(p + 4, eos, 6) == 0);
+}
+
+inline bool is_member_header(Kind kind, const unsigned char* p, size_t avail) {
+    return kind == Kind::GZip ? is_gzip_header(p, avail) : is_bzip2_header(p, avail);
+}
+
+// 成员头超出上限仍未找到下一个成员（单个巨大的成员），切分没有意义
+class NotSplittable : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// 顺序读取gzip/bzip2文件，每次返回若干完整的成员：在片段达到target字节后的第一个候选成员头处切开
+class MemberSplitter {
+public:
+    // limit为单个片段的上限（0表示target的16倍），超过时抛出NotSplittable
+    MemberSplitter(std::istream& in, Kind kind, size_t target, size_t limit = 0)
+        : in_(in), kind_(kind), target_(target == 0 ? 1 : target), limit_(limit == 0 ? 16 * target_ : limit) {}
+
+    // 读取下一个片段，文件结束时返回false
+    bool next(std::vector<unsigned char>& segment) {
+        segment.swap(carry_);
+        carry_.clear();
+        size_t searched = target_;  // 从这里开始寻找候选成员头
+        for (;;) {
+            // 最后10个字节要等更多数据才能判断
+            size_t end = eof_ ? segment.size() : (segment.size() > 10 ? segment.size() - 10 : 0);
+            for (size_t pos = searched; pos < end; ++pos) {
+                const unsigned char* p = static_cast<const unsigned char*>(
+                    std::memchr(segment.data() + pos, kind_ == Kind::GZip ? 0x1F : 'B', end - pos));
+                if (p == nullptr) break;
+                pos = static_cast<size_t>(p - segment.data());
+                if (is_member_header(kind_, p, segment.size() - pos)) {
+                    carry_.assign(segment.begin() + static_cast<std::ptrdiff_t>(pos), segment.end());
+                    segment.resize(pos);
+                    return true;
+                }
+            }
+            searched = std::max(searched, end);
+            if (eof_) return !segment.empty();
+            if (segment.size() > limit_) {
+                throw NotSplittable("A member is larger than the splitting limit");
+            }
+            size_t old = segment.size();
+            segment.resize(old + kReadSize);
+            in_.read(reinterpret_cast<char*>(segment.data() + old), static_cast<std::streamsize>(kReadSize));
+            segment.resize(old + static_cast<size_t>(in_.gcount()));
+            if (in_.bad()) throw std::runtime_error("Cannot read the compressed file");
+            if (in_.eof()) eof_ = true;
+        }
+    }
+
+private:
+    static constexpr size_t kReadSize = 1 << 20;
+    std::istream& in_;
+    Kind kind_;
+    size_t target_;
+    size_t limit_;
+    bool eof_ = false;
+    std::vector<unsigned char> carry_;
+};
+
+// xz索引中的一个块
+struct XzBlock {
+    uint64_t offset;        // 块在文件中的位置
+    uint64_t unpadded;      // 不含填充的大小（块头+压缩数据+校验值）
+    uint64_t uncompressed;  // 解压后的大小
+    uint32_t stream;        // 所在流的序号
+    uint16_t flags;         // 所在流的流标志（决定校验值的类型）
+
+    uint64_t padded() const { return (unpadded + 3) & ~static_cast<uint64_t>(3); }
+};
+
+namespace detail {
+
+inline uint32_t read_le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline void write_le32(std::vector<unsigned char>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+}
+
+inline bool read_varint(const unsigned char*& p, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int i = 0; i < 9 && p < end; ++i) {
+        unsigned char b = *p++;
+        value |= static_cast<uint64_t>(b & 0x7F) << (7 * i);
+        if ((b & 0x80) == 0) return b != 0 || i == 0;  // 不允许多余的0字节
+    }
+    return false;
+}
+
+inline void write_varint(std::vector<unsigned char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+inline bool read_at(std::istream& in, uint64_t offset, unsigned char* buf, size_t size) {
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(reinterpret_cast<char*>(buf), static_cast<std::streamsize>(size));
+    return static_cast<size_t>(in.gcount()) == size;
+}
+
+} // namespace detail
+
+static const unsigned char kXzMagic[6] = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+
+// 从文件末尾向前读取所有流的索引，返回全部块（按文件顺序）；格式不符时返回false
+// （流之间允许有4字节倍数的0填充）
+inline bool read_xz_index(std::istream& in, uint64_t size, std::vector<XzBlock>& blocks) {
+    using namespace detail;
+    std::vector<std::vector<XzBlock>> streams;
+    uint64_t pos = size;
+    while (pos > 0) {
+        // 流填充
+        unsigned char word[4];
+        while (pos >= 4) {
+            if (!read_at(in, pos - 4, word, 4)) return false;
+            if (read_le32(word) != 0) break;
+            pos -= 4;
+        }
+        if (pos == 0) break;
+        if (pos < 24) return false;
+
+        unsigned char footer[12];
+        if (!read_at(in, pos - 12, footer, 12)) return false;
+        if (footer[10] != 'Y' || footer[11] != 'Z') return false;
+        if (checksum::crc32(footer + 4, 6) != read_le32(footer)) return false;
+        uint16_t flags = static_cast<uint16_t>(footer[8] | (footer[9] << 8));
+        uint64_t indexSize = (static_cast<uint64_t>(read_le32(footer + 4)) + 1) * 4;
+        if (indexSize + 24 > pos) return false;
+
+        uint64_t indexStart = pos - 12 - indexSize;
+        std::vector<unsigned char> index(static_cast<size_t>(indexSize));
+        if (!read_at(in, indexStart, index.data(), index.size())) return false;
+        if (index[0] != 0x00) return false;
+        if (checksum::crc32(index.data(), index.size() - 4) != read_le32(index.data() + index.size() - 4)) return false;
+
+        const unsigned char* p = index.data() + 1;
+        const unsigned char* end = index.data() + index.size() - 4;
+        uint64_t count;
+        if (!read_varint(p, end, count) || count > indexSize) return false;
+        std::vector<XzBlock> stream;
+        stream.reserve(static_cast<size_t>(count));
+        uint64_t blocksSize = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            XzBlock block{};
+            if (!read_varint(p, end, block.unpadded) || !read_varint(p, end, block.uncompressed)) return false;
+            if (block.unpadded == 0) return false;
+            block.flags = flags;
+            blocksSize += block.padded();
+            stream.push_back(block);
+        }
+        if (blocksSize + indexSize + 24 > pos) return false;
+
+        uint64_t streamStart = indexStart - blocksSize - 12;
+        unsigned char header[12];
+        if (!read_at(in, streamStart, header, 12)) return false;
+        if (std::memcmp(header, kXzMagic, 6) != 0) return false;
+        if (header[6] != footer[8] || header[7] != footer[9]) return false;
+        if (checksum::crc32(header + 6, 2) != read_le32(header + 8)) return false;
+
+        uint64_t offset = streamStart + 12;
+        for (auto& block : stream) {
+            block.offset = offset;
+            offset += block.padded();
+        }
+        streams.push_back(std::move(stream));
+        pos = streamStart;
+    }
+
+    blocks.clear();
+    uint32_t number = 0;
+    for (auto it = streams.rbegin(); it != streams.rend(); ++it, ++number) {
+        for (auto& block : *it) {
+            block.stream = number;
+            blocks.push_back(block);
+        }
+    }
+    return true;
+}
+
+// 把同一个流中连续的若干块（data为它们在文件中的原始字节，含填充）包装成一个完整的xz流
+inline std::vector<unsigned char> make_xz_stream(const XzBlock* first, size_t count, const unsigned char* data, size_t size) {
+    using namespace detail;
+    std::vector<unsigned char> out;
+    out.reserve(size + 64 + count * 16);
+    unsigned char flags[2] = { static_cast<unsigned char>(first->flags & 0xFF), static_cast<unsigned char>(first->flags >> 8) };
+
+    out.insert(out.end(), kXzMagic, kXzMagic + 6);
+    out.push_back(flags[0]);
+    out.push_back(flags[1]);
+    write_le32(out, checksum::crc32(flags, 2));
+
+    out.insert(out.end(), data, data + size);
+
+    size_t indexStart = out.size();
+    out.push_back(0x00);
+    write_varint(out, count);
+    for (size_t i = 0; i < count; ++i) {
+        write_varint(out, first[i].unpadded);
+        write_varint(out, first[i].uncompressed);
+    }
+    while ((out.size() - indexStart) % 4 != 0) out.push_back(0x00);
+    write_le32(out, checksum::crc32(out.data() + indexStart, out.size() - indexStart));
+    uint32_t backward = static_cast<uint32_t>((out.size() - indexStart) / 4 - 1);
+
+    std::vector<unsigned char> tail;
+    write_le32(tail, backward);
+    tail.push_back(flags[0]);
+    tail.push_back(flags[1]);
+    write_le32(out, checksum::crc32(tail.data(), tail.size()));
+    out.insert(out.end(), tail.begin(), tail.end());
+    out.push_back('Y');
+    out.push_back('Z');
+    return out;
+}
+
+} // namespace streamsplit
@@ -0,0 +1,447 @@
+#pragma once
+// tarnative.hpp - 不经过7-Zip的tar读写（只存储不压缩的tar）
+// tar的数据部分就是文件内容本身，只需要生成/解析512字节的头部，数据由内核在文件之间直接复制：
+// 依次尝试copy_file_range（同一文件系统上可能直接共享数据块）、sendfile，最后退回read/write。
+// 头部的布局与7-Zip的tar写入器（GNU格式）相同：数字为定长补零的八进制，超出范围时用base-256，
+// 长于100字节的名称和链接目标放在前面的././@LongLink记录（L/K）中，归档以两个全零记录结束。
+// 读取时支持ustar/GNU/pax头部，列出所有类型的条目；调用者不能处理的类型（链接、设备等）交给7-Zip。
+// 只含普通文件和目录的归档可以直接解压：路径经safepath::Root解析，失败或取消时只删除本次创建的文件。
+// Windows上没有内核复制（available为false），只能生成和解析头部。
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#endif
+#ifdef __linux__
+    #include <sys/sendfile.h>
+#endif
+
+#include "safepath.hpp"
+
+namespace tarnative {
+
+// 内核复制（Fd、write_all、copy_data）只在非Windows平台上提供，头部的生成和解析在所有平台上可用
+#ifdef _WIN32
+constexpr bool available = false;
+#else
+constexpr bool available = true;
+#endif
+
+constexpr size_t kRecord = 512;
+
+// 条目头部中与内容相关的字段（所有者固定为0，与7-Zip默认不保存所有者相同）
+struct Header {
+    std::string name;      // 目录以'/'结尾
+    char type = '0';       // '0'普通文件，'5'目录，'2'符号链接，'1'硬链接等
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    int64_t mtime = 0;
+    std::string link;
+};
+
+// 读取时找到的一个条目，offset为数据在归档中的位置，stored为数据占用的字节数（不含填充）
+struct Member {
+    Header header;
+    uint64_t offset = 0;
+    uint64_t stored = 0;
+};
+
+inline uint64_t padded(uint64_t size) {
+    return (size + kRecord - 1) / kRecord * kRecord;
+}
+
+#ifndef _WIN32
+// 自动关闭的文件描述符
+class Fd {
+public:
+    Fd() = default;
+    explicit Fd(int fd) : fd_(fd) {}
+    ~Fd() { close(); }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+    Fd(Fd&& other) noexcept : fd_(other.fd_) { other.fd_ = -1; }
+
+    int get() const { return fd_; }
+    explicit operator bool() const { return fd_ >= 0; }
+
+    // 返回close的结果（写入的文件在关闭时才可能报告错误）
+    bool close() {
+        if (fd_ < 0) return true;
+        int result = ::close(fd_);
+        fd_ = -1;
+        return result == 0;
+    }
+
+private:
+    int fd_ = -1;
+};
+#endif
+
+namespace detail {
+
+// width个字节：width-1位补零的八进制，最后一个字节为0；放不下时返回false
+inline bool put_octal(char* field, size_t width, uint64_t value) {
+    size_t digits = width - 1;
+    if (digits < 22 && (value >> (3 * digits)) != 0) return false;
+    for (size_t i = 0; i < digits; ++i) {
+        field[digits - 1 - i] = static_cast<char>('0' + (value & 7));
+        value >>= 3;
+    }
+    field[digits] = 0;
+    return true;
+}
+
+// 放不下八进制的数用GNU的base-256（首字节0x80，其余为大端）
+inline void put_number(char* field, size_t width, uint64_t value) {
+    if (put_octal(field, width, value)) return;
+    std::memset(field, 0, width);
+    field[0] = static_cast<char>(0x80);
+    for (size_t i = 0; i < 8 && i < width - 1; ++i) {
+        field[width - 1 - i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+inline bool get_number(const unsigned char* field, size_t width, uint64_t& value) {
+    value = 0;
+    if (field[0] & 0x80) {
+        if (field[0] != 0x80) return false;  // 负数
+        for (size_t i = 1; i < width; ++i) {
+            if (value >> 56) return false;
+            value = (value << 8) | field[i];
+        }
+        return true;
+    }
+    size_t i = 0;
+    while (i < width && field[i] == ' ') ++i;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i) {
+        if (value >> 61) return false;
+        value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+    }
+    return i == width || field[i] == 0 || field[i] == ' ';
+}
+
+inline std::string get_string(const unsigned char* field, size_t width) {
+    const unsigned char* end = static_cast<const unsigned char*>(std::memchr(field, 0, width));
+    return std::string(reinterpret_cast<const char*>(field), end ? static_cast<size_t>(end - field) : width);
+}
+
+// 校验和：头部所有字节之和，校验和字段按8个空格计算（写法为6位八进制、0、空格）
+inline void put_checksum(char* record) {
+    std::memset(record + 148, ' ', 8);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < kRecord; ++i) sum += static_cast<unsigned char>(record[i]);
+    for (int i = 0; i < 6; ++i) {
+        record[148 + 5 - i] = static_cast<char>('0' + (sum & 7));
+        sum >>= 3;
+    }
+    record[154] = 0;
+    record[155] = ' ';
+}
+
+// 部分旧的tar按有符号字节计算校验和
+inline bool checksum_ok(const unsigned char* record) {
+    uint64_t stored;
+    if (!get_number(record + 148, 8, stored)) return false;
+    uint32_t sum = 0;
+    int32_t signedSum = 0;
+    for (size_t i = 0; i < kRecord; ++i) {
+        unsigned char b = (i >= 148 && i < 156) ? ' ' : record[i];
+        sum += b;
+        signedSum += static_cast<signed char>(b);
+    }
+    return stored == sum || static_cast<int64_t>(stored) == signedSum;
+}
+
+inline void append_record(std::vector<char>& out, const std::string& name, char type, uint64_t size,
+                          uint32_t mode, int64_t mtime, const std::string& link) {
+    size_t start = out.size();
+    out.resize(start + kRecord, 0);
+    char* record = out.data() + start;
+    std::memcpy(record, name.data(), std::min<size_t>(name.size(), 100));
+    put_number(record + 100, 8, mode);
+    put_number(record + 108, 8, 0);
+    put_number(record + 116, 8, 0);
+    put_number(record + 124, 12, size);
+    put_number(record + 136, 12, mtime > 0 ? static_cast<uint64_t>(mtime) : 0);
+    record[156] = type;
+    std::memcpy(record + 157, link.data(), std::min<size_t>(link.size(), 100));
+    std::memcpy(record + 257, "ustar  ", 8);  // GNU的magic和version（含结尾的0）
+    put_checksum(record);
+}
+
+// 长名称记录：数据为名称加结尾的0
+inline void append_long(std::vector<char>& out, char type, const std::string& value) {
+    append_record(out, "././@LongLink", type, value.size() + 1, 0, 0, std::string());
+    size_t start = out.size();
+    out.resize(start + padded(value.size() + 1), 0);
+    std::memcpy(out.data() + start, value.data(), value.size());
+}
+
+// pax扩展头部中的path、linkpath、size和mtime（"长度 键=值\n"）
+inline bool parse_pax(const std::string& data, Header& header, bool& hasPath, bool& hasLink, bool& hasSize) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t space = data.find(' ', pos);
+        if (space == std::string::npos || space == pos || space - pos > 18) return false;
+        size_t length = 0;
+        for (size_t i = pos; i < space; ++i) {
+            if (data[i] < '0' || data[i] > '9') return false;
+            length = length * 10 + static_cast<size_t>(data[i] - '0');
+        }
+        if (length <= space + 1 - pos || pos + length > data.size() || data[pos + length - 1] != '\n') return false;
+        std::string record = data.substr(space + 1, pos + length - 1 - space - 1);
+        size_t equal = record.find('=');
+        if (equal == std::string::npos) return false;
+        std::string key = record.substr(0, equal);
+        std::string value = record.substr(equal + 1);
+        if (key == "path") {
+            header.name = value;
+            hasPath = true;
+        } else if (key == "linkpath") {
+            header.link = value;
+            hasLink = true;
+        } else if (key == "size") {
+            header.size = std::strtoull(value.c_str(), nullptr, 10);
+            hasSize = true;
+        } else if (key == "mtime") {
+            header.mtime = std::strtoll(value.c_str(), nullptr, 10);
+        }
+        pos += length;
+    }
+    return true;
+}
+
+} // namespace detail
+
+// 生成一个条目的头部（需要时前面加上长名称记录），追加到out
+inline void append_header(std::vector<char>& out, const Header& header) {
+    if (header.name.size() > 100) detail::append_long(out, 'L', header.name);
+    if (header.link.size() > 100) detail::append_long(out, 'K', header.link);
+    detail::append_record(out, header.name, header.type, header.type == '0' ? header.size : 0,
+                          header.mode, header.mtime, header.link);
+}
+
+// 归档的结尾：两个全零记录
+inline void append_end(std::vector<char>& out) {
+    out.resize(out.size() + 2 * kRecord, 0);
+}
+
+// 补齐size个字节的数据后面的填充
+inline void append_padding(std::vector<char>& out, uint64_t size) {
+    out.resize(out.size() + static_cast<size_t>(padded(size) - size), 0);
+}
+
+#ifndef _WIN32
+inline void write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::system_error(errno, std::generic_category(), "Cannot write the file");
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+// 从in的当前位置复制size个字节到out的当前位置，每复制一段调用一次step（参数为这一段的字节数）
+// in比size短时抛出异常（文件在复制过程中被截短）
+inline void copy_data(int in, int out, uint64_t size, const std::function<void(uint64_t)>& step) {
+    static constexpr uint64_t kChunk = 64u << 20;
+    enum { CopyFileRange, SendFile, ReadWrite };
+#ifdef __linux__
+    int method = CopyFileRange;
+#else
+    int method = ReadWrite;
+#endif
+    std::vector<char> buffer;
+    while (size > 0) {
+        size_t want = static_cast<size_t>(std::min(size, kChunk));
+        ssize_t n;
+#ifdef __linux__
+        if (method == CopyFileRange) {
+            n = ::copy_file_range(in, nullptr, out, nullptr, want, 0);
+            // 跨文件系统、内核或文件系统不支持：换下一种方法（之前的调用没有复制任何数据）
+            if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF)) {
+                method = SendFile;
+                continue;
+            }
+        } else if (method == SendFile) {
+            n = ::sendfile(out, in, nullptr, want);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                method = ReadWrite;
+                continue;
+            }
+        } else
+#endif
+        {
+            if (buffer.empty()) buffer.resize(1u << 20);
+            n = ::read(in, buffer.data(), std::min(want, buffer.size()));
+            if (n > 0) write_all(out, buffer.data(), static_cast<size_t>(n));
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::system_error(errno, std::generic_category(), "Cannot copy the file data");
+        if (n == 0) throw std::runtime_error("The file is shorter than its size when it was listed");
+        size -= static_cast<uint64_t>(n);
+        if (step) step(static_cast<uint64_t>(n));
+    }
+}
+
+#endif
+
+// 列出归档（data为映射到内存的整个文件）中的全部条目，只读取头部
+// type为头部中的类型（'\0'和'7'记为'0'），GNU稀疏文件（'S'）的size为展开后的大小；头部损坏时返回false
+inline bool scan(const unsigned char* data, uint64_t archiveSize, std::vector<Member>& members) {
+    using namespace detail;
+    members.clear();
+    uint64_t pos = 0;
+    Header pending;
+    bool hasPath = false, hasLink = false, hasSize = false;
+    while (pos + kRecord <= archiveSize) {
+        const unsigned char* record = data + pos;
+        bool zero = true;
+        for (size_t i = 0; i < kRecord && zero; ++i) zero = record[i] == 0;
+        if (zero) return true;
+        if (!checksum_ok(record)) return false;
+
+        uint64_t size, mode, mtime;
+        if (!get_number(record + 124, 12, size) || !get_number(record + 100, 8, mode) ||
+            !get_number(record + 136, 12, mtime)) return false;
+        char type = static_cast<char>(record[156]);
+        if (hasSize) size = pending.size;
+        // 硬链接、设备、目录等没有数据
+        uint64_t stored = (type == '1' || type == '2' || type == '3' || type == '4' || type == '5' || type == '6') ? 0 : size;
+        uint64_t offset = pos + kRecord;
+        if (stored > archiveSize || offset + padded(stored) > archiveSize) return false;
+        pos = offset + padded(stored);
+
+        if (type == 'L' || type == 'K' || type == 'x') {
+            if (size > (1u << 20)) return false;
+            std::string value(reinterpret_cast<const char*>(data + offset), static_cast<size_t>(size));
+            if (type == 'x') {
+                if (!parse_pax(value, pending, hasPath, hasLink, hasSize)) return false;
+                continue;
+            }
+            value.resize(std::strlen(value.c_str()));
+            if (type == 'L') {
+                pending.name = value;
+                hasPath = true;
+            } else {
+                pending.link = value;
+                hasLink = true;
+            }
+            continue;
+        }
+        if (type == 'g') continue;
+
+        Member member;
+        Header& header = member.header;
+        if (hasPath) {
+            header.name = pending.name;
+        } else {
+            header.name = get_string(record, 100);
+            // POSIX ustar的prefix字段（GNU格式中这里是其他数据）
+            if (std::memcmp(record + 257, "ustar\0", 6) == 0 && record[345] != 0) {
+                header.name = get_string(record + 345, 155) + "/" + header.name;
+            }
+        }
+        header.link = hasLink ? pending.link : get_string(record + 157, 100);
+        header.size = size;
+        header.mode = static_cast<uint32_t>(mode);
+        header.mtime = pending.mtime != 0 ? pending.mtime : static_cast<int64_t>(mtime);
+        if (type == '\0' || type == '7') type = '0';
+        if (type == '0' && !header.name.empty() && header.name.back() == '/' && size == 0) type = '5';
+        if (type == 'S') {
+            uint64_t real;
+            if (get_number(record + 483, 12, real)) header.size = real;
+        }
+        header.type = type;
+        member.offset = offset;
+        member.stored = stored;
+        members.push_back(std::move(member));
+
+        pending = Header();
+        hasPath = hasLink = hasSize = false;
+    }
+    return pos == archiveSize;
+}
+
+#ifndef _WIN32
+// 能否直接解压：只有普通文件和目录，且路径都能在解压目录之下解析；否则交给7-Zip，什么也不写
+inline bool extractable(const std::vector<Member>& members) {
+    std::vector<std::string> parts;
+    for (const auto& member : members) {
+        if (member.header.type != '0' && member.header.type != '5') return false;
+        if (!safepath::split(member.header.name, parts)) return false;
+    }
+    return true;
+}
+
+// 把归档（archive为打开的描述符）中offset处的size字节复制为root之下的文件rel，设置权限（mode为0时不设置）和修改时间
+// verify在提交前调用（例如检查与复制同时计算的CRC），它抛出异常时文件不会提交；目标已存在而被跳过时返回false
+// 失败时抛出std::system_error，已创建的文件由调用者用root.remove_created()删除
+inline bool copy_range(int archive, uint64_t offset, uint64_t size, safepath::Root& root, const std::string& rel,
+                       safepath::Existing existing, uint32_t mode, int64_t mtime_ns,
+                       const std::function<void(uint64_t)>& step, const std::function<void()>& verify = nullptr) {
+    auto fail = [&rel](const std::string& what) {
+        throw std::system_error(errno, std::generic_category(), what + ": " + rel);
+    };
+    safepath::Output out = root.create(rel, existing);
+    if (out.skipped()) return false;
+    if (!out) fail("Cannot create the output file");
+    if (::lseek(archive, static_cast<off_t>(offset), SEEK_SET) < 0) fail("Cannot read the archive at");
+    copy_data(archive, out.fd(), size, step);
+    if (verify) verify();
+    if (mode != 0) ::fchmod(out.fd(), static_cast<mode_t>(mode & 0777));
+    struct timespec times[2] = {{0, UTIME_OMIT}, {static_cast<time_t>(mtime_ns / 1000000000), static_cast<long>(mtime_ns % 1000000000)}};
+    ::futimens(out.fd(), times);
+    if (!root.commit(out)) fail("Cannot write the output file");
+    return true;
+}
+
+// 把extractable的条目从归档解压到root之下，恢复权限和修改时间
+// onMember在处理每个条目前调用，step报告复制的字节数（已存在而被跳过的文件也计入）；
+// 失败时抛出std::system_error，已写的文件由调用者用root.remove_created()删除
+inline void extract(int archive, const std::vector<Member>& members, safepath::Root& root, safepath::Existing existing,
+                    const std::function<void(const std::string&)>& onMember, const std::function<void(uint64_t)>& step) {
+    for (const auto& member : members) {
+        const Header& header = member.header;
+        if (onMember) onMember(header.name);
+        if (header.type == '5') {
+            if (!root.make_dirs(header.name)) {
+                throw std::system_error(errno, std::generic_category(), "Cannot create the directory: " + header.name);
+            }
+            continue;
+        }
+        if (!copy_range(archive, member.offset, header.size, root, header.name, existing, header.mode,
+                        header.mtime * 1000000000, step) && step) {
+            step(header.size);
+        }
+    }
+    // 目录的时间最后设置，因为写入其中的内容会改变它
+    for (size_t i = members.size(); i-- > 0;) {
+        const Header& header = members[i].header;
+        if (header.type != '5') continue;
+        int dir = root.open_dir(header.name);
+        if (dir < 0) continue;
+        if (header.mode != 0) ::fchmod(dir, static_cast<mode_t>((header.mode & 0777) | 0700));
+        struct timespec times[2] = {{0, UTIME_OMIT}, {static_cast<time_t>(header.mtime), 0}};
+        ::futimens(dir, times);
+        ::close(dir);
+    }
+}
+#endif
+
+} // namespace tarnative
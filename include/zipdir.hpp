@@ -0,0 +1,394 @@
+#pragma once
+// zipdir.hpp - ZIP中央目录的解析（不经过7-Zip）
+// ZIP文件末尾的中央目录列出了所有条目的名称、大小、CRC、压缩方法和本地头部的位置，
+// 读取条目列表、定位存储（不压缩）条目的数据都只需要解析它，不必打开7-Zip的处理器。
+// 支持ZIP64（大小、位置超过4GB或条目超过65535个）以及前面带有其他数据的ZIP（自解压文件等）。
+// item_path、is_dir、attributes、modified按7-Zip的ZIP处理器的规则给出条目的元数据。
+// metadata_patches计算改写条目的修改时间和属性所需的字节，用于在7-Zip写出ZIP之后补上它没有写入的元数据。
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+
+#include "crc32.hpp"
+
+namespace zipdir {
+
+// 创建系统（madeBy的高字节）
+enum HostOS : uint8_t { kFAT = 0, kUnix = 3, kHPFS = 6, kNTFS = 11, kVFAT = 14 };
+
+struct Entry {
+    std::string name;           // 原始字节（flags的bit 11为1时是UTF-8）
+    uint16_t madeBy = 0;        // 高字节为创建系统（3为Unix）
+    uint16_t flags = 0;
+    uint16_t method = 0;        // 0为存储，8为Deflate
+    uint32_t dosTime = 0;       // MS-DOS格式的修改时间（日期在高16位）
+    uint32_t crc = 0;
+    uint64_t compressed = 0;
+    uint64_t size = 0;
+    uint64_t localOffset = 0;   // 本地头部在文件中的位置（已加上前缀数据的长度）
+    uint64_t centralOffset = 0; // 中央目录中的记录在文件中的位置
+    uint32_t externalAttributes = 0;
+    int64_t mtime = 0;          // 扩展时间戳（0x5455）中的Unix修改时间
+    bool hasMtime = false;
+    uint64_t ntfsMtime = 0;     // NTFS扩展字段（0x000A）中的修改时间（FILETIME）
+    bool hasNtfsMtime = false;
+    std::string unicodeName;    // Info-ZIP Unicode Path扩展字段（0x7075）中的UTF-8名称（与name的CRC相符时）
+
+    bool encrypted() const { return (flags & 1) != 0; }
+    bool utf8() const { return (flags & 0x800) != 0; }
+    uint8_t host() const { return static_cast<uint8_t>(madeBy >> 8); }
+    bool windowsHost() const { return host() == kFAT || host() == kNTFS || host() == kHPFS || host() == kVFAT; }
+};
+
+struct Directory {
+    std::vector<Entry> entries;
+    uint64_t prefix = 0;        // 前缀数据的长度
+    std::string comment;
+};
+
+namespace detail {
+
+inline uint16_t le16(const unsigned char* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+inline uint64_t le64(const unsigned char* p) {
+    return static_cast<uint64_t>(le32(p)) | (static_cast<uint64_t>(le32(p + 4)) << 32);
+}
+
+// 扩展字段：ZIP64（0x0001）按需要的顺序保存32位字段为0xFFFFFFFF的值，扩展时间戳（0x5455）保存Unix时间
+inline bool parse_extra(const unsigned char* p, size_t size, Entry& entry, bool needSize, bool needCompressed, bool needOffset) {
+    while (size >= 4) {
+        uint16_t id = le16(p);
+        uint16_t length = le16(p + 2);
+        if (static_cast<size_t>(length) + 4 > size) break;
+        const unsigned char* data = p + 4;
+        if (id == 0x0001) {
+            size_t pos = 0;
+            if (needSize) {
+                if (pos + 8 > length) return false;
+                entry.size = le64(data + pos);
+                pos += 8;
+            }
+            if (needCompressed) {
+                if (pos + 8 > length) return false;
+                entry.compressed = le64(data + pos);
+                pos += 8;
+            }
+            if (needOffset) {
+                if (pos + 8 > length) return false;
+                entry.localOffset = le64(data + pos);
+                pos += 8;
+            }
+            needSize = needCompressed = needOffset = false;
+        } else if (id == 0x5455 && length >= 5 && (data[0] & 1) != 0) {
+            entry.mtime = static_cast<int32_t>(le32(data + 1));
+            entry.hasMtime = true;
+        } else if (id == 0x000A && length >= 32 && le16(data + 4) == 1 && le16(data + 6) >= 24) {
+            entry.ntfsMtime = le64(data + 8);
+            entry.hasNtfsMtime = true;
+        } else if (id == 0x7075 && length >= 5 && data[0] == 1 &&
+                   le32(data + 1) == checksum::crc32(entry.name.data(), entry.name.size())) {
+            entry.unicodeName.assign(reinterpret_cast<const char*>(data + 5), length - 5u);
+        }
+        p += 4 + length;
+        size -= 4 + static_cast<size_t>(length);
+    }
+    return !needSize && !needCompressed && !needOffset;
+}
+
+} // namespace detail
+
+// 从文件的全部内容解析中央目录，不是ZIP或结构损坏时返回false
+inline bool read_directory(const unsigned char* data, size_t size, Directory& directory) {
+    using namespace detail;
+    if (size < 22) return false;
+
+    // 中央目录结束记录在文件的最后22+65535个字节中
+    size_t eocd = size;
+    size_t lowest = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+    for (size_t pos = size - 22 + 1; pos-- > lowest;) {
+        if (le32(data + pos) == 0x06054b50 && pos + 22 + le16(data + pos + 20) <= size) {
+            eocd = pos;
+            break;
+        }
+    }
+    if (eocd == size) return false;
+    const unsigned char* end = data + eocd;
+    if (le16(end + 4) != 0 || le16(end + 6) != 0) return false;  // 分卷
+    uint64_t count = le16(end + 10);
+    uint64_t cdSize = le32(end + 12);
+    uint64_t cdOffset = le32(end + 16);
+    uint64_t cdEnd = eocd;
+
+    // ZIP64：结束记录前面的定位器指向ZIP64结束记录
+    if (eocd >= 20 && le32(data + eocd - 20) == 0x07064b50) {
+        uint64_t locator = eocd - 20;
+        uint64_t z64 = le64(data + locator + 8);
+        // 记录的长度字段（不含前12个字节）使记录正好在定位器处结束；记录后面可能有扩展数据
+        auto ends_at_locator = [&](uint64_t pos) {
+            return pos + 56 <= locator && le32(data + pos) == 0x06064b50 && le64(data + pos + 4) == locator - pos - 12;
+        };
+        // 有前缀数据时记录的位置偏小，在定位器前面按长度字段寻找
+        uint64_t record = locator;
+        if (ends_at_locator(z64)) {
+            record = z64;
+        } else {
+            uint64_t lowest = locator > 56 + 0xFFFF ? locator - 56 - 0xFFFF : 0;
+            for (uint64_t pos = locator >= 56 ? locator - 56 + 1 : 0; pos-- > lowest;) {
+                if (ends_at_locator(pos)) {
+                    record = pos;
+                    break;
+                }
+            }
+        }
+        if (record == locator || z64 > record) return false;
+        const unsigned char* rec = data + record;
+        count = le64(rec + 32);
+        cdSize = le64(rec + 40);
+        cdOffset = le64(rec + 48);
+        cdEnd = record;
+    }
+    if (cdSize > cdEnd) return false;
+    uint64_t cdStart = cdEnd - cdSize;
+    if (cdOffset > cdStart) return false;
+    directory.prefix = cdStart - cdOffset;
+    directory.comment.assign(reinterpret_cast<const char*>(end + 22), le16(end + 20));
+
+    directory.entries.clear();
+    directory.entries.reserve(static_cast<size_t>(std::min<uint64_t>(count, cdSize / 46)));
+    uint64_t pos = cdStart;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (pos + 46 > cdEnd || le32(data + pos) != 0x02014b50) return false;
+        const unsigned char* rec = data + pos;
+        Entry entry;
+        entry.centralOffset = pos;
+        entry.madeBy = le16(rec + 4);
+        entry.flags = le16(rec + 8);
+        entry.method = le16(rec + 10);
+        entry.dosTime = le32(rec + 12);
+        entry.crc = le32(rec + 16);
+        entry.compressed = le32(rec + 20);
+        entry.size = le32(rec + 24);
+        uint16_t nameLength = le16(rec + 28);
+        uint16_t extraLength = le16(rec + 30);
+        uint16_t commentLength = le16(rec + 32);
+        entry.externalAttributes = le32(rec + 38);
+        entry.localOffset = le32(rec + 42);
+        uint64_t next = pos + 46 + nameLength + extraLength + commentLength;
+        if (next > cdEnd) return false;
+        entry.name.assign(reinterpret_cast<const char*>(rec + 46), nameLength);
+        if (!parse_extra(rec + 46 + nameLength, extraLength, entry, entry.size == 0xFFFFFFFF,
+                         entry.compressed == 0xFFFFFFFF, entry.localOffset == 0xFFFFFFFF)) return false;
+        entry.localOffset += directory.prefix;
+        directory.entries.push_back(std::move(entry));
+        pos = next;
+    }
+    return true;
+}
+
+// 条目数据在文件中的位置（跳过本地头部），本地头部损坏或数据超出文件时返回false
+inline bool data_offset(const unsigned char* data, size_t size, const Entry& entry, uint64_t& offset) {
+    using namespace detail;
+    if (entry.localOffset > size || size - entry.localOffset < 30) return false;
+    const unsigned char* local = data + entry.localOffset;
+    if (le32(local) != 0x04034b50) return false;
+    offset = entry.localOffset + 30 + le16(local + 26) + le16(local + 28);
+    return offset <= size && size - offset >= entry.compressed;
+}
+
+namespace detail {
+
+inline bool valid_utf8(const std::string& text) {
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2 : (c >> 3) == 0x1E ? 3 : 4;
+        if (extra == 4 || i + extra >= text.size()) return false;
+        for (size_t k = 1; k <= extra; ++k) {
+            if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80) return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+inline void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// 没有UTF-8标志的名称按IBM437（DOS的默认代码页）解码
+inline std::string cp437_to_utf8(const std::string& text) {
+    static const uint16_t high[128] = {
+        0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+        0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+        0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+        0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+        0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+        0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+        0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+        0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+        0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+        0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+        0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+        0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+        0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+        0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+        0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+        0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+    };
+    std::string out;
+    out.reserve(text.size());
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        append_utf8(out, c < 0x80 ? c : high[c - 0x80]);
+    }
+    return out;
+}
+
+} // namespace detail
+
+// 7-Zip的判断：名称以'/'结尾（Windows创建的空条目也可以以反斜杠结尾），或者属性中的目录标志
+inline bool is_dir(const Entry& entry) {
+    if (!entry.name.empty() && entry.name.back() == '/') return true;
+    if (entry.windowsHost() && entry.size == 0 && entry.compressed == 0 && !entry.name.empty() && entry.name.back() == '\\') return true;
+    if (entry.windowsHost()) return (entry.externalAttributes & 0x10) != 0;
+    if (entry.host() == kUnix) return ((entry.externalAttributes >> 16) & 0170000) == 0040000;
+    return false;
+}
+
+// 7-Zip报告的属性：Windows创建的条目为外部属性，Unix创建的条目为高16位的权限加上0x8000标志，目录再加上0x10
+inline uint32_t attributes(const Entry& entry) {
+    uint32_t result = 0;
+    if (entry.host() == kFAT || entry.host() == kNTFS) {
+        result = entry.externalAttributes;
+    } else if (entry.host() == kUnix) {
+        result = (entry.externalAttributes & 0xFFFF0000u) | 0x8000u;
+    }
+    if (is_dir(entry)) result |= 0x10;
+    return result;
+}
+
+// 条目在归档中的路径（UTF-8，目录没有结尾的'/'，Windows创建的条目中的反斜杠换成'/'）
+inline std::string item_path(const Entry& entry) {
+    std::string path;
+    if (!entry.unicodeName.empty()) {
+        path = entry.unicodeName;
+    } else if (entry.utf8() || detail::valid_utf8(entry.name)) {
+        path = entry.name;
+    } else {
+        path = detail::cp437_to_utf8(entry.name);
+    }
+    if (entry.windowsHost()) std::replace(path.begin(), path.end(), '\\', '/');
+    while (!path.empty() && path.back() == '/') path.pop_back();
+    return path;
+}
+
+// 修改时间（Unix时间）：NTFS时间优先，其次是扩展时间戳，最后是按本地时间解释的MS-DOS时间
+inline int64_t modified(const Entry& entry) {
+    if (entry.hasNtfsMtime) return static_cast<int64_t>(entry.ntfsMtime / 10000000) - 11644473600LL;
+    if (entry.hasMtime) return entry.mtime;
+    if (entry.dosTime == 0) return 0;
+    std::tm tm{};
+    tm.tm_year = static_cast<int>((entry.dosTime >> 25) & 0x7F) + 80;
+    tm.tm_mon = static_cast<int>((entry.dosTime >> 21) & 0x0F) - 1;
+    tm.tm_mday = static_cast<int>((entry.dosTime >> 16) & 0x1F);
+    tm.tm_hour = static_cast<int>((entry.dosTime >> 11) & 0x1F);
+    tm.tm_min = static_cast<int>((entry.dosTime >> 5) & 0x3F);
+    tm.tm_sec = static_cast<int>(entry.dosTime & 0x1F) * 2;
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm));
+}
+
+// 改写已有条目的元数据时要写入文件的字节，条目的数据、CRC和记录的长度都不变
+struct Patch {
+    uint64_t offset;
+    std::vector<unsigned char> bytes;
+};
+
+namespace detail {
+
+inline void add_patch(std::vector<Patch>& patches, uint64_t offset, uint64_t value, size_t bytes) {
+    Patch patch{ offset, std::vector<unsigned char>(bytes) };
+    for (size_t i = 0; i < bytes; ++i) patch.bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    patches.push_back(std::move(patch));
+}
+
+// 扩展字段中已有的时间戳：NTFS（0x000A）的修改时间和扩展时间戳（0x5455）的修改时间
+inline void patch_extra_times(const unsigned char* data, uint64_t offset, size_t size, int64_t mtime, uint64_t filetime,
+                              std::vector<Patch>& patches) {
+    size_t pos = 0;
+    while (pos + 4 <= size) {
+        uint16_t id = le16(data + offset + pos);
+        uint16_t length = le16(data + offset + pos + 2);
+        if (pos + 4 + length > size) break;
+        const unsigned char* field = data + offset + pos + 4;
+        if (id == 0x000A && length >= 32 && le16(field + 4) == 1 && le16(field + 6) >= 24) {
+            add_patch(patches, offset + pos + 4 + 8, filetime, 8);
+        } else if (id == 0x5455 && length >= 5 && (field[0] & 1) != 0) {
+            add_patch(patches, offset + pos + 4 + 1, static_cast<uint32_t>(mtime), 4);
+        }
+        pos += 4 + static_cast<size_t>(length);
+    }
+}
+
+} // namespace detail
+
+// 按本地时间转换为MS-DOS格式（精度2秒，1980年以前取1980年1月1日）
+inline uint32_t dos_time(int64_t mtime) {
+    std::time_t time = static_cast<std::time_t>(mtime);
+    std::tm tm{};
+#ifdef _WIN32
+    if (localtime_s(&tm, &time) != 0) return 0x00210000;
+#else
+    if (!localtime_r(&time, &tm)) return 0x00210000;
+#endif
+    if (tm.tm_year < 80) return 0x00210000;
+    return (static_cast<uint32_t>(tm.tm_year - 80) << 25) | (static_cast<uint32_t>(tm.tm_mon + 1) << 21) |
+           (static_cast<uint32_t>(tm.tm_mday) << 16) | (static_cast<uint32_t>(tm.tm_hour) << 11) |
+           (static_cast<uint32_t>(tm.tm_min) << 5) | (static_cast<uint32_t>(tm.tm_sec / 2));
+}
+
+// 把条目的修改时间和属性（7-Zip的表示，与attributes的结果相同）改为给定的值：
+// 中央目录和本地头部中的MS-DOS时间、扩展字段中已有的时间戳、创建系统和外部属性。
+// 带0x8000标志的属性记为Unix创建（高16位为权限），否则记为FAT创建。本地头部损坏时返回false
+inline bool metadata_patches(const unsigned char* data, size_t size, const Entry& entry, int64_t mtime, uint64_t filetime,
+                             uint32_t attributes, std::vector<Patch>& patches) {
+    using namespace detail;
+    uint64_t central = entry.centralOffset;
+    if (central > size || size - central < 46 || le32(data + central) != 0x02014b50) return false;
+    if (entry.localOffset > size || size - entry.localOffset < 30 || le32(data + entry.localOffset) != 0x04034b50) return false;
+    uint64_t centralExtra = central + 46 + le16(data + central + 28);
+    uint64_t localExtra = entry.localOffset + 30 + le16(data + entry.localOffset + 26);
+    size_t centralExtraLength = le16(data + central + 30);
+    size_t localExtraLength = le16(data + entry.localOffset + 28);
+    if (centralExtra + centralExtraLength > size || localExtra + localExtraLength > size) return false;
+
+    bool unixHost = (attributes & 0x8000u) != 0;
+    uint16_t madeBy = static_cast<uint16_t>(((unixHost ? kUnix : kFAT) << 8) | (entry.madeBy & 0xFF));
+    add_patch(patches, central + 4, madeBy, 2);
+    add_patch(patches, central + 38, unixHost ? (attributes & ~0x8000u) : (attributes & 0xFFFFu), 4);
+    uint32_t dos = dos_time(mtime);
+    add_patch(patches, central + 12, dos, 4);
+    add_patch(patches, entry.localOffset + 10, dos, 4);
+    patch_extra_times(data, centralExtra, centralExtraLength, mtime, filetime, patches);
+    patch_extra_times(data, localExtra, localExtraLength, mtime, filetime, patches);
+    return true;
+}
+
+} // namespace zipdir
@@ -87,4 +87,34 @@ using bit7z::tstring;
 #define PYTHON_NO_GIL
 #endif
 
+//The memory of a Python bytes-like object, requested C-contiguous so that it can be used as one run of bytes
+//(A strided view like memoryview(data)[::-1] or [::2] raises BufferError instead of being read or written wrongly)
+//It must be destroyed while the GIL is held
+class ContiguousBuffer {
+public:
+    ContiguousBuffer(py::handle obj, bool writable) {
+        if (PyObject_GetBuffer(obj.ptr(), &mView, PyBUF_C_CONTIGUOUS | (writable ? PyBUF_WRITABLE : 0)) != 0) {
+            throw py::error_already_set();
+        }
+    }
+
+    ~ContiguousBuffer() {
+        PyBuffer_Release(&mView);
+    }
+
+    ContiguousBuffer(const ContiguousBuffer&) = delete;
+    ContiguousBuffer& operator=(const ContiguousBuffer&) = delete;
+
+    char* data() const {
+        return static_cast<char*>(mView.buf);
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(mView.len);
+    }
+
+private:
+    Py_buffer mView;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+/*
+This file binds the ArchiveItem, the metadata of an item inside an archive.
+(It carries the same information as bit7z's BitArchiveItemInfo, see https://github.com/rikyoz/bit7z/wiki/Reading-archives)
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+//My headers
+#include <API.hpp>
+#include <ArchiveTools.hpp>
+
+void init_ArchiveItem(py::module_& mod){
+    py::class_<ArchiveItem>(mod, "ArchiveItem")
+        .def_readonly("index", &ArchiveItem::index, "The index of the item in the archive.")
+        .def_readonly("path", &ArchiveItem::path, "The path of the item in the archive.")
+        .def_readonly("is_dir", &ArchiveItem::isDir, "Whether the item is a directory.")
+        .def_readonly("is_sym_link", &ArchiveItem::isSymLink, "Whether the item is a symbolic link.")
+        .def_readonly("is_encrypted", &ArchiveItem::isEncrypted, "Whether the item is encrypted.")
+        .def_readonly("size", &ArchiveItem::size, "The uncompressed size of the item.")
+        .def_readonly("pack_size", &ArchiveItem::packSize, "The compressed size of the item.")
+        .def_readonly("crc", &ArchiveItem::crc, "The CRC32 of the item (0 if unknown).")
+        .def_readonly("attributes", &ArchiveItem::attributes, "The attributes of the item.")
+        .def_readonly("mtime", &ArchiveItem::mtime, "The last modification time (Unix timestamp).")
+        .def("__repr__", [](const ArchiveItem& item){
+            return "<ArchiveItem '" + item.path + "'>";
+        });
+
+    //List a zip or tar archive without the 7-Zip library (the central directory or the headers are parsed natively)
+    mod.def("list_items_native", [](const tstring& inArchive){
+        std::vector<ArchiveItem> items;
+        if (!list_native(inArchive, items)) {
+            throw py::value_error("Not a zip or tar archive, or a damaged one: " + inArchive);
+        }
+        return items;
+    },
+    py::arg("inArchive"),
+    py::call_guard<py::gil_scoped_release>(),
+    "List the items of a zip (with ZIP64) or tar archive without loading 7-Zip, with the metadata 7-Zip reports. "
+    "Raises ValueError for other archives.");
+}
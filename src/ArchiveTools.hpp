@@ -0,0 +1,4213 @@
+/*
+This file provides the helpers shared by the binding files, which work on bit7z archives item by item.
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+#ifndef ARCHIVE_TOOLS_HPP
+#define ARCHIVE_TOOLS_HPP
+
+#include <API.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <filesystem>
+#include <sstream>
+#include <fstream>
+#include <streambuf>
+#include <chrono>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <map>
+
+//bit7z headers
+#include <bitarchivereader.hpp>
+#include <bitfileextractor.hpp>
+#include <bitfilecompressor.hpp>
+#include <bitmemcompressor.hpp>
+#include <bitmemextractor.hpp>
+#include <bitarchivewriter.hpp>
+#include <bitformat.hpp>
+#include <bitexception.hpp>
+
+//My headers
+#include <prefetcher.hpp>
+#include <bufferpool.hpp>
+#include <formatsniff.hpp>
+#include <crc32.hpp>
+#include <handlerusage.hpp>
+#include <FormatProperties.hpp>
+#include <blockpipeline.hpp>
+#include <streamsplit.hpp>
+#include <tarnative.hpp>
+#include <zipdir.hpp>
+#include <safepath.hpp>
+#include <blockcache.hpp>
+
+//Marks a handler (a compressor or an extractor) as used by an operation while the guard lives
+//(An exclusive use also keeps the other operations away, for the operations which change the callbacks of the handler)
+//(It may wait for other threads, so it must be created without the GIL)
+class HandlerUse {
+public:
+    explicit HandlerUse(const void* handler, bool exclusive = false)
+        : mHandler(handler), mOwner(std::this_thread::get_id()) {
+        HandlerRegistry::global().acquire(handler, exclusive ? HandlerRegistry::Mode::Exclusive : HandlerRegistry::Mode::Shared);
+    }
+
+    ~HandlerUse() {
+        release();
+    }
+
+    HandlerUse(const HandlerUse&) = delete;
+    HandlerUse& operator=(const HandlerUse&) = delete;
+
+    //Ends the use before the guard is destroyed (it may be called from another thread)
+    void release() {
+        if (mHandler) {
+            HandlerRegistry::global().release(mHandler, mOwner);
+            mHandler = nullptr;
+        }
+    }
+
+private:
+    const void* mHandler;
+    std::thread::id mOwner;
+};
+
+//Changes the settings of a handler while the guard lives
+//(With idle, it waits until no operation uses the handler; otherwise only for the other readers and writers of the settings)
+class SettingsWrite {
+public:
+    explicit SettingsWrite(const void* handler, bool idle = true) : mHandler(handler) {
+        HandlerRegistry::global().begin_write(handler, idle);
+    }
+
+    ~SettingsWrite() {
+        HandlerRegistry::global().end_write(mHandler);
+    }
+
+    SettingsWrite(const SettingsWrite&) = delete;
+    SettingsWrite& operator=(const SettingsWrite&) = delete;
+
+private:
+    const void* mHandler;
+};
+
+//Reads the settings of a handler while the guard lives, so that they are not changed meanwhile
+class SettingsRead {
+public:
+    explicit SettingsRead(const void* handler) : mHandler(handler) {
+        HandlerRegistry::global().begin_read(handler);
+    }
+
+    ~SettingsRead() {
+        HandlerRegistry::global().end_read(mHandler);
+    }
+
+    SettingsRead(const SettingsRead&) = delete;
+    SettingsRead& operator=(const SettingsRead&) = delete;
+
+private:
+    const void* mHandler;
+};
+
+//Binds a setter of a handler: it waits without the GIL until no operation uses the handler, then changes it with the GIL
+template<typename Handler, typename C, typename... Args>
+auto locked_setter(void (C::*setter)(Args...)){
+    return [setter](Handler& self, Args... args){
+        std::unique_ptr<SettingsWrite> write;
+        {
+            py::gil_scoped_release release;
+            write.reset(new SettingsWrite(&self));
+        }
+        (self.*setter)(args...);
+    };
+}
+
+template<typename Handler, typename C, typename... Args>
+auto locked_setter(void (C::*setter)(Args...) noexcept){
+    return locked_setter<Handler>(static_cast<void (C::*)(Args...)>(setter));
+}
+
+//Binds a getter of a handler, which waits without the GIL while the handler is being changed
+template<typename Handler, typename R, typename C>
+auto locked_getter(R (C::*getter)() const){
+    return [getter](const Handler& self) -> R {
+        std::unique_ptr<SettingsRead> read;
+        {
+            py::gil_scoped_release release;
+            read.reset(new SettingsRead(&self));
+        }
+        return (self.*getter)();
+    };
+}
+
+template<typename Handler, typename R, typename C>
+auto locked_getter(R (C::*getter)() const noexcept){
+    return locked_getter<Handler>(static_cast<R (C::*)() const>(getter));
+}
+
+//Binds an operation of a handler, which uses the handler while it runs
+//(It must be bound with a call guard which releases the GIL)
+template<typename Handler, typename R, typename C, typename... Args>
+auto locked_operation(R (C::*operation)(Args...) const){
+    return [operation](const Handler& self, Args... args) -> R {
+        HandlerUse use(&self);
+        return (self.*operation)(args...);
+    };
+}
+
+//An output stream buffer which hands every full chunk to a consumer instead of keeping the data
+//(bit7z extracts an item to a std::ostream, so this lets the decoded data flow out while decoding)
+//A buffer is taken only when data arrives and grows with it up to the chunk size, so a small item does not take a whole chunk
+template<typename Byte = char>
+class ChunkStreamBuf : public std::streambuf {
+public:
+    using Sink = std::function<void(std::vector<Byte>&&)>;
+
+    //The chunks are taken from the pool when it is given (the consumer should release them back)
+    ChunkStreamBuf(size_t chunkSize, Sink sink, BufferPool<Byte>* pool = nullptr)
+        : mChunkSize(chunkSize == 0 ? 1 : chunkSize), mSink(std::move(sink)), mPool(pool) {}
+
+    ~ChunkStreamBuf() override {
+        flushChunk();
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            char c = traits_type::to_char_type(ch);
+            xsputn(&c, 1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        size_t left = static_cast<size_t>(n);
+        while (left > 0) {
+            size_t len = std::min(left, mChunkSize - mBuffer.size());
+            grow(mBuffer.size() + len);
+            const Byte* data = reinterpret_cast<const Byte*>(s);
+            mBuffer.insert(mBuffer.end(), data, data + len);
+            s += len;
+            left -= len;
+            if (mBuffer.size() == mChunkSize) {
+                flushChunk();
+            }
+        }
+        return n;
+    }
+
+    int sync() override {
+        flushChunk();
+        return 0;
+    }
+
+private:
+    //Doubles the capacity (at least 64 KiB, at most the chunk size) when the data does not fit
+    void grow(size_t size) {
+        if (size <= mBuffer.capacity()) {
+            return;
+        }
+        size_t capacity = std::min(mChunkSize, std::max({size, 2 * mBuffer.capacity(), size_t(64 * 1024)}));
+        if (mBuffer.capacity() == 0 && mPool) {
+            mBuffer = mPool->acquire(capacity);
+        }
+        mBuffer.reserve(capacity);
+    }
+
+    void flushChunk() {
+        if (mBuffer.empty()) {
+            return;
+        }
+        //Hand the whole buffer over instead of copying it
+        mSink(std::move(mBuffer));
+        mBuffer = std::vector<Byte>();
+    }
+
+    size_t mChunkSize;
+    Sink mSink;
+    BufferPool<Byte>* mPool;
+    std::vector<Byte> mBuffer;
+};
+
+//An output stream buffer which appends to a vector
+//(Used with the pooled vectors, so the capacity is kept across items instead of growing a fresh vector each time)
+class VectorStreamBuf : public std::streambuf {
+public:
+    explicit VectorStreamBuf(std::vector<char>& out) : mOut(out) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            mOut.push_back(traits_type::to_char_type(ch));
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        mOut.insert(mOut.end(), s, s + n);
+        return n;
+    }
+
+private:
+    std::vector<char>& mOut;
+};
+
+//An output stream buffer which only counts the bytes written to it
+class CountingStreamBuf : public std::streambuf {
+public:
+    uint64_t count() const {
+        return mCount;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            ++mCount;
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        mCount += static_cast<uint64_t>(n);
+        return n;
+    }
+
+private:
+    uint64_t mCount = 0;
+};
+
+//The capacity reserved up front for an item decoded into memory
+//(The size comes from the archive headers, which are not trusted: a crafted header must not force a huge allocation,
+//so at most 64 MiB is reserved and the buffer grows as the data arrives)
+inline size_t initial_reserve(uint64_t declaredSize){
+    const uint64_t maxReserve = 64u << 20;
+    return static_cast<size_t>(std::min(declaredSize, maxReserve));
+}
+
+//Decodes the items of a solid archive in one pass into memory, keyed by their paths
+//(Decoding the items of a solid block one by one would decode the block again for each of them. bit7z hands the items
+//of a pass over only at its end, so they all stay in memory until then.)
+//It returns false, with nothing decoded, when two items share a path (they would share one entry of the map) or the
+//items decode to more than maxBytes; the sizes in the headers are not trusted, so the pass stops past maxBytes.
+//The progress callback of the reader is replaced
+inline bool decode_solid_pass(bit7z::BitArchiveReader& reader, uint64_t maxBytes, bit7z::ProgressCallback progress,
+                              std::map<tstring, std::vector<bit7z::byte_t>>& decoded){
+    std::set<tstring> paths;
+    uint64_t declared = 0;
+    for (const auto& item : reader) {
+        if (item.isDir()) {
+            continue;
+        }
+        declared += item.size();
+        if (!paths.insert(item.path()).second || declared > maxBytes) {
+            return false;
+        }
+    }
+    bool exceeded = false;
+    reader.setProgressCallback([&exceeded, progress, maxBytes](uint64_t processed){
+        if (processed > maxBytes) {
+            exceeded = true;
+            return false;
+        }
+        return progress ? progress(processed) : true;
+    });
+    try {
+        reader.extractTo(decoded);
+    } catch (...) {
+        if (!exceeded) {
+            throw;
+        }
+        decoded.clear();
+        return false;
+    }
+    return true;
+}
+
+//The pool shared by the decoding thread and the writer threads of extract_async
+inline BufferPool<char>& chunk_pool(){
+    static BufferPool<char> pool(16 * 1024 * 1024, 16);
+    return pool;
+}
+
+//An input stream buffer over a memory block (for example a memory mapped archive)
+//It never copies the block, and seeking only moves the read position
+class MemoryStreamBuf : public std::streambuf {
+public:
+    MemoryStreamBuf(const char* data, size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        off_type base = 0;
+        if (dir == std::ios_base::cur) {
+            base = gptr() - eback();
+        } else if (dir == std::ios_base::end) {
+            base = egptr() - eback();
+        }
+        off_type pos = base + off;
+        if (pos < 0 || pos > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + pos, egptr());
+        return pos_type(pos);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+    std::streamsize xsgetn(char* s, std::streamsize n) override {
+        std::streamsize len = std::min<std::streamsize>(n, egptr() - gptr());
+        if (len > 0) {
+            std::memcpy(s, gptr(), static_cast<size_t>(len));
+            setg(eback(), gptr() + len, egptr());
+        }
+        return len;
+    }
+
+    std::streamsize showmanyc() override {
+        return egptr() - gptr();
+    }
+};
+
+//An archive mapped into memory and exposed as an input stream, so 7-Zip reads it without read/seek system calls
+struct MappedArchive {
+    MappedArchive(const tstring& path, os::Advice advice)
+        : file(os::map_file(path)), buffer(file.data(), file.size()), stream(&buffer) {
+        if (!file.valid()) {
+            throw std::runtime_error("Cannot map archive: " + path);
+        }
+        file.advise(advice);
+        if (advice == os::Advice::Sequential) {
+            file.advise(os::Advice::WillNeed);
+        }
+    }
+
+    os::MappedFile file;
+    MemoryStreamBuf buffer;
+    std::istream stream;
+};
+
+//The metadata of an archive item
+//(A plain copy of what bit7z reports, so that it can also be filled without the 7-Zip library)
+struct ArchiveItem {
+    uint32_t index = 0;
+    tstring path;
+    bool isDir = false;
+    bool isSymLink = false;
+    bool isEncrypted = false;
+    uint64_t size = 0;
+    uint64_t packSize = 0;
+    uint32_t crc = 0;
+    uint32_t attributes = 0;
+    time_t mtime = 0;
+};
+
+inline ArchiveItem to_archive_item(const bit7z::BitArchiveItem& item){
+    ArchiveItem info;
+    info.index = item.index();
+    info.path = item.path();
+    info.isDir = item.isDir();
+    info.isSymLink = item.isSymLink();
+    info.isEncrypted = item.isEncrypted();
+    info.size = item.size();
+    info.packSize = item.packSize();
+    info.crc = item.crc();
+    info.attributes = item.attributes();
+    info.mtime = std::chrono::system_clock::to_time_t(item.lastWriteTime());
+    return info;
+}
+
+//The format of a name returned by the signature detector (the suffix of the FORMAT_* constant), or Auto
+inline const bit7z::BitInFormat& format_by_name(const std::string& name){
+    static const std::map<std::string, const bit7z::BitInFormat*> formats = {
+        {"APM", &bit7z::BitFormat::APM},
+        {"ARJ", &bit7z::BitFormat::Arj},
+        {"BZIP2", &bit7z::BitFormat::BZip2},
+        {"CAB", &bit7z::BitFormat::Cab},
+        {"CHM", &bit7z::BitFormat::Chm},
+        {"COFF", &bit7z::BitFormat::COFF},
+        {"COMPOUND", &bit7z::BitFormat::Compound},
+        {"CPIO", &bit7z::BitFormat::Cpio},
+        {"CRAMFS", &bit7z::BitFormat::CramFS},
+        {"DEB", &bit7z::BitFormat::Deb},
+        {"DMG", &bit7z::BitFormat::Dmg},
+        {"ELF", &bit7z::BitFormat::Elf},
+        {"EXT", &bit7z::BitFormat::Ext},
+        {"FAT", &bit7z::BitFormat::Fat},
+        {"FLV", &bit7z::BitFormat::Flv},
+        {"GPT", &bit7z::BitFormat::GPT},
+        {"GZIP", &bit7z::BitFormat::GZip},
+        {"HFS", &bit7z::BitFormat::Hfs},
+        {"HXS", &bit7z::BitFormat::Hxs},
+        {"IHEX", &bit7z::BitFormat::IHex},
+        {"ISO", &bit7z::BitFormat::Iso},
+        {"LZH", &bit7z::BitFormat::Lzh},
+        {"LZMA", &bit7z::BitFormat::Lzma},
+        {"LZMA86", &bit7z::BitFormat::Lzma86},
+        {"MACHO", &bit7z::BitFormat::Macho},
+        {"MBR", &bit7z::BitFormat::Mbr},
+        {"MSLZ", &bit7z::BitFormat::Mslz},
+        {"MUB", &bit7z::BitFormat::Mub},
+        {"NSIS", &bit7z::BitFormat::Nsis},
+        {"NTFS", &bit7z::BitFormat::Ntfs},
+        {"PE", &bit7z::BitFormat::Pe},
+        {"PPMD", &bit7z::BitFormat::Ppmd},
+        {"QCOW", &bit7z::BitFormat::QCow},
+        {"RAR", &bit7z::BitFormat::Rar},
+        {"RAR5", &bit7z::BitFormat::Rar5},
+        {"RPM", &bit7z::BitFormat::Rpm},
+        {"7Z", &bit7z::BitFormat::SevenZip},
+        {"SPLIT", &bit7z::BitFormat::Split},
+        {"SQUASHFS", &bit7z::BitFormat::SquashFS},
+        {"SWF", &bit7z::BitFormat::Swf},
+        {"SWFC", &bit7z::BitFormat::Swfc},
+        {"TAR", &bit7z::BitFormat::Tar},
+        {"TE", &bit7z::BitFormat::TE},
+        {"UDF", &bit7z::BitFormat::Udf},
+        {"UEFIC", &bit7z::BitFormat::UEFIc},
+        {"UEFIS", &bit7z::BitFormat::UEFIs},
+        {"VDI", &bit7z::BitFormat::VDI},
+        {"VHD", &bit7z::BitFormat::Vhd},
+        {"VHDX", &bit7z::BitFormat::Vhdx},
+        {"VMDK", &bit7z::BitFormat::VMDK},
+        {"WIM", &bit7z::BitFormat::Wim},
+        {"XAR", &bit7z::BitFormat::Xar},
+        {"XZ", &bit7z::BitFormat::Xz},
+        {"Z", &bit7z::BitFormat::Z},
+        {"ZIP", &bit7z::BitFormat::Zip},
+    };
+    auto it = formats.find(name);
+    return it == formats.end() ? static_cast<const bit7z::BitInFormat&>(bit7z::BitFormat::Auto) : *it->second;
+}
+
+//The format to open an archive with: the format of the extractor, or the cached signature detection when it is Auto
+//(7-Zip would otherwise try the handlers one by one each time the archive is opened)
+inline const bit7z::BitInFormat& input_format(const bit7z::BitFileExtractor& self, const tstring& inArchive){
+    if (self.extractionFormat() != bit7z::BitFormat::Auto) {
+        return self.extractionFormat();
+    }
+    sniff::Detection detection = sniff::FormatCache::global().detect(inArchive);
+    //Executables may be self-extracting archives, and short signatures may be false matches: 7-Zip decides for them
+    static const std::set<std::string> probed = {"PE", "ELF", "MACHO", "MUB", "TE", "MBR", "FAT", "EXT", "ARJ", "Z", "LZH"};
+    if (detection.embedded || probed.count(detection.format) != 0) {
+        return bit7z::BitFormat::Auto;
+    }
+    return format_by_name(detection.format);
+}
+
+//Copies the password and the callbacks of an extractor to an archive reader
+inline void apply_settings(const bit7z::BitFileExtractor& self, bit7z::BitArchiveReader& reader){
+    if (self.isPasswordDefined()) {
+        reader.setPassword(self.password());
+    }
+    reader.setPasswordCallback(self.passwordCallback());
+    reader.setProgressCallback(self.progressCallback());
+    reader.setRatioCallback(self.ratioCallback());
+    reader.setTotalCallback(self.totalCallback());
+    reader.setFileCallback(self.fileCallback());
+    reader.setOverwriteMode(self.overwriteMode());
+    reader.setRetainDirectories(self.retainDirectories());
+}
+
+//Copies the password, the callbacks and the compression settings of a compressor to an archive writer
+inline void apply_settings(const bit7z::BitFileCompressor& self, bit7z::BitArchiveWriter& writer){
+    if (self.isPasswordDefined()) {
+        writer.setPassword(self.password(), self.cryptHeaders());
+    }
+    writer.setPasswordCallback(self.passwordCallback());
+    writer.setProgressCallback(self.progressCallback());
+    writer.setRatioCallback(self.ratioCallback());
+    writer.setTotalCallback(self.totalCallback());
+    writer.setFileCallback(self.fileCallback());
+    writer.setOverwriteMode(self.overwriteMode());
+    writer.setRetainDirectories(self.retainDirectories());
+    writer.setCompressionLevel(self.compressionLevel());
+    writer.setCompressionMethod(self.compressionMethod());
+    //0 means the default of the method
+    if (self.dictionarySize() != 0) {
+        writer.setDictionarySize(self.dictionarySize());
+    }
+    if (self.wordSize() != 0) {
+        writer.setWordSize(self.wordSize());
+    }
+    writer.setSolidMode(self.solidMode());
+    writer.setThreadsCount(self.threadsCount());
+    writer.setStoreSymbolicLinks(self.storeSymbolicLinks());
+    apply_format_properties(writer, FormatPropertyStore::global().get(&self));
+}
+
+//The settings of a handler captured once, from which configured handlers are made in one call
+//It also keeps a pool of idle handlers: a checkout reuses one of them and only applies the settings again
+//(The preset is owned by a shared_ptr, so that the handlers handed out can find their way back to the pool)
+template<typename Handler>
+class HandlerPreset : public std::enable_shared_from_this<HandlerPreset<Handler>> {
+public:
+    explicit HandlerPreset(size_t maxPooled) : mMaxPooled(maxPooled) {}
+    virtual ~HandlerPreset() = default;
+
+    HandlerPreset(const HandlerPreset&) = delete;
+    HandlerPreset& operator=(const HandlerPreset&) = delete;
+
+    //Makes a new handler with the settings of the preset
+    HandlerHolder<Handler> create() const {
+        HandlerHolder<Handler> handler(make());
+        apply(*handler);
+        return handler;
+    }
+
+    //Takes an idle handler from the pool (or makes one), with the settings of the preset
+    //(Deleting the holder gives the handler back to the pool, as long as the preset is alive)
+    HandlerHolder<Handler> checkout() {
+        HandlerHolder<Handler> handler;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mIdle.empty()) {
+                handler = std::move(mIdle.back());
+                mIdle.pop_back();
+            }
+        }
+        if (!handler) {
+            handler.reset(make());
+        }
+        HandlerRegistry::global().restore(handler.get());
+        apply(*handler);
+        std::weak_ptr<HandlerPreset> pool = this->weak_from_this();
+        handler.get_deleter().recycle = [pool](Handler* idle){
+            std::shared_ptr<HandlerPreset> preset = pool.lock();
+            if (!preset) {
+                return false;
+            }
+            preset->giveBack(HandlerHolder<Handler>(idle));
+            return true;
+        };
+        return handler;
+    }
+
+    //Puts a handler back into the pool; it is dropped when the pool is full or its settings cannot be reset
+    void giveBack(HandlerHolder<Handler> handler) {
+        if (!handler) {
+            return;
+        }
+        handler.get_deleter().recycle = nullptr;
+        if (!reusable(*handler)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mIdle.size() < mMaxPooled) {
+            mIdle.push_back(std::move(handler));
+        }
+    }
+
+    size_t pooled() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mIdle.size();
+    }
+
+    void clearPool() {
+        std::vector<HandlerHolder<Handler>> idle;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            idle.swap(mIdle);
+        }
+    }
+
+    //Sets all the captured settings on a handler
+    virtual void apply(Handler& target) const = 0;
+
+protected:
+    virtual Handler* make() const = 0;
+
+    virtual bool reusable(const Handler&) const {
+        return true;
+    }
+
+private:
+    size_t mMaxPooled;
+    mutable std::mutex mMutex;
+    std::vector<HandlerHolder<Handler>> mIdle;
+};
+
+//The settings of a compressor, read through its getters
+class CompressorPreset : public HandlerPreset<bit7z::BitFileCompressor> {
+public:
+    CompressorPreset(const bit7z::BitFileCompressor& self, size_t maxPooled)
+        : HandlerPreset(maxPooled),
+          mLibrary(&self.library()),
+          mFormat(&self.compressionFormat()),
+          mPasswordDefined(self.isPasswordDefined()),
+          mPassword(self.password()),
+          mCryptHeaders(self.cryptHeaders()),
+          mPasswordCallback(self.passwordCallback()),
+          mProgressCallback(self.progressCallback()),
+          mRatioCallback(self.ratioCallback()),
+          mTotalCallback(self.totalCallback()),
+          mFileCallback(self.fileCallback()),
+          mOverwriteMode(self.overwriteMode()),
+          mRetainDirectories(self.retainDirectories()),
+          mLevel(self.compressionLevel()),
+          mMethod(self.compressionMethod()),
+          mDictionarySize(self.dictionarySize()),
+          mWordSize(self.wordSize()),
+          mSolidMode(self.solidMode()),
+          mThreadsCount(self.threadsCount()),
+          mStoreSymbolicLinks(self.storeSymbolicLinks()),
+          mUpdateMode(self.updateMode()),
+          mVolumeSize(self.volumeSize()),
+          mProperties(FormatPropertyStore::global().get(&self)) {}
+
+    void apply(bit7z::BitFileCompressor& target) const override {
+        if (mPasswordDefined) {
+            target.setPassword(mPassword, mCryptHeaders);
+        } else {
+            target.clearPassword();
+        }
+        target.setPasswordCallback(mPasswordCallback);
+        target.setProgressCallback(mProgressCallback);
+        target.setRatioCallback(mRatioCallback);
+        target.setTotalCallback(mTotalCallback);
+        target.setFileCallback(mFileCallback);
+        target.setOverwriteMode(mOverwriteMode);
+        target.setRetainDirectories(mRetainDirectories);
+        target.setCompressionLevel(mLevel);
+        target.setCompressionMethod(mMethod);
+        //0 means the default of the method
+        if (mDictionarySize != 0) {
+            target.setDictionarySize(mDictionarySize);
+        }
+        if (mWordSize != 0) {
+            target.setWordSize(mWordSize);
+        }
+        target.setSolidMode(mSolidMode);
+        target.setThreadsCount(mThreadsCount);
+        target.setStoreSymbolicLinks(mStoreSymbolicLinks);
+        target.setUpdateMode(mUpdateMode);
+        target.setVolumeSize(mVolumeSize);
+        apply_format_properties(target, mProperties);
+        FormatPropertyStore::global().merge(&target, mProperties);
+    }
+
+protected:
+    bit7z::BitFileCompressor* make() const override {
+        return new bit7z::BitFileCompressor(*mLibrary, *mFormat);
+    }
+
+    //A dictionary or word size of 0 cannot be set again, nor can a format property be removed,
+    //so a compressor whose sizes or properties were changed is not reused
+    bool reusable(const bit7z::BitFileCompressor& handler) const override {
+        return handler.dictionarySize() == mDictionarySize && handler.wordSize() == mWordSize &&
+               FormatPropertyStore::global().get(&handler) == mProperties;
+    }
+
+private:
+    const bit7z::Bit7zLibrary* mLibrary;
+    const bit7z::BitInOutFormat* mFormat;
+    bool mPasswordDefined;
+    tstring mPassword;
+    bool mCryptHeaders;
+    bit7z::PasswordCallback mPasswordCallback;
+    bit7z::ProgressCallback mProgressCallback;
+    bit7z::RatioCallback mRatioCallback;
+    bit7z::TotalCallback mTotalCallback;
+    bit7z::FileCallback mFileCallback;
+    bit7z::OverwriteMode mOverwriteMode;
+    bool mRetainDirectories;
+    bit7z::BitCompressionLevel mLevel;
+    bit7z::BitCompressionMethod mMethod;
+    uint32_t mDictionarySize;
+    uint32_t mWordSize;
+    bool mSolidMode;
+    uint32_t mThreadsCount;
+    bool mStoreSymbolicLinks;
+    bit7z::UpdateMode mUpdateMode;
+    uint64_t mVolumeSize;
+    FormatProperties mProperties;
+};
+
+//The settings of an extractor, read through its getters
+class ExtractorPreset : public HandlerPreset<bit7z::BitFileExtractor> {
+public:
+    ExtractorPreset(const bit7z::BitFileExtractor& self, size_t maxPooled)
+        : HandlerPreset(maxPooled),
+          mLibrary(&self.library()),
+          mFormat(&self.extractionFormat()),
+          mPasswordDefined(self.isPasswordDefined()),
+          mPassword(self.password()),
+          mPasswordCallback(self.passwordCallback()),
+          mProgressCallback(self.progressCallback()),
+          mRatioCallback(self.ratioCallback()),
+          mTotalCallback(self.totalCallback()),
+          mFileCallback(self.fileCallback()),
+          mOverwriteMode(self.overwriteMode()),
+          mRetainDirectories(self.retainDirectories()) {}
+
+    void apply(bit7z::BitFileExtractor& target) const override {
+        if (mPasswordDefined) {
+            target.setPassword(mPassword);
+        } else {
+            target.clearPassword();
+        }
+        target.setPasswordCallback(mPasswordCallback);
+        target.setProgressCallback(mProgressCallback);
+        target.setRatioCallback(mRatioCallback);
+        target.setTotalCallback(mTotalCallback);
+        target.setFileCallback(mFileCallback);
+        target.setOverwriteMode(mOverwriteMode);
+        target.setRetainDirectories(mRetainDirectories);
+    }
+
+protected:
+    bit7z::BitFileExtractor* make() const override {
+        return new bit7z::BitFileExtractor(*mLibrary, *mFormat);
+    }
+
+private:
+    const bit7z::Bit7zLibrary* mLibrary;
+    const bit7z::BitInFormat* mFormat;
+    bool mPasswordDefined;
+    tstring mPassword;
+    bit7z::PasswordCallback mPasswordCallback;
+    bit7z::ProgressCallback mProgressCallback;
+    bit7z::RatioCallback mRatioCallback;
+    bit7z::TotalCallback mTotalCallback;
+    bit7z::FileCallback mFileCallback;
+    bit7z::OverwriteMode mOverwriteMode;
+    bool mRetainDirectories;
+};
+
+//A handler checked out from the pool of a preset, which goes back to the pool when it is returned
+//The handler may be handed out with take(): the caller then owns it, and the handler goes back to the pool when
+//the caller deletes it. Returning the lease retires it, so the references left to it cannot use it anymore
+//(and it cannot be shared with the next lease meanwhile); the caller must keep it alive until the lease is returned
+template<typename Preset, typename Handler>
+class PresetLease {
+public:
+    explicit PresetLease(std::shared_ptr<Preset> preset)
+        : mPreset(std::move(preset)), mHandler(mPreset->checkout()), mCurrent(mHandler.get()) {}
+
+    ~PresetLease() {
+        giveBack();
+    }
+
+    PresetLease(const PresetLease&) = delete;
+    PresetLease& operator=(const PresetLease&) = delete;
+
+    Handler& handler() {
+        if (!mCurrent) {
+            throw std::runtime_error("The handler has been returned to its pool");
+        }
+        return *mCurrent;
+    }
+
+    //Hands the ownership of the handler out, once
+    HandlerHolder<Handler> take() {
+        handler();
+        if (!mHandler) {
+            throw std::runtime_error("The handler has already been handed out");
+        }
+        return std::move(mHandler);
+    }
+
+    bool taken() const {
+        return mCurrent && !mHandler;
+    }
+
+    void giveBack() {
+        if (mHandler) {
+            mPreset->giveBack(std::move(mHandler));
+        } else if (mCurrent) {
+            HandlerRegistry::global().retire(mCurrent);
+        }
+        mCurrent = nullptr;
+    }
+
+private:
+    std::shared_ptr<Preset> mPreset;
+    HandlerHolder<Handler> mHandler;
+    Handler* mCurrent;
+};
+
+using CompressorLease = PresetLease<CompressorPreset, bit7z::BitFileCompressor>;
+using ExtractorLease = PresetLease<ExtractorPreset, bit7z::BitFileExtractor>;
+
+//The Python object of the handler of a lease: the first call hands the ownership to Python,
+//the later ones find the same object (the lease keeps it alive with keep_alive<1, 0>)
+template<typename Preset, typename Handler>
+py::object lease_handler(PresetLease<Preset, Handler>& lease){
+    if (lease.taken()) {
+        return py::cast(&lease.handler(), py::return_value_policy::reference);
+    }
+    return py::cast(lease.take());
+}
+
+//Joins the output directory and the path of an item
+//Returns an empty string when the item path is absolute or escapes from the output directory
+inline std::string item_output_path(const tstring& outDir, const tstring& itemPath){
+    std::filesystem::path rel = std::filesystem::path(itemPath).lexically_normal();
+    if (rel.empty() || rel.has_root_path() || *rel.begin() == "..") {
+        return {};
+    }
+    return (std::filesystem::path(outDir.empty() ? "." : outDir) / rel).string();
+}
+
+//The path of an item below the output directory, only its name when the directories are not retained
+//(Like 7-Zip, which extracts every item into the output directory itself then)
+inline std::string item_relative_path(const tstring& itemPath, bool retainDirectories){
+    if (retainDirectories) {
+        return itemPath;
+    }
+    size_t sep = itemPath.find_last_of('/');
+    return sep == tstring::npos ? itemPath : itemPath.substr(sep + 1);
+}
+
+#ifndef _WIN32
+//How the files written without 7-Zip treat the existing ones, following the overwrite mode of the extractor
+inline safepath::Existing existing_mode(bit7z::OverwriteMode mode){
+    switch (mode) {
+        case bit7z::OverwriteMode::Skip:
+            return safepath::Existing::Skip;
+        case bit7z::OverwriteMode::Overwrite:
+            return safepath::Existing::Replace;
+        default:
+            return safepath::Existing::Fail;
+    }
+}
+#endif
+
+//A piece of a decoded item handed from the decoding thread of an ItemStream
+//(Items not larger than the chunk size come in one piece, larger ones in consecutive pieces)
+struct ItemChunk {
+    ArchiveItem item;
+    uint64_t offset = 0;
+    bool last = true;
+    std::vector<char> data;
+};
+
+//Decodes the items of an archive on a background thread into a bounded queue
+//The decoding thread waits while the queued buffers (their capacity) exceed maxQueueBytes, so the memory does not grow with the archive
+//(A solid archive up to maxSolidBytes whose paths are unique is decoded in one pass into memory, so its memory is
+//bounded by maxSolidBytes rather than maxQueueBytes; a larger one, or one with duplicate paths, is decoded item by item,
+//where every item decodes its solid block again up to the item)
+class ItemStream {
+public:
+    //Fills the queue on the decoding thread: it calls started() once it no longer needs the objects of the caller,
+    //then pushes the chunks and returns when it is done or cancelled()
+    using Producer = std::function<void(ItemStream&)>;
+
+    ItemStream(const bit7z::BitFileExtractor& self, const tstring& inArchive, size_t chunkSize, size_t maxQueueBytes,
+               uint64_t maxSolidBytes = 0)
+        : ItemStream(chunkSize, maxQueueBytes, [&self, inArchive, maxSolidBytes](ItemStream& stream){
+              stream.decode(self, inArchive, maxSolidBytes);
+          }) {}
+
+    ItemStream(size_t chunkSize, size_t maxQueueBytes, Producer produce)
+        : mChunkSize(chunkSize == 0 ? 1 : chunkSize), mMaxQueueBytes(maxQueueBytes),
+          mPool(maxQueueBytes + 2 * mChunkSize, 64) {
+        mThread = std::thread([this, produce](){
+            try {
+                produce(*this);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (!mCancelled) {
+                    mError = std::current_exception();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFinished = true;
+            }
+            mCondition.notify_all();
+        });
+        //The thread copies the settings before the constructor returns, so the extractor may be used elsewhere afterwards
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this](){ return mStarted || mFinished; });
+    }
+
+    ~ItemStream() {
+        cancel();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    ItemStream(const ItemStream&) = delete;
+    ItemStream& operator=(const ItemStream&) = delete;
+
+    //Waits for the next chunk; returns false after the last one, and rethrows the error of the decoding thread
+    bool next(ItemChunk& chunk) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this](){ return !mQueue.empty() || mFinished; });
+        if (mQueue.empty()) {
+            if (mError) {
+                std::exception_ptr error = mError;
+                mError = nullptr;
+                std::rethrow_exception(error);
+            }
+            return false;
+        }
+        chunk = std::move(mQueue.front());
+        mQueue.pop_front();
+        mQueuedBytes -= chunk.data.capacity();
+        lock.unlock();
+        mCondition.notify_all();
+        return true;
+    }
+
+    //Gives the data of a consumed chunk back for the next chunks
+    void recycle(std::vector<char>&& data) {
+        mPool.release(std::move(data));
+    }
+
+    //Stops the decoding thread (the progress callback returns false, and the rest of the data is dropped)
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCancelled = true;
+            mQueue.clear();
+            mQueuedBytes = 0;
+        }
+        mCondition.notify_all();
+    }
+
+    //For the producers
+    bool cancelled() const {
+        return mCancelled;
+    }
+
+    BufferPool<char>& pool() {
+        return mPool;
+    }
+
+    void started() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStarted = true;
+        }
+        mCondition.notify_all();
+    }
+
+    //Queues a chunk, waiting while the queue is full (the memory held is the capacity of the buffers, not their size)
+    void push(ItemChunk&& chunk) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        //A chunk is always let through into an empty queue, otherwise a chunk larger than the limit would wait forever
+        mCondition.wait(lock, [this, &chunk](){
+            return mCancelled || mQueue.empty() || mQueuedBytes + chunk.data.capacity() <= mMaxQueueBytes;
+        });
+        if (mCancelled) {
+            return;
+        }
+        mQueuedBytes += chunk.data.capacity();
+        mQueue.push_back(std::move(chunk));
+        lock.unlock();
+        mCondition.notify_all();
+    }
+
+    //Queues the data of a whole item decoded in memory, split into chunks
+    void pushDecoded(const ArchiveItem& item, const bit7z::byte_t* data, size_t size) {
+        size_t offset = 0;
+        do {
+            ItemChunk chunk;
+            chunk.item = item;
+            chunk.offset = offset;
+            size_t len = std::min(mChunkSize, size - offset);
+            //Small pieces get their own buffer rather than a large pooled one
+            if (len >= 64 * 1024) {
+                chunk.data = mPool.acquire(len);
+            }
+            chunk.data.assign(data + offset, data + offset + len);
+            offset += len;
+            chunk.last = offset == size;
+            push(std::move(chunk));
+        } while (offset < size && !mCancelled);
+    }
+
+private:
+    void decode(const bit7z::BitFileExtractor& self, const tstring& inArchive, uint64_t maxSolidBytes) {
+        bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+        apply_settings(self, reader);
+        bit7z::ProgressCallback user = self.progressCallback();
+        started();
+
+        bit7z::ProgressCallback progress = [this, user](uint64_t processed){
+            if (mCancelled) {
+                return false;
+            }
+            return user ? user(processed) : true;
+        };
+        //A solid archive is decoded in one pass when its paths are unique and it fits in maxSolidBytes
+        //(decoding its items one by one would decode the solid blocks again for each)
+        std::map<tstring, std::vector<bit7z::byte_t>> decoded;
+        if (reader.isSolid() && decode_solid_pass(reader, maxSolidBytes, progress, decoded)) {
+            pushSolid(reader, decoded);
+            return;
+        }
+
+        reader.setProgressCallback(progress);
+        for (const auto& item : reader) {
+            if (mCancelled) {
+                return;
+            }
+            if (item.isDir()) {
+                continue;
+            }
+            decodeItem(reader, to_archive_item(item));
+        }
+    }
+
+    //Decodes one item through the chunk buffer
+    void decodeItem(bit7z::BitArchiveReader& reader, const ArchiveItem& item) {
+        //The last chunk is held back until the next one (or the end of the item) is known
+        ItemChunk pending;
+        pending.item = item;
+        pending.last = false;
+        {
+            ChunkStreamBuf<> buffer(mChunkSize, [this, &pending](std::vector<char>&& data){
+                if (!pending.data.empty()) {
+                    ItemChunk next;
+                    next.item = pending.item;
+                    next.offset = pending.offset + pending.data.size();
+                    next.last = false;
+                    push(std::move(pending));
+                    pending = std::move(next);
+                }
+                pending.data = std::move(data);
+            }, &mPool);
+            std::ostream out(&buffer);
+            reader.extractTo(out, item.index);
+        }
+        pending.last = true;
+        push(std::move(pending));
+    }
+
+    //Queues the items of a solid archive decoded in one pass, in the order of the archive
+    void pushSolid(bit7z::BitArchiveReader& reader, std::map<tstring, std::vector<bit7z::byte_t>>& decoded) {
+        for (const auto& item : reader) {
+            if (mCancelled) {
+                return;
+            }
+            if (item.isDir()) {
+                continue;
+            }
+            auto it = decoded.find(item.path());
+            if (it == decoded.end()) {
+                decodeItem(reader, to_archive_item(item));
+                continue;
+            }
+            pushDecoded(to_archive_item(item), it->second.data(), it->second.size());
+            decoded.erase(it);
+        }
+    }
+
+    size_t mChunkSize;
+    size_t mMaxQueueBytes;
+    BufferPool<char> mPool;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<ItemChunk> mQueue;
+    size_t mQueuedBytes = 0;
+    std::atomic<bool> mCancelled{false};
+    bool mStarted = false;
+    bool mFinished = false;
+    std::exception_ptr mError;
+    std::thread mThread;
+};
+
+//An output stream buffer which appends to a vector and refuses the data beyond a limit
+//(7-Zip then fails the extraction with a write error, and exceeded() tells it apart from the other errors)
+template<typename Byte = char>
+class LimitedStreamBuf : public std::streambuf {
+public:
+    LimitedStreamBuf(std::vector<Byte>& out, uint64_t limit) : mOut(out), mLimit(limit) {}
+
+    bool exceeded() const {
+        return mExceeded;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        char c = traits_type::to_char_type(ch);
+        return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (mOut.size() + static_cast<uint64_t>(n) > mLimit) {
+            mExceeded = true;
+            return 0;
+        }
+        const Byte* data = reinterpret_cast<const Byte*>(s);
+        mOut.insert(mOut.end(), data, data + n);
+        return n;
+    }
+
+private:
+    std::vector<Byte>& mOut;
+    uint64_t mLimit;
+    bool mExceeded = false;
+};
+
+//The limits of a nested extraction
+struct NestedLimits {
+    unsigned maxDepth = 8;               //The levels of inner archives opened below the outer archive
+    uint64_t maxBytes = 1ull << 32;      //The bytes decoded at all levels together, inner archives included
+    std::set<std::string> formats;       //The format names (as the FORMAT_* suffixes) opened as inner archives, empty for all
+};
+
+//The format of an inner archive found by its signature in the decoded data, or null when the data is not opened
+//(Only archive and compression formats are opened: executables and disk images are kept as they are,
+//and so are archives found past the start of the data, which are often false matches)
+inline const bit7z::BitInFormat* nested_format(const std::vector<char>& data, const std::set<std::string>& formats){
+    static const std::set<std::string> archives = {
+        "7Z", "ZIP", "RAR", "RAR5", "TAR", "GZIP", "BZIP2", "XZ", "Z", "LZMA", "LZMA86",
+        "CAB", "ARJ", "LZH", "CPIO", "RPM", "DEB", "XAR", "WIM", "ISO", "UDF"
+    };
+    size_t head = std::min(data.size(), sniff::kHeadSize);
+    size_t tail = std::min(data.size(), sniff::kTailSize);
+    sniff::Detection detection = sniff::detect_buffer(data.data(), head, data.data() + data.size() - tail, tail, data.size());
+    if (detection.embedded || archives.count(detection.format) == 0 ||
+        (!formats.empty() && formats.count(detection.format) == 0)) {
+        return nullptr;
+    }
+    return &format_by_name(detection.format);
+}
+
+//The name of the item of a single-file format (gzip, bzip2, xz...) which does not store it, made like 7-Zip does
+//from the name of the container: "a.tar.gz" gives "a.tar", "a.tgz" gives "a.tar"
+inline std::string nested_item_name(const std::string& container){
+    std::string base = std::filesystem::path(container).filename().string();
+    std::string ext = std::filesystem::path(base).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    std::string stem = base.substr(0, base.size() - ext.size());
+    if (ext == ".tgz" || ext == ".tbz" || ext == ".tbz2" || ext == ".txz" || ext == ".taz") {
+        return stem + ".tar";
+    }
+    if (ext == ".gz" || ext == ".bz2" || ext == ".xz" || ext == ".z" || ext == ".lzma" || ext == ".zst") {
+        return stem.empty() ? base : stem;
+    }
+    return base.empty() ? std::string("data") : base + "~";
+}
+
+//Pushes the items of an archive into a stream, opening the items which are archives themselves from memory
+//The paths of the inner items continue the path of their container: "outer/a.tar.gz/a.tar/b.7z/file.txt"
+//An item which cannot be opened as the archive its signature tells is pushed as a file
+//(A solid archive, outer or inner, is decoded in one pass, since decoding its items one by one would decode
+//its solid blocks again for each; the pass is counted against maxBytes like the single items)
+inline void decode_nested(ItemStream& stream, const bit7z::BitFileExtractor& settings, bit7z::BitArchiveReader& reader,
+                          const std::string& prefix, unsigned depth, const NestedLimits& limits, uint64_t& decoded){
+    auto item_path = [&prefix](const bit7z::BitArchiveItem& item){
+        std::string name = item.path().empty() ? nested_item_name(prefix) : item.path();
+        return prefix.empty() ? name : prefix + "/" + name;
+    };
+    auto limit_error = [](const std::string& path){
+        return std::length_error("The nested extraction exceeds the expansion limit at: " + path);
+    };
+
+    //Opens the decoded data of an item as an inner archive, or pushes it as a file
+    auto handle = [&](const bit7z::BitArchiveItem& item, const std::string& path, std::vector<char>&& data){
+        const bit7z::BitInFormat* format = depth < limits.maxDepth ? nested_format(data, limits.formats) : nullptr;
+        if (format != nullptr) {
+            MemoryStreamBuf memory(data.data(), data.size());
+            std::istream in(&memory);
+            std::unique_ptr<bit7z::BitArchiveReader> inner;
+            try {
+                inner.reset(new bit7z::BitArchiveReader(settings.library(), in, *format));
+            } catch (const bit7z::BitException&) {
+                inner.reset();
+            }
+            if (inner) {
+                apply_settings(settings, *inner);
+                decode_nested(stream, settings, *inner, path, depth + 1, limits, decoded);
+                stream.pool().release(std::move(data));
+                return;
+            }
+        }
+        ItemChunk chunk;
+        chunk.item = to_archive_item(item);
+        chunk.item.path = path;
+        chunk.data = std::move(data);
+        stream.push(std::move(chunk));
+    };
+
+    //Decodes one item, growing its buffer as the data comes (the sizes in the headers may lie)
+    auto decode_item = [&](const bit7z::BitArchiveItem& item, const std::string& path){
+        uint64_t room = limits.maxBytes - decoded;
+        if (item.size() > room) {
+            throw limit_error(path);
+        }
+        std::vector<char> data = stream.pool().acquire(initial_reserve(item.size()));
+        {
+            LimitedStreamBuf buffer(data, room);
+            std::ostream out(&buffer);
+            try {
+                reader.extractTo(out, item.index());
+            } catch (...) {
+                if (buffer.exceeded()) {
+                    throw limit_error(path);
+                }
+                throw;
+            }
+        }
+        decoded += data.size();
+        return data;
+    };
+
+    bit7z::ProgressCallback user = settings.progressCallback();
+    std::map<tstring, std::vector<bit7z::byte_t>> solid;
+    bool solidPass = false;
+    std::map<tstring, unsigned> paths;
+    if (reader.isSolid()) {
+        uint64_t declared = 0;
+        for (const auto& item : reader) {
+            declared += item.size();
+            ++paths[item.path()];
+        }
+        uint64_t room = limits.maxBytes - decoded;
+        if (declared > room) {
+            throw limit_error(prefix.empty() ? std::string("the outer archive") : prefix);
+        }
+        //7-Zip reports the decoded bytes, so more than the room left stops it
+        bool exceeded = false;
+        reader.setProgressCallback([&stream, user, room, &exceeded](uint64_t processed){
+            if (processed > room) {
+                exceeded = true;
+            }
+            if (stream.cancelled() || exceeded) {
+                return false;
+            }
+            return user ? user(processed) : true;
+        });
+        try {
+            reader.extractTo(solid);
+        } catch (...) {
+            if (exceeded) {
+                throw limit_error(prefix.empty() ? std::string("the outer archive") : prefix);
+            }
+            throw;
+        }
+        solidPass = true;
+    }
+    reader.setProgressCallback([&stream, user](uint64_t processed){
+        if (stream.cancelled()) {
+            return false;
+        }
+        return user ? user(processed) : true;
+    });
+
+    for (const auto& item : reader) {
+        if (stream.cancelled()) {
+            return;
+        }
+        if (item.isDir()) {
+            continue;
+        }
+        std::string path = item_path(item);
+        auto it = solidPass && paths[item.path()] == 1 ? solid.find(item.path()) : solid.end();
+        if (it == solid.end()) {
+            //Items with the same path share one entry of the map, so they are decoded on their own
+            handle(item, path, decode_item(item, path));
+            continue;
+        }
+        if (it->second.size() > limits.maxBytes - decoded) {
+            throw limit_error(path);
+        }
+        std::vector<char> data = stream.pool().acquire(it->second.size());
+        data.assign(it->second.begin(), it->second.end());
+        solid.erase(it);
+        decoded += data.size();
+        handle(item, path, std::move(data));
+    }
+}
+
+//Decodes an archive and the archives nested in it into a stream, without writing anything to disk
+//(Each item comes in one piece; the containers being read stay in memory until their items are decoded)
+inline ItemStream* nested_stream(const bit7z::BitFileExtractor& self, const tstring& inArchive, const NestedLimits& limits,
+                                 size_t maxQueueBytes){
+    return new ItemStream(4 * 1024 * 1024, maxQueueBytes, [&self, inArchive, limits](ItemStream& stream){
+        //A copy of the settings, since the extractor may be used elsewhere once the stream is made
+        ExtractorPreset preset(self, 0);
+        HandlerHolder<bit7z::BitFileExtractor> settings = preset.create();
+        bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+        apply_settings(*settings, reader);
+        stream.started();
+        uint64_t decoded = 0;
+        decode_nested(stream, *settings, reader, std::string(), 0, limits, decoded);
+    });
+}
+
+//An unnamed temporary file holding the data of the entries until the archive is written
+//(It is removed by the system when it is closed, even if the process dies)
+class SpoolFile {
+public:
+    SpoolFile() : mFile(std::tmpfile()) {
+        if (!mFile) {
+            throw std::runtime_error("Cannot create the temporary file of the archive writer");
+        }
+    }
+
+    ~SpoolFile() {
+        std::fclose(mFile);
+    }
+
+    SpoolFile(const SpoolFile&) = delete;
+    SpoolFile& operator=(const SpoolFile&) = delete;
+
+    //Appends the data at the end of the file; returns its offset
+    uint64_t append(const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        uint64_t offset = mSize;
+        if (!seek(offset) || std::fwrite(data, 1, size, mFile) != size) {
+            throw std::runtime_error("Cannot write the temporary file of the archive writer");
+        }
+        mSize += size;
+        return offset;
+    }
+
+    //Reads at an offset (7-Zip may read several items at once when it compresses with several threads)
+    size_t read(uint64_t offset, char* out, size_t size) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!seek(offset)) {
+            return 0;
+        }
+        return std::fread(out, 1, size, mFile);
+    }
+
+private:
+    bool seek(uint64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(mFile, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(mFile, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    std::FILE* mFile;
+    std::mutex mMutex;
+    uint64_t mSize = 0;
+};
+
+//An input stream buffer over a range of the spool file
+//(The read buffer is only allocated while the item is read, so the streams of many entries cost little)
+class SpoolStreamBuf : public std::streambuf {
+public:
+    SpoolStreamBuf(SpoolFile& file, uint64_t offset, uint64_t size) : mFile(file), mOffset(offset), mSize(size) {}
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (mPos >= mSize) {
+            //The item has been read to the end: its buffer is not needed anymore
+            std::vector<char>().swap(mBuffer);
+            setg(nullptr, nullptr, nullptr);
+            return traits_type::eof();
+        }
+        mBuffer.resize(static_cast<size_t>(std::min<uint64_t>(64 * 1024, mSize - mPos)));
+        size_t got = mFile.read(mOffset + mPos, mBuffer.data(), mBuffer.size());
+        if (got == 0) {
+            return traits_type::eof();
+        }
+        mPos += got;
+        setg(mBuffer.data(), mBuffer.data(), mBuffer.data() + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        off_type current = static_cast<off_type>(mPos) - (egptr() - gptr());
+        off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? current : static_cast<off_type>(mSize);
+        off_type pos = base + off;
+        if (pos < 0 || pos > static_cast<off_type>(mSize)) {
+            return pos_type(off_type(-1));
+        }
+        mPos = static_cast<uint64_t>(pos);
+        setg(nullptr, nullptr, nullptr);
+        return pos_type(pos);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    SpoolFile& mFile;
+    uint64_t mOffset;
+    uint64_t mSize;
+    uint64_t mPos = 0;
+    std::vector<char> mBuffer;
+};
+
+//Writes an archive from in-memory entries which are added one by one
+//The entries are collected into batches of about batchBytes; a full batch is written on a background thread while the next
+//one is filled, so at most two batches are held in memory at the same time.
+//A new tar archive is written natively: each batch goes straight into the archive, so the writing overlaps the producer.
+//Other formats copy each batch into a temporary file, and close() then compresses all the entries with a single writer,
+//so the peak disk use is the total size of the entries besides the archive, and nothing is compressed before close()
+//(7-Zip asks for the sizes of all the items before it reads any of them, so it cannot start before the last entry;
+//appending batch by batch would copy the packed data written so far every time)
+//The entries handed back by add, close and abandon are not needed anymore; they are returned so that their owners
+//are released by the caller (for Python buffers, with the GIL), even when the call throws
+class StreamArchiveWriter {
+public:
+    //An entry refers to memory which stays valid as long as the owner is alive, so the data is never copied
+    struct Entry {
+        tstring name;
+        const char* data = nullptr;
+        size_t size = 0;
+        std::shared_ptr<void> owner;
+    };
+
+    //The compressor is used until the writer is closed, so its settings cannot be changed meanwhile
+    //(The constructor may wait for other threads, so it must be called without the GIL)
+    StreamArchiveWriter(const bit7z::BitFileCompressor& self, const tstring& outFile, size_t batchBytes)
+        : mSelf(self), mUse(&self), mOutFile(outFile), mBatchBytes(batchBytes) {
+        //An existing archive which 7-Zip would update or keep is left to 7-Zip
+        std::error_code ec;
+        bool exists = std::filesystem::exists(outFile, ec);
+        mNativeTar = self.compressionFormat() == bit7z::BitFormat::Tar &&
+                     (!exists || (self.updateMode() == bit7z::UpdateMode::None &&
+                                  self.overwriteMode() == bit7z::OverwriteMode::Overwrite));
+    }
+
+    ~StreamArchiveWriter() {
+        if (mWorker.joinable()) {
+            mWorker.join();
+        }
+    }
+
+    StreamArchiveWriter(const StreamArchiveWriter&) = delete;
+    StreamArchiveWriter& operator=(const StreamArchiveWriter&) = delete;
+
+    //Adds an entry; the entries of a batch which has been copied are moved to done
+    //(It waits for the previous batch when the current one is full, which keeps the producer within the memory bound)
+    void add(Entry&& entry, std::vector<Entry>& done) {
+        std::lock_guard<std::mutex> lock(mCallMutex);
+        if (mClosed) {
+            throw std::runtime_error("The archive writer is closed");
+        }
+        mBatchSize += entry.size;
+        mBatch.push_back(std::move(entry));
+        if (mBatchSize >= mBatchBytes) {
+            submit(done);
+        }
+    }
+
+    //Copies the remaining entries and writes the archive; all the entries are moved to done
+    void close(std::vector<Entry>& done) {
+        std::lock_guard<std::mutex> lock(mCallMutex);
+        if (mClosed) {
+            return;
+        }
+        try {
+            if (!mBatch.empty()) {
+                submit(done);
+            }
+            mClosed = true;
+            finish(done);
+            if (mNativeTar) {
+                endTar();
+            } else {
+                write();
+            }
+        } catch (...) {
+            mClosed = true;
+            discardTar();
+            mUse.release();
+            throw;
+        }
+        mUse.release();
+    }
+
+    //Stops taking entries without writing the archive; returns all the entries still held
+    std::vector<Entry> abandon() {
+        std::lock_guard<std::mutex> lock(mCallMutex);
+        if (mWorker.joinable()) {
+            mWorker.join();
+        }
+        mError = nullptr;
+        mClosed = true;
+        discardTar();
+        mUse.release();
+        std::vector<Entry> left = std::move(mWriting);
+        left.insert(left.end(), std::make_move_iterator(mBatch.begin()), std::make_move_iterator(mBatch.end()));
+        mWriting.clear();
+        mBatch.clear();
+        return left;
+    }
+
+    bool closed() const {
+        return mClosed;
+    }
+
+private:
+    struct Spooled {
+        tstring name;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    //Waits for the batch on the background thread, and rethrows its error
+    //(After an error the writer is closed, and the entries not copied yet are moved to done as well)
+    void finish(std::vector<Entry>& done) {
+        if (mWorker.joinable()) {
+            mWorker.join();
+        }
+        done.insert(done.end(), std::make_move_iterator(mWriting.begin()), std::make_move_iterator(mWriting.end()));
+        mWriting.clear();
+        if (mError) {
+            std::exception_ptr error = mError;
+            mError = nullptr;
+            mClosed = true;
+            done.insert(done.end(), std::make_move_iterator(mBatch.begin()), std::make_move_iterator(mBatch.end()));
+            mBatch.clear();
+            mBatchSize = 0;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void submit(std::vector<Entry>& done) {
+        finish(done);
+        if (mNativeTar) {
+            openTar();
+        } else if (!mSpool) {
+            mSpool.reset(new SpoolFile());
+        }
+        mWriting = std::move(mBatch);
+        mBatch.clear();
+        mBatchSize = 0;
+        mWorker = std::thread([this](){
+            try {
+                for (const Entry& entry : mWriting) {
+                    if (mNativeTar) {
+                        writeTar(entry);
+                        continue;
+                    }
+                    uint64_t offset = mSpool->append(entry.data, entry.size);
+                    mSpooled.push_back({entry.name, offset, entry.size});
+                }
+            } catch (...) {
+                mError = std::current_exception();
+            }
+        });
+    }
+
+    void openTar() {
+        if (mTar) {
+            return;
+        }
+        mTar.reset(new std::ofstream(mOutFile, std::ios::binary | std::ios::trunc));
+        if (!*mTar) {
+            mTar.reset();
+            throw std::runtime_error("Cannot open the output file: " + mOutFile);
+        }
+        mTarTime = static_cast<int64_t>(std::time(nullptr));
+    }
+
+    void putTar(const char* data, size_t size) {
+        mTar->write(data, static_cast<std::streamsize>(size));
+        if (!*mTar) {
+            throw std::runtime_error("Cannot write the output file: " + mOutFile);
+        }
+    }
+
+    //Writes an entry as a regular file stamped with the time the archive was opened (like 7-Zip does for streams)
+    void writeTar(const Entry& entry) {
+        tarnative::Header fields;
+        fields.name = entry.name;
+        std::replace(fields.name.begin(), fields.name.end(), '\\', '/');
+        fields.size = entry.size;
+        fields.mode = 0644;
+        fields.mtime = mTarTime;
+        std::vector<char> header;
+        tarnative::append_header(header, fields);
+        putTar(header.data(), header.size());
+        putTar(entry.data, entry.size);
+        header.clear();
+        tarnative::append_padding(header, entry.size);
+        putTar(header.data(), header.size());
+    }
+
+    void endTar() {
+        openTar();
+        std::vector<char> end;
+        tarnative::append_end(end);
+        putTar(end.data(), end.size());
+        mTar->close();
+        if (!*mTar) {
+            throw std::runtime_error("Cannot write the output file: " + mOutFile);
+        }
+        mTar.reset();
+    }
+
+    //Removes a tar archive which was not finished
+    void discardTar() {
+        if (!mTar) {
+            return;
+        }
+        mTar.reset();
+        std::error_code ec;
+        std::filesystem::remove(mOutFile, ec);
+    }
+
+    //Compresses all the copied entries in one pass
+    //(The writer is set up on the calling thread, so the compressor is only read there)
+    void write() {
+        bit7z::BitArchiveWriter writer(mSelf.library(), mSelf.compressionFormat());
+        apply_settings(mSelf, writer);
+        std::vector<std::unique_ptr<SpoolStreamBuf>> buffers;
+        std::vector<std::unique_ptr<std::istream>> streams;
+        buffers.reserve(mSpooled.size());
+        streams.reserve(mSpooled.size());
+        for (const Spooled& entry : mSpooled) {
+            buffers.emplace_back(new SpoolStreamBuf(*mSpool, entry.offset, entry.size));
+            streams.emplace_back(new std::istream(buffers.back().get()));
+            writer.addFile(*streams.back(), entry.name);
+        }
+        writer.compressTo(mOutFile);
+    }
+
+    const bit7z::BitFileCompressor& mSelf;
+    HandlerUse mUse;
+    tstring mOutFile;
+    size_t mBatchBytes;
+
+    //Serializes add, close and abandon, which may be called by several Python threads
+    std::mutex mCallMutex;
+    std::vector<Entry> mBatch;
+    size_t mBatchSize = 0;
+    std::vector<Entry> mWriting;
+    std::thread mWorker;
+    std::exception_ptr mError;
+    std::unique_ptr<SpoolFile> mSpool;
+    std::vector<Spooled> mSpooled;
+    bool mNativeTar = false;
+    std::unique_ptr<std::ofstream> mTar;
+    int64_t mTarTime = 0;
+    std::atomic<bool> mClosed{false};
+};
+
+//An output stream buffer which only computes the CRC32 and the size of the data written to it
+class CrcStreamBuf : public std::streambuf {
+public:
+    uint32_t crc() const {
+        return mCrc;
+    }
+
+    uint64_t size() const {
+        return mSize;
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            char c = traits_type::to_char_type(ch);
+            mCrc = checksum::crc32_update(mCrc, &c, 1);
+            ++mSize;
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        mCrc = checksum::crc32_update(mCrc, s, static_cast<size_t>(n));
+        mSize += static_cast<uint64_t>(n);
+        return n;
+    }
+
+private:
+    uint32_t mCrc = 0;
+    uint64_t mSize = 0;
+};
+
+//A failure found by verify_archives; index is -1 when the failure is not about a single item
+struct VerifyFailure {
+    tstring archive;
+    int64_t index = -1;
+    tstring path;
+    bit7z::BitFailureSource source = bit7z::BitFailureSource::DataError;
+    std::string message;
+};
+
+struct VerifyReport {
+    uint64_t archives = 0;
+    uint64_t items = 0;
+    uint64_t bytes = 0;
+    std::vector<VerifyFailure> failures;
+};
+
+//The failure source of an error code reported by bit7z
+inline bit7z::BitFailureSource failure_source(const std::error_code& code, bit7z::BitFailureSource fallback){
+    static const bit7z::BitFailureSource sources[] = {
+        bit7z::BitFailureSource::CRCError,
+        bit7z::BitFailureSource::DataError,
+        bit7z::BitFailureSource::DataAfterEnd,
+        bit7z::BitFailureSource::UnexpectedEnd,
+        bit7z::BitFailureSource::HeadersError,
+        bit7z::BitFailureSource::WrongPassword,
+        bit7z::BitFailureSource::UnavailableData,
+        bit7z::BitFailureSource::InvalidArchive,
+        bit7z::BitFailureSource::FormatDetectionError,
+        bit7z::BitFailureSource::NoSuchItem,
+        bit7z::BitFailureSource::OperationNotSupported,
+        bit7z::BitFailureSource::OperationNotPermitted,
+        bit7z::BitFailureSource::InvalidArgument,
+    };
+    for (bit7z::BitFailureSource source : sources) {
+        if (code == source) {
+            return source;
+        }
+    }
+    return fallback;
+}
+
+//Whether the CRC property of the items of a format is a CRC32 of their data
+//(LZH stores a CRC16, cpio a plain sum, the others no CRC at all: only their decoders can check them)
+inline bool stores_crc32(const bit7z::BitInFormat& format){
+    static const bit7z::BitInFormat* formats[] = {
+        &bit7z::BitFormat::SevenZip, &bit7z::BitFormat::Zip, &bit7z::BitFormat::Rar, &bit7z::BitFormat::Rar5,
+        &bit7z::BitFormat::GZip, &bit7z::BitFormat::Arj,
+    };
+    for (const bit7z::BitInFormat* known : formats) {
+        if (format == *known) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//The items of a non-solid archive are verified in batches of about this size, so that the workers share the large archives
+constexpr uint64_t kVerifyBatchBytes = 32 * 1024 * 1024;
+constexpr size_t kVerifyBatchItems = 256;
+
+//Verifies archives with a pool of threads shared by all of them
+//Non-solid archives are split into batches of items, which are decoded by any worker into a CRC32 stream
+//and checked against the size and the CRC32 of the item when the format stores them; solid archives are tested as a whole by one worker
+//(Each worker opens its own reader, since a reader cannot be used by several threads)
+inline VerifyReport verify_archives(const bit7z::BitFileExtractor& self, const std::vector<tstring>& archives, unsigned threads){
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    struct Task {
+        size_t archive;
+        bool open;
+        std::vector<uint32_t> indices;
+        std::vector<tstring> paths;    //The paths of the items, to report them when the archive cannot be reopened
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Task> tasks;
+    size_t pending = archives.size();
+    VerifyReport report;
+    report.archives = archives.size();
+    for (size_t i = 0; i < archives.size(); ++i) {
+        tasks.push_back(Task{i, true, {}, {}});
+    }
+
+    auto fail = [&](size_t archive, int64_t index, const tstring& path, bit7z::BitFailureSource source, const std::string& message){
+        std::lock_guard<std::mutex> lock(mutex);
+        report.failures.push_back(VerifyFailure{archives[archive], index, path, source, message});
+    };
+
+    auto open = [&](size_t archive){
+        std::unique_ptr<bit7z::BitArchiveReader> reader(
+            new bit7z::BitArchiveReader(self.library(), archives[archive], input_format(self, archives[archive])));
+        //Only the password, the callbacks of the extractor would be called from all the workers
+        if (self.isPasswordDefined()) {
+            reader->setPassword(self.password());
+        }
+        reader->setPasswordCallback(self.passwordCallback());
+        return reader;
+    };
+
+    auto worker = [&](){
+        size_t current = archives.size();
+        std::unique_ptr<bit7z::BitArchiveReader> reader;
+        bool crc32 = false, gzip = false;
+        uint64_t items = 0, bytes = 0;
+        for (;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&](){ return !tasks.empty() || pending == 0; });
+                if (tasks.empty()) {
+                    break;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            if (current != task.archive) {
+                reader.reset();
+                current = archives.size();
+                bit7z::BitFailureSource source = bit7z::BitFailureSource::InvalidArchive;
+                std::string message;
+                try {
+                    reader = open(task.archive);
+                    crc32 = stores_crc32(reader->detectedFormat());
+                    gzip = reader->detectedFormat() == bit7z::BitFormat::GZip;
+                    current = task.archive;
+                } catch (const bit7z::BitException& ex) {
+                    source = failure_source(ex.code(), bit7z::BitFailureSource::InvalidArchive);
+                    message = ex.what();
+                } catch (const std::exception& ex) {
+                    message = ex.what();
+                }
+                //The task which lists the archive reports it once; a batch reports each of its items,
+                //since they were listed but could not be checked (the file may have been changed or removed meanwhile)
+                if (!reader && task.open) {
+                    fail(task.archive, -1, {}, source, message);
+                } else if (!reader) {
+                    for (size_t i = 0; i < task.indices.size(); ++i) {
+                        fail(task.archive, task.indices[i], task.paths[i], source, "Cannot reopen the archive: " + message);
+                    }
+                }
+            }
+
+            if (reader && task.open) {
+                std::vector<Task> batches;
+                try {
+                    if (reader->isSolid()) {
+                        reader->test();
+                        for (const auto& item : *reader) {
+                            ++items;
+                            bytes += item.size();
+                        }
+                    } else {
+                        Task batch{task.archive, false, {}, {}};
+                        uint64_t batchBytes = 0;
+                        for (const auto& item : *reader) {
+                            if (item.isDir()) {
+                                continue;
+                            }
+                            batch.indices.push_back(item.index());
+                            batch.paths.push_back(item.path());
+                            batchBytes += item.size();
+                            if (batchBytes >= kVerifyBatchBytes || batch.indices.size() >= kVerifyBatchItems) {
+                                batches.push_back(std::move(batch));
+                                batch = Task{task.archive, false, {}, {}};
+                                batchBytes = 0;
+                            }
+                        }
+                        if (!batch.indices.empty()) {
+                            batches.push_back(std::move(batch));
+                        }
+                    }
+                } catch (const bit7z::BitException& ex) {
+                    fail(task.archive, -1, {}, failure_source(ex.code(), bit7z::BitFailureSource::DataError), ex.what());
+                } catch (const std::exception& ex) {
+                    fail(task.archive, -1, {}, bit7z::BitFailureSource::DataError, ex.what());
+                }
+                if (!batches.empty()) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        pending += batches.size();
+                        for (Task& batch : batches) {
+                            tasks.push_back(std::move(batch));
+                        }
+                    }
+                    condition.notify_all();
+                }
+            } else if (reader) {
+                for (uint32_t index : task.indices) {
+                    tstring path;
+                    try {
+                        auto item = reader->itemAt(index);
+                        path = item.path();
+                        CrcStreamBuf crc;
+                        std::ostream out(&crc);
+                        reader->extractTo(out, index);
+                        ++items;
+                        bytes += crc.size();
+                        //The decoders check the CRC themselves, this also catches a mismatch they could not see
+                        //(The size is compared only when the archive stores it: bzip2 has none, the size of gzip wraps at 4 GiB)
+                        bool sized = !gzip && !item.itemProperty(bit7z::BitProperty::Size).isEmpty();
+                        if (sized && crc.size() != item.size()) {
+                            fail(task.archive, index, path, bit7z::BitFailureSource::DataError,
+                                 "Size mismatch: " + std::to_string(crc.size()) + " of " + std::to_string(item.size()) + " bytes");
+                        } else if (crc32 && item.crc() != 0 && crc.crc() != item.crc()) {
+                            fail(task.archive, index, path, bit7z::BitFailureSource::CRCError, "CRC mismatch");
+                        }
+                    } catch (const bit7z::BitException& ex) {
+                        fail(task.archive, index, path, failure_source(ex.code(), bit7z::BitFailureSource::DataError), ex.what());
+                    } catch (const std::exception& ex) {
+                        fail(task.archive, index, path, bit7z::BitFailureSource::DataError, ex.what());
+                    }
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --pending;
+            }
+            condition.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        report.items += items;
+        report.bytes += bytes;
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    std::sort(report.failures.begin(), report.failures.end(), [&](const VerifyFailure& a, const VerifyFailure& b){
+        return a.archive != b.archive ? a.archive < b.archive : a.index < b.index;
+    });
+    return report;
+}
+
+//Thrown when an operation is stopped by a CancelToken or by its deadline
+class OperationCancelled : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+//Thrown when an output file cannot be created or written (a full disk, a denied permission...)
+//(The fast paths raise it as it is instead of falling back to 7-Zip, which would only fail the same way)
+class OutputError : public std::runtime_error {
+public:
+    OutputError(const std::string& what, const std::string& path)
+        : std::runtime_error(what + ": " + path + " (" + std::strerror(errno) + ")") {}
+};
+
+//A cancellation flag shared between Python and the native threads, with an optional deadline
+//(It is checked by the progress callbacks without the GIL)
+class CancelToken {
+public:
+    void cancel() {
+        mCancelled = true;
+    }
+
+    //Cancels the operations after the given seconds from now (0 or less removes the deadline)
+    void setTimeout(double seconds) {
+        mDeadline = seconds > 0 ? now() + static_cast<int64_t>(seconds * 1e9) : 0;
+    }
+
+    void reset() {
+        mCancelled = false;
+        mDeadline = 0;
+    }
+
+    bool expired() const {
+        int64_t deadline = mDeadline;
+        return deadline != 0 && now() >= deadline;
+    }
+
+    bool cancelled() const {
+        return mCancelled || expired();
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<bool> mCancelled{false};
+    std::atomic<int64_t> mDeadline{0};
+};
+
+//The cancellation state of one call: the token of the caller (may be null) and the timeout of the call
+class CancelScope {
+public:
+    CancelScope(const CancelToken* token, double timeout)
+        : mToken(token), mDeadline(timeout > 0 ? CancelToken::now() + static_cast<int64_t>(timeout * 1e9) : 0) {}
+
+    bool active() const {
+        return mToken != nullptr || mDeadline != 0;
+    }
+
+    bool timedOut() const {
+        return (mDeadline != 0 && CancelToken::now() >= mDeadline) || (mToken && mToken->expired());
+    }
+
+    bool stopped() const {
+        return (mToken && mToken->cancelled()) || (mDeadline != 0 && CancelToken::now() >= mDeadline);
+    }
+
+    //A progress callback which stops the operation when the scope is stopped, and otherwise calls the one of the user
+    //(It holds a copy of the scope: while it is set on a compressor, another thread may read it with progress_callback()
+    //and call it after this scope is gone)
+    bit7z::ProgressCallback wrap(bit7z::ProgressCallback user) const {
+        return [scope = *this, user](uint64_t processed){
+            if (scope.stopped()) {
+                return false;
+            }
+            return user ? user(processed) : true;
+        };
+    }
+
+    [[noreturn]] void raise() const {
+        throw OperationCancelled(timedOut() ? "The operation timed out" : "The operation was cancelled");
+    }
+
+private:
+    const CancelToken* mToken;
+    int64_t mDeadline;
+};
+
+//Extracts an archive under a scope: a cancelled extraction removes the files it has created
+//(indices selects the items to extract, all the items are extracted when it is null)
+//(The files which existed before are left, even when the extraction has overwritten them)
+inline void extract_cancellable(const bit7z::BitFileExtractor& self, bit7z::BitArchiveReader& reader,
+                                const tstring& outDir, const CancelScope& scope,
+                                const std::vector<uint32_t>* indices = nullptr, uint64_t progressOffset = 0){
+    std::vector<std::string> written;
+    bit7z::FileCallback user = self.fileCallback();
+    reader.setFileCallback([&written, &outDir, user](tstring name){
+        //The callback may get the item path or the path on disk; it is called before 7-Zip creates the file
+        std::string path = std::filesystem::path(name).is_absolute() ? name : item_output_path(outDir, name);
+        std::error_code ec;
+        if (!std::filesystem::exists(std::filesystem::symlink_status(path, ec))) {
+            written.push_back(path);
+        }
+        if (user) {
+            user(name);
+        }
+    });
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    if (progressOffset != 0 && progress) {
+        //The bytes written before by the caller come first
+        reader.setProgressCallback([progress, progressOffset](uint64_t done){
+            return progress(progressOffset + done);
+        });
+    } else {
+        reader.setProgressCallback(progress);
+    }
+    try {
+        if (indices) {
+            reader.extractTo(outDir, *indices);
+        } else {
+            reader.extractTo(outDir);
+        }
+    } catch (...) {
+        if (!scope.stopped()) {
+            throw;
+        }
+        std::error_code ec;
+        for (const auto& path : written) {
+            if (!path.empty() && !std::filesystem::is_directory(path, ec)) {
+                std::filesystem::remove(path, ec);
+            }
+        }
+        scope.raise();
+    }
+}
+
+//Sets the wrapped progress callback of a scope on a compressor, and restores the one of the user afterwards
+class ProgressGuard {
+public:
+    //The compressor must be used exclusively by the caller
+    ProgressGuard(bit7z::BitFileCompressor& compressor, const CancelScope& scope)
+        : mCompressor(compressor), mUserCallback(compressor.progressCallback()) {
+        SettingsWrite write(&compressor, false);
+        compressor.setProgressCallback(scope.wrap(mUserCallback));
+    }
+
+    ~ProgressGuard() {
+        SettingsWrite write(&mCompressor, false);
+        mCompressor.setProgressCallback(mUserCallback);
+    }
+
+    ProgressGuard(const ProgressGuard&) = delete;
+    ProgressGuard& operator=(const ProgressGuard&) = delete;
+
+private:
+    bit7z::BitFileCompressor& mCompressor;
+    bit7z::ProgressCallback mUserCallback;
+};
+
+//Runs a compression under a scope: a cancelled compression removes the output file if it did not exist before
+template<typename Fn>
+void run_cancellable(bit7z::BitFileCompressor& self, const tstring& outFile, const CancelScope& scope, Fn compress){
+    if (!scope.active()) {
+        compress();
+        return;
+    }
+    std::error_code ec;
+    bool existed = std::filesystem::exists(outFile, ec);
+    ProgressGuard guard(self, scope);
+    try {
+        compress();
+    } catch (...) {
+        if (!scope.stopped()) {
+            throw;
+        }
+        if (!existed) {
+            std::filesystem::remove(outFile, ec);
+        }
+        scope.raise();
+    }
+}
+
+//The default block of the block compression: big enough to lose little ratio, small enough to spread over the cores
+//(xz uses 3 dictionaries like xz -T, bzip2 uses nine 900 KB blocks of its own)
+inline size_t default_block_size(const bit7z::BitFileCompressor& self){
+    if (self.compressionFormat() == bit7z::BitFormat::Xz) {
+        uint32_t dictionary = self.dictionarySize() != 0 ? self.dictionarySize() : (8u << 20);
+        return std::max<size_t>(static_cast<size_t>(dictionary) * 3, 1u << 20);
+    }
+    if (self.compressionFormat() == bit7z::BitFormat::BZip2) {
+        return 9 * 900000;
+    }
+    return 4u << 20;
+}
+
+//Compresses one file to gzip, bzip2 or xz block by block on several threads, like pigz
+//Every block becomes a complete gzip member, bzip2 stream or xz stream; their concatenation is a standard file,
+//which gzip -d, bzip2 -d and xz -d read as a whole. The settings of the compressor are used for every block.
+//(A cancelled or failed compression removes the output file)
+inline void compress_file_blocks(const bit7z::BitFileCompressor& self, const tstring& inFile, const tstring& outFile,
+                                 const tstring& inputName, unsigned threads, size_t blockSize, const CancelScope& scope){
+    const bit7z::BitInOutFormat& format = self.compressionFormat();
+    if (format != bit7z::BitFormat::GZip && format != bit7z::BitFormat::BZip2 && format != bit7z::BitFormat::Xz) {
+        throw std::invalid_argument("The block compression supports the gzip, bzip2 and xz formats only");
+    }
+    if (blockSize == 0) {
+        blockSize = default_block_size(self);
+    }
+    std::error_code ec;
+    if (std::filesystem::exists(outFile, ec)) {
+        if (self.overwriteMode() == bit7z::OverwriteMode::Skip) {
+            return;
+        }
+        if (self.overwriteMode() == bit7z::OverwriteMode::None) {
+            throw std::runtime_error("The output file already exists: " + outFile);
+        }
+    }
+    std::ifstream input(inFile, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open the input file: " + inFile);
+    }
+    std::ofstream output(outFile, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("Cannot open the output file: " + outFile);
+    }
+
+    //One memory compressor per worker, with the settings of the compressor (the blocks are the parallelism)
+    OrderedBlockPipeline<std::vector<bit7z::byte_t>> pipeline(threads);
+    FormatProperties properties = FormatPropertyStore::global().get(&self);
+    std::vector<std::unique_ptr<bit7z::BitMemCompressor>> compressors;
+    for (unsigned i = 0; i < pipeline.threads(); ++i) {
+        std::unique_ptr<bit7z::BitMemCompressor> compressor(new bit7z::BitMemCompressor(self.library(), format));
+        compressor->setCompressionLevel(self.compressionLevel());
+        compressor->setCompressionMethod(self.compressionMethod());
+        if (self.dictionarySize() != 0) {
+            compressor->setDictionarySize(self.dictionarySize());
+        }
+        if (self.wordSize() != 0) {
+            compressor->setWordSize(self.wordSize());
+        }
+        compressor->setThreadsCount(1);
+        apply_format_properties(*compressor, properties);
+        compressors.push_back(std::move(compressor));
+    }
+
+    uint64_t total = std::filesystem::file_size(inFile, ec);
+    if (self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    if (self.fileCallback()) {
+        self.fileCallback()(inputName.empty() ? inFile : inputName);
+    }
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    uint64_t blocks = 0;
+    uint64_t done = 0;
+
+    try {
+        pipeline.run(
+            [&](std::vector<bit7z::byte_t>& in){
+                if (scope.stopped()) {
+                    scope.raise();
+                }
+                in.resize(blockSize);
+                input.read(reinterpret_cast<char*>(in.data()), static_cast<std::streamsize>(blockSize));
+                in.resize(static_cast<size_t>(input.gcount()));
+                if (input.bad()) {
+                    throw std::runtime_error("Cannot read the input file: " + inFile);
+                }
+                //An empty file still gets one (empty) member
+                if (in.empty() && blocks > 0) {
+                    return false;
+                }
+                ++blocks;
+                return true;
+            },
+            [&](unsigned worker, uint64_t index, const std::vector<bit7z::byte_t>& in, std::vector<bit7z::byte_t>& out){
+                //Only the first member carries the name, like pigz
+                compressors[worker]->compressFile(in, out, index == 0 ? inputName : tstring());
+            },
+            [&](uint64_t, const std::vector<bit7z::byte_t>& in, std::vector<bit7z::byte_t>& out){
+                output.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+                if (!output) {
+                    throw std::runtime_error("Cannot write the output file: " + outFile);
+                }
+                done += in.size();
+                if (!progress(done)) {
+                    throw OperationCancelled("The operation was aborted by the progress callback");
+                }
+            });
+        output.close();
+        if (!output) {
+            throw std::runtime_error("Cannot write the output file: " + outFile);
+        }
+    } catch (...) {
+        output.close();
+        std::filesystem::remove(outFile, ec);
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        throw;
+    }
+}
+
+//Extracts a gzip, bzip2 or xz file made of independent pieces on several threads, writing the output in order
+//The pieces are the gzip members and bzip2 streams found by a header scan (pigz --independent, pbzip2, compress_file
+//with blockThreads), or the blocks listed by the xz index (xz -T, pixz), each group wrapped into a stream of its own.
+//Each piece is decoded in memory up to a cap, which keeps the pieces in flight within about 1 GiB in all.
+//It returns false when the file cannot be split, a piece fails to decode (a header scan may find false members)
+//or a piece decodes to more than the cap, and the caller then extracts the file as usual, streaming it to disk;
+//the partial output is removed first. Errors of the output file are raised as OutputError.
+inline bool extract_parallel(const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& outDir,
+                             const bit7z::BitInFormat& format, unsigned threads, const CancelScope& scope){
+    bool xz = format == bit7z::BitFormat::Xz;
+    if (!xz && format != bit7z::BitFormat::GZip && format != bit7z::BitFormat::BZip2) {
+        return false;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads < 2) {
+        return false;
+    }
+
+    //About the compressed bytes handed to one decoder, and the most a piece may decode to: the pipeline holds up to
+    //two pieces per thread, so the cap shrinks as the threads grow
+    const size_t target = 4u << 20;
+    const uint64_t budget = 1ull << 30;
+    const uint64_t maxDecoded = std::min<uint64_t>(256u << 20, std::max<uint64_t>(16u << 20, budget / (2 * threads)));
+    std::ifstream input(inArchive, std::ios::binary);
+    if (!input) {
+        return false;
+    }
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(inArchive, ec);
+
+    //The xz blocks grouped by stream, about target compressed bytes per group
+    struct Group {
+        size_t first;
+        size_t count;
+        uint64_t offset;
+        uint64_t bytes;
+        uint64_t decoded;
+    };
+    std::vector<streamsplit::XzBlock> blocks;
+    std::vector<Group> groups;
+    uint64_t total = 0;
+    std::unique_ptr<streamsplit::MemberSplitter> splitter;
+    std::vector<bit7z::byte_t> first;
+    if (xz) {
+        if (!streamsplit::read_xz_index(input, size, blocks) || blocks.size() < 2) {
+            return false;
+        }
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            const auto& block = blocks[i];
+            if (block.uncompressed > maxDecoded) {
+                return false;
+            }
+            total += block.uncompressed;
+            if (groups.empty() || blocks[groups.back().first].stream != block.stream ||
+                groups.back().bytes >= target || groups.back().decoded + block.uncompressed > maxDecoded) {
+                groups.push_back({i, 0, block.offset, 0, 0});
+            }
+            groups.back().count++;
+            groups.back().bytes += block.padded();
+            groups.back().decoded += block.uncompressed;
+        }
+        if (groups.size() < 2) {
+            return false;
+        }
+    } else {
+        unsigned char head[10];
+        input.read(reinterpret_cast<char*>(head), sizeof(head));
+        streamsplit::Kind kind = format == bit7z::BitFormat::GZip ? streamsplit::Kind::GZip : streamsplit::Kind::BZip2;
+        if (static_cast<size_t>(input.gcount()) != sizeof(head) || !streamsplit::is_member_header(kind, head, sizeof(head))) {
+            return false;
+        }
+        input.clear();
+        input.seekg(0);
+        //The first piece tells whether there is a second member near the start at all
+        splitter.reset(new streamsplit::MemberSplitter(input, kind, target));
+        try {
+            if (!splitter->next(first) || first.size() == size) {
+                return false;
+            }
+        } catch (const streamsplit::NotSplittable&) {
+            return false;
+        }
+    }
+
+    //The name of the single item: the one stored in the file, or the name of the file without its extension
+    tstring name;
+    {
+        bit7z::BitArchiveReader reader(self.library(), inArchive, format);
+        if (reader.itemsCount() > 0) {
+            name = reader.itemAt(0).path();
+        }
+    }
+    if (name.empty()) {
+        name = std::filesystem::path(inArchive).stem().string();
+    }
+    std::string path = item_output_path(outDir, std::filesystem::path(name).filename().string());
+    if (path.empty()) {
+        return false;
+    }
+    if (std::filesystem::exists(path, ec)) {
+        if (self.overwriteMode() == bit7z::OverwriteMode::Skip) {
+            return true;
+        }
+        if (self.overwriteMode() == bit7z::OverwriteMode::None) {
+            throw std::runtime_error("The output file already exists: " + path);
+        }
+    }
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw OutputError("Cannot create the output file", path);
+    }
+
+    OrderedBlockPipeline<std::vector<bit7z::byte_t>> pipeline(threads);
+    std::vector<std::unique_ptr<bit7z::BitMemExtractor>> extractors;
+    for (unsigned i = 0; i < pipeline.threads(); ++i) {
+        extractors.emplace_back(new bit7z::BitMemExtractor(self.library(), format));
+    }
+    if (total != 0 && self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    if (self.fileCallback()) {
+        self.fileCallback()(name);
+    }
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    size_t next = 0;
+    bool firstTaken = false;
+    uint64_t done = 0;
+
+    try {
+        pipeline.run(
+            [&](std::vector<bit7z::byte_t>& in){
+                if (scope.stopped()) {
+                    scope.raise();
+                }
+                if (!xz) {
+                    if (!firstTaken) {
+                        firstTaken = true;
+                        in.swap(first);
+                        return true;
+                    }
+                    return splitter->next(in);
+                }
+                if (next == groups.size()) {
+                    return false;
+                }
+                const Group& group = groups[next++];
+                in.resize(static_cast<size_t>(group.bytes));
+                input.clear();
+                input.seekg(static_cast<std::streamoff>(group.offset));
+                input.read(reinterpret_cast<char*>(in.data()), static_cast<std::streamsize>(group.bytes));
+                if (static_cast<uint64_t>(input.gcount()) != group.bytes) {
+                    throw std::runtime_error("Cannot read the compressed file: " + inArchive);
+                }
+                return true;
+            },
+            [&](unsigned worker, uint64_t index, const std::vector<bit7z::byte_t>& in, std::vector<bit7z::byte_t>& out){
+                //The decoded data of a member is only known while it is decoded, so it is refused past the cap
+                out.clear();
+                uint64_t limit = xz ? groups[static_cast<size_t>(index)].decoded : maxDecoded;
+                LimitedStreamBuf<bit7z::byte_t> buffer(out, limit);
+                std::ostream stream(&buffer);
+                if (!xz) {
+                    extractors[worker]->extract(in, stream, 0);
+                } else {
+                    const Group& group = groups[static_cast<size_t>(index)];
+                    extractors[worker]->extract(streamsplit::make_xz_stream(&blocks[group.first], group.count, in.data(), in.size()), stream, 0);
+                }
+                if (buffer.exceeded()) {
+                    throw std::length_error("A piece decodes to more than the memory cap");
+                }
+                if (xz && out.size() != groups[static_cast<size_t>(index)].decoded) {
+                    throw std::runtime_error("The size of a decoded xz block does not match the index");
+                }
+            },
+            [&](uint64_t, const std::vector<bit7z::byte_t>&, std::vector<bit7z::byte_t>& out){
+                output.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+                if (!output) {
+                    throw OutputError("Cannot write the output file", path);
+                }
+                done += out.size();
+                if (!progress(done)) {
+                    throw OperationCancelled("The operation was aborted by the progress callback");
+                }
+            });
+        output.close();
+        if (!output) {
+            throw OutputError("Cannot write the output file", path);
+        }
+    } catch (const OperationCancelled&) {
+        output.close();
+        std::filesystem::remove(path, ec);
+        throw;
+    } catch (const OutputError&) {
+        output.close();
+        std::filesystem::remove(path, ec);
+        throw;
+    } catch (...) {
+        output.close();
+        std::filesystem::remove(path, ec);
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        return false;
+    }
+    return true;
+}
+
+//The item paths are compared with slashes as separators
+inline std::string slash_path(std::string path){
+    std::replace(path.begin(), path.end(), '\\', '/');
+    return path;
+}
+
+//Reads the size and the modification time (in nanoseconds) of an archive
+inline bool stat_archive(const tstring& path, uint64_t& size, int64_t& mtime){
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+    return true;
+}
+
+//Compresses files into a 7z archive whose solid blocks hold at most blockBytes bytes and blockFiles files;
+//7-Zip decodes a solid block from its start up to the item read, so the small blocks bound the data decoded for one item
+//(0 leaves that limit out; a cancelled compression removes the archive if it did not exist before)
+inline void compress_seekable(const bit7z::BitFileCompressor& self, const std::vector<tstring>& inPaths, const tstring& outFile,
+                              uint64_t blockBytes, uint64_t blockFiles, const CancelScope& scope){
+    if (self.compressionFormat() != bit7z::BitFormat::SevenZip) {
+        throw std::invalid_argument("The seekable profile supports the 7z format only");
+    }
+    std::string limit;
+    if (blockBytes != 0) {
+        limit += std::to_string(blockBytes) + "b";
+    }
+    if (blockFiles != 0) {
+        limit += std::to_string(blockFiles) + "f";
+    }
+    FormatProperties properties;
+    if (!limit.empty()) {
+        properties = validate_format_properties(self.compressionFormat(), {{"s", FormatPropertyValue(limit)}});
+    }
+
+    std::error_code ec;
+    bool existed = std::filesystem::exists(outFile, ec);
+    bit7z::BitArchiveWriter writer(self.library(), self.compressionFormat());
+    apply_settings(self, writer);
+    writer.setSolidMode(true);
+    apply_format_properties(writer, properties);
+    writer.setProgressCallback(scope.wrap(self.progressCallback()));
+    try {
+        writer.addItems(inPaths);
+        writer.compressTo(outFile);
+    } catch (...) {
+        if (!scope.stopped()) {
+            throw;
+        }
+        if (!existed) {
+            std::filesystem::remove(outFile, ec);
+        }
+        scope.raise();
+    }
+}
+
+//Finds an item by its path, with either separator (like reader.find(), which needs the exact path)
+//(It throws when the item does not exist)
+inline uint32_t find_item_path(const bit7z::BitArchiveReader& reader, const tstring& itemPath){
+    std::string path = slash_path(itemPath);
+    for (const auto& item : reader) {
+        if (slash_path(item.path()) == path) {
+            return item.index();
+        }
+    }
+    throw std::out_of_range("No item in the archive has the path: " + itemPath);
+}
+
+#ifndef _WIN32
+//A file or a directory given to the native tar writer
+struct TarSource {
+    std::string path;
+    tarnative::Header header;
+};
+
+//Lists the inputs like bit7z does: a file by its name, a directory by its name followed by its contents (depth first,
+//in the order of the directory); returns false for the inputs it leaves to 7-Zip (links and special files)
+inline bool list_tar_sources(const std::string& path, const std::string& name, std::vector<TarSource>& sources){
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot read the input: " + path);
+    }
+    TarSource source;
+    source.path = path;
+    source.header.mode = static_cast<uint32_t>(st.st_mode & 07777);
+    source.header.mtime = static_cast<int64_t>(st.st_mtime);
+    if (S_ISREG(st.st_mode)) {
+        source.header.name = name;
+        source.header.type = '0';
+        source.header.size = static_cast<uint64_t>(st.st_size);
+        sources.push_back(std::move(source));
+        return true;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    source.header.name = name + "/";
+    source.header.type = '5';
+    sources.push_back(std::move(source));
+    for (const auto& entry : std::filesystem::directory_iterator(path)) {
+        if (!list_tar_sources(entry.path().string(), name + "/" + entry.path().filename().string(), sources)) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+//Writes an uncompressed tar archive without 7-Zip: the headers are made natively (in the layout of the 7-Zip tar writer)
+//and the data is copied by the kernel from the input files to the archive (copy_file_range, then sendfile)
+//It returns false, writing nothing, when 7-Zip must do it: another format, an update of an existing archive,
+//retained directories, symbolic links or special files among the inputs, or Windows
+inline bool compress_tar_native(const bit7z::BitFileCompressor& self, const std::vector<tstring>& inPaths,
+                                const tstring& outFile, const CancelScope& scope){
+#ifdef _WIN32
+    return false;
+#else
+    if (self.compressionFormat() != bit7z::BitFormat::Tar || self.retainDirectories()) {
+        return false;
+    }
+    std::error_code ec;
+    bool exists = std::filesystem::exists(outFile, ec);
+    if (exists && self.updateMode() != bit7z::UpdateMode::None) {
+        return false;
+    }
+    std::vector<TarSource> sources;
+    for (const auto& path : inPaths) {
+        std::filesystem::path input = std::filesystem::path(path).lexically_normal();
+        if (!input.has_filename()) {
+            input = input.parent_path();
+        }
+        if (!list_tar_sources(path, input.filename().string(), sources)) {
+            return false;
+        }
+    }
+    if (exists) {
+        if (self.overwriteMode() == bit7z::OverwriteMode::Skip) {
+            return true;
+        }
+        if (self.overwriteMode() == bit7z::OverwriteMode::None) {
+            throw std::runtime_error("The output file already exists: " + outFile);
+        }
+    }
+
+    tarnative::Fd output(::open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (!output) {
+        throw std::runtime_error("Cannot open the output file: " + outFile);
+    }
+    uint64_t total = 0;
+    for (const auto& source : sources) {
+        total += source.header.size;
+    }
+    if (self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    uint64_t done = 0;
+    auto step = [&](uint64_t bytes){
+        done += bytes;
+        if (!progress(done)) {
+            throw OperationCancelled("The operation was aborted by the progress callback");
+        }
+    };
+
+    try {
+        std::vector<char> header;
+        for (const auto& source : sources) {
+            if (self.fileCallback()) {
+                self.fileCallback()(source.path);
+            }
+            header.clear();
+            tarnative::append_header(header, source.header);
+            tarnative::write_all(output.get(), header.data(), header.size());
+            if (source.header.type != '0') {
+                continue;
+            }
+            tarnative::Fd input(::open(source.path.c_str(), O_RDONLY | O_CLOEXEC));
+            if (!input) {
+                throw std::runtime_error("Cannot open the input file: " + source.path);
+            }
+            tarnative::copy_data(input.get(), output.get(), source.header.size, step);
+            header.clear();
+            tarnative::append_padding(header, source.header.size);
+            tarnative::write_all(output.get(), header.data(), header.size());
+        }
+        header.clear();
+        tarnative::append_end(header);
+        tarnative::write_all(output.get(), header.data(), header.size());
+        if (!output.close()) {
+            throw std::runtime_error("Cannot write the output file: " + outFile);
+        }
+    } catch (...) {
+        output.close();
+        std::filesystem::remove(outFile, ec);
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        throw;
+    }
+    return true;
+#endif
+}
+
+//Extracts an uncompressed tar archive without 7-Zip: the headers are parsed natively and the data is copied
+//by the kernel from the archive to the output files; the permissions and the modification times are restored
+//It returns false, writing nothing, when 7-Zip must do it: another format, links or special files, paths which do not
+//resolve under outDir, retainDirectories turned off, existing files with OverwriteMode.None, or Windows. The paths are resolved through safepath, so links
+//on disk are never followed; existing files follow the overwrite mode of the extractor
+//(A cancelled or failed extraction removes the files and directories it has created, and only those)
+inline bool extract_tar_native(const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& outDir,
+                               const CancelScope& scope){
+#ifdef _WIN32
+    return false;
+#else
+    if (!self.retainDirectories() || input_format(self, inArchive) != bit7z::BitFormat::Tar) {
+        return false;
+    }
+    tarnative::Fd archive(::open(inArchive.c_str(), O_RDONLY | O_CLOEXEC));
+    os::MappedFile file = os::map_file(inArchive);
+    if (!archive || !file.valid()) {
+        return false;
+    }
+    //Only the headers are read from the mapping
+    file.advise(os::Advice::Random);
+    std::vector<tarnative::Member> members;
+    if (!tarnative::scan(reinterpret_cast<const unsigned char*>(file.data()), file.size(), members) ||
+        !tarnative::extractable(members)) {
+        return false;
+    }
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& member : members) {
+        //7-Zip reports the existing files itself with OverwriteMode.None
+        if (self.overwriteMode() == bit7z::OverwriteMode::None && member.header.type == '0' &&
+            std::filesystem::exists(item_output_path(outDir, member.header.name), ec)) {
+            return false;
+        }
+        total += member.header.size;
+    }
+
+    safepath::Root root(outDir);
+    if (!root.valid()) {
+        throw std::runtime_error("Cannot open the output directory: " + outDir);
+    }
+    if (self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    uint64_t done = 0;
+    auto step = [&](uint64_t bytes){
+        done += bytes;
+        if (!progress(done)) {
+            throw OperationCancelled("The operation was aborted by the progress callback");
+        }
+    };
+    auto onMember = [&](const std::string& name){
+        if (self.fileCallback()) {
+            self.fileCallback()(name);
+        }
+    };
+    try {
+        tarnative::extract(archive.get(), members, root, existing_mode(self.overwriteMode()), onMember, step);
+    } catch (...) {
+        root.remove_created();
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        throw;
+    }
+    return true;
+#endif
+}
+
+//Extracts a zip archive whose large stored items (no compression, no encryption) are copied by the kernel
+//from their offset in the archive to the output files (copy_file_range, which may share the blocks on some file systems),
+//while another thread checks their CRC from the mapped archive; 7-Zip then extracts the other items as usual
+//The copies are resolved through safepath like the files of extract_async, and the progress runs over the whole
+//extraction: the total is reported once, and 7-Zip continues from the copied bytes
+//It returns false, writing nothing, when the archive is not a zip or has no such item, with retainDirectories
+//turned off, and on Windows
+//(A failed copy, or a cancellation at any point, removes the files the run created)
+inline bool extract_stored_copies(const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& outDir,
+                                  const CancelScope& scope){
+#ifdef _WIN32
+    return false;
+#else
+    //Smaller items are cheaper through the usual path
+    const uint64_t minCopy = 256u << 10;
+
+    if (!self.retainDirectories() || input_format(self, inArchive) != bit7z::BitFormat::Zip) {
+        return false;
+    }
+    os::MappedFile file = os::map_file(inArchive);
+    if (!file.valid()) {
+        return false;
+    }
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+    zipdir::Directory directory;
+    if (!zipdir::read_directory(data, file.size(), directory)) {
+        return false;
+    }
+    //The entries are matched to the items by name; a name found twice is left to 7-Zip
+    std::map<std::string, const zipdir::Entry*> entries;
+    for (const auto& entry : directory.entries) {
+        auto inserted = entries.emplace(entry.name, &entry);
+        if (!inserted.second) {
+            inserted.first->second = nullptr;
+        }
+    }
+
+    struct StoredCopy {
+        std::string name;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t crc;
+        uint32_t attributes;
+        std::chrono::system_clock::time_point mtime;
+    };
+    bit7z::BitArchiveReader reader(self.library(), inArchive, bit7z::BitFormat::Zip);
+    apply_settings(self, reader);
+    std::vector<StoredCopy> copies;
+    std::vector<uint32_t> decoded;
+    uint64_t total = 0;
+    std::vector<std::string> parts;
+    std::error_code ec;
+    for (const auto& item : reader) {
+        total += item.size();
+        auto it = entries.find(item.path());
+        const zipdir::Entry* entry = it != entries.end() ? it->second : nullptr;
+        uint64_t offset = 0;
+        bool stored = entry != nullptr && !item.isDir() && !item.isSymLink() && !item.isEncrypted() && item.size() >= minCopy &&
+                      entry->method == 0 && !entry->encrypted() && entry->compressed == entry->size && entry->size == item.size() &&
+                      zipdir::data_offset(data, file.size(), *entry, offset) && safepath::split(item.path(), parts);
+        //7-Zip reports the existing files itself
+        if (!stored || (self.overwriteMode() == bit7z::OverwriteMode::None &&
+                        std::filesystem::exists(item_output_path(outDir, item.path()), ec))) {
+            decoded.push_back(item.index());
+            continue;
+        }
+        copies.push_back({item.path(), offset, item.size(), entry->crc, item.attributes(), item.lastWriteTime()});
+    }
+    if (copies.empty()) {
+        return false;
+    }
+
+    tarnative::Fd archive(::open(inArchive.c_str(), O_RDONLY | O_CLOEXEC));
+    safepath::Root root(outDir);
+    if (!archive) {
+        throw std::runtime_error("Cannot open the archive: " + inArchive);
+    }
+    if (!root.valid()) {
+        throw std::runtime_error("Cannot open the output directory: " + outDir);
+    }
+    if (self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    reader.setTotalCallback(bit7z::TotalCallback());
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    uint64_t done = 0;
+    auto step = [&](uint64_t bytes){
+        done += bytes;
+        if (!progress(done)) {
+            throw OperationCancelled("The operation was aborted by the progress callback");
+        }
+    };
+    safepath::Existing existing = existing_mode(self.overwriteMode());
+    bool copying = true;
+    try {
+        for (const auto& copy : copies) {
+            if (self.fileCallback()) {
+                self.fileCallback()(copy.name);
+            }
+            uint32_t crc = 0;
+            std::thread check([&crc, data, &copy](){
+                crc = checksum::crc32(data + copy.offset, static_cast<size_t>(copy.size));
+            });
+            auto verify = [&](){
+                check.join();
+                if (crc != copy.crc) {
+                    throw std::runtime_error("CRC error in the item: " + copy.name);
+                }
+            };
+            //The Unix permissions are in the high 16 bits of the attributes, when 7-Zip finds them
+            uint32_t mode = (copy.attributes & 0x8000) != 0 ? (copy.attributes >> 16) & 0777 : 0;
+            int64_t mtime = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(copy.mtime.time_since_epoch()).count());
+            bool copied = false;
+            try {
+                copied = tarnative::copy_range(archive.get(), copy.offset, copy.size, root, copy.name, existing, mode, mtime, step, verify);
+            } catch (...) {
+                if (check.joinable()) {
+                    check.join();
+                }
+                throw;
+            }
+            if (!copied) {
+                check.join();
+                step(copy.size);
+            }
+        }
+        copying = false;
+        if (!decoded.empty()) {
+            extract_cancellable(self, reader, outDir, scope, &decoded, done);
+        }
+    } catch (...) {
+        //A failure of 7-Zip leaves its files and the copies, like an extraction by 7-Zip alone would
+        if (!copying && !scope.stopped()) {
+            throw;
+        }
+        root.remove_created();
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        throw;
+    }
+    return true;
+#endif
+}
+
+//Lists a zip or tar archive without the 7-Zip library: the zip central directory (with ZIP64) or the tar headers
+//are read from the mapped file, and each item gets the metadata 7-Zip reports for it
+//It returns false when the signature is neither zip nor tar, or the archive cannot be parsed, and 7-Zip lists it then
+inline bool list_native(const tstring& inArchive, std::vector<ArchiveItem>& items){
+    sniff::Detection detection = sniff::FormatCache::global().detect(inArchive);
+    //A zip after other data (self-extracting programs) is found through its central directory like 7-Zip does
+    if (detection.format != "ZIP" && (detection.embedded || detection.format != "TAR")) {
+        return false;
+    }
+    os::MappedFile file = os::map_file(inArchive);
+    if (!file.valid()) {
+        return false;
+    }
+    file.advise(os::Advice::Random);
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+    items.clear();
+
+    if (detection.format == "ZIP") {
+        zipdir::Directory directory;
+        if (!zipdir::read_directory(data, file.size(), directory)) {
+            return false;
+        }
+        items.reserve(directory.entries.size());
+        for (size_t i = 0; i < directory.entries.size(); ++i) {
+            const zipdir::Entry& entry = directory.entries[i];
+            ArchiveItem item;
+            item.index = static_cast<uint32_t>(i);
+            item.path = zipdir::item_path(entry);
+            item.isDir = zipdir::is_dir(entry);
+            item.attributes = zipdir::attributes(entry);
+            item.isSymLink = (item.attributes & 0x8000) != 0 && ((item.attributes >> 16) & 0170000) == 0120000;
+            item.isEncrypted = entry.encrypted();
+            item.size = entry.size;
+            item.packSize = entry.compressed;
+            item.crc = entry.crc;
+            item.mtime = static_cast<time_t>(zipdir::modified(entry));
+            items.push_back(std::move(item));
+        }
+        return true;
+    }
+
+    std::vector<tarnative::Member> members;
+    if (!tarnative::scan(data, file.size(), members)) {
+        return false;
+    }
+    items.reserve(members.size());
+    for (size_t i = 0; i < members.size(); ++i) {
+        const tarnative::Header& header = members[i].header;
+        ArchiveItem item;
+        item.index = static_cast<uint32_t>(i);
+        item.path = header.name;
+        while (!item.path.empty() && item.path.back() == '/') {
+            item.path.pop_back();
+        }
+        item.isDir = header.type == '5';
+        item.isSymLink = header.type == '2';
+        //7-Zip reports the length of the target as the size of a link, and the packed size in whole records
+        item.size = item.isSymLink ? header.link.size() : (item.isDir ? 0 : header.size);
+        item.packSize = tarnative::padded(members[i].stored);
+        //The Unix mode with its file type, like the attributes of the items of a zip made on Unix
+        uint32_t mode = header.mode;
+        if ((mode & 0170000) == 0) {
+            mode |= item.isDir ? 0040000 : (item.isSymLink ? 0120000 : 0100000);
+        }
+        item.attributes = (mode << 16) | 0x8000u | (item.isDir ? 0x10u : 0u);
+        item.mtime = static_cast<time_t>(header.mtime);
+        items.push_back(std::move(item));
+    }
+    return true;
+}
+
+//A readable and seekable view of one archive item, for reading parts of an item without extracting it
+//Stored zip items and tar files are read in place from the mapped archive. The other items are decoded by a background
+//thread into chunks kept in the shared BlockCache, so reading decoded data again (after a seek back) is a copy;
+//the thread runs readAhead chunks ahead of the reads and waits there, and it restarts from the beginning
+//of the item only when a read needs a chunk which was evicted (the decoders of 7-Zip cannot seek)
+//(A small solid archive is decoded whole on the first miss and all its items are cached,
+//since reading any item decodes its solid block up to the item anyway)
+class ArchiveFile {
+public:
+    ArchiveFile(const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& itemPath,
+                size_t chunkSize, size_t readAhead)
+        : mName(itemPath), mChunkSize(chunkSize == 0 ? 1 : chunkSize), mReadAhead(readAhead) {
+        uint64_t archiveSize = 0;
+        int64_t archiveTime = 0;
+        if (!stat_archive(inArchive, archiveSize, archiveTime)) {
+            throw std::runtime_error("Cannot open the archive: " + inArchive);
+        }
+        if (openInPlace(self, inArchive, itemPath)) {
+            return;
+        }
+        mReader.reset(new bit7z::BitArchiveReader(self.library(), inArchive, input_format(self, inArchive)));
+        apply_settings(self, *mReader);
+        mUserProgress = self.progressCallback();
+        mIndex = find_item_path(*mReader, itemPath);
+        auto item = mReader->itemAt(mIndex);
+        if (item.isDir()) {
+            throw std::invalid_argument("The item is a directory: " + itemPath);
+        }
+        mSize = item.size();
+        //Some formats (bzip2, some gzip files) do not tell the size, it is known once the decoder reaches the end
+        mSizeKnown = mSize != 0 || item.packSize() == 0;
+        std::error_code ec;
+        mKeyPrefix = std::filesystem::absolute(inArchive, ec).string() + '\0' + std::to_string(archiveSize) + ':' + std::to_string(archiveTime) + ':' +
+                     std::to_string(mChunkSize) + ':';
+    }
+
+    ~ArchiveFile() {
+        close();
+    }
+
+    ArchiveFile(const ArchiveFile&) = delete;
+    ArchiveFile& operator=(const ArchiveFile&) = delete;
+
+    const tstring& name() const {
+        return mName;
+    }
+
+    bool inPlace() const {
+        return mMapped.valid();
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        return mClosed;
+    }
+
+    uint64_t tell() const {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        return mPos;
+    }
+
+    //The bytes left after the current position, or the largest value when the size is not known yet
+    uint64_t remaining() const {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        if (!mSizeKnown) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return mPos < mSize ? mSize - mPos : 0;
+    }
+
+    uint64_t size() {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        checkOpen();
+        findSize();
+        return mSize;
+    }
+
+    //whence is 0 (from the beginning), 1 (from the current position) or 2 (from the end), like io.IOBase.seek
+    uint64_t seek(int64_t offset, int whence) {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        checkOpen();
+        int64_t base = 0;
+        if (whence == 1) {
+            base = static_cast<int64_t>(mPos);
+        } else if (whence == 2) {
+            findSize();
+            base = static_cast<int64_t>(mSize);
+        } else if (whence != 0) {
+            throw std::invalid_argument("Invalid whence: " + std::to_string(whence));
+        }
+        if (base + offset < 0) {
+            throw std::invalid_argument("Negative seek position");
+        }
+        mPos = static_cast<uint64_t>(base + offset);
+        return mPos;
+    }
+
+    //Copies up to n bytes from the current position; it returns 0 at the end of the item
+    size_t read(char* out, size_t n) {
+        std::lock_guard<std::mutex> lock(mReadMutex);
+        checkOpen();
+        if (mSizeKnown) {
+            n = static_cast<size_t>(std::min<uint64_t>(n, mPos < mSize ? mSize - mPos : 0));
+        }
+        if (mMapped.valid()) {
+            std::memcpy(out, mMapped.data() + mOffset + mPos, n);
+            mPos += n;
+            return n;
+        }
+        size_t copied = 0;
+        while (copied < n) {
+            uint64_t number = mPos / mChunkSize;
+            size_t within = static_cast<size_t>(mPos % mChunkSize);
+            BlockCache::Data data = chunk(number);
+            if (!data || data->size() <= within) {
+                break;
+            }
+            size_t len = std::min(n - copied, data->size() - within);
+            std::memcpy(out + copied, data->data() + within, len);
+            copied += len;
+            mPos += len;
+        }
+        return copied;
+    }
+
+    //Stops the decoding thread and unmaps the archive; reading afterwards raises
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mReadMutex);
+            mClosed = true;
+        }
+        stopDecoder();
+        mMapped.close();
+    }
+
+private:
+    //Finds a stored zip item or a tar file, whose data lies as is in the archive
+    bool openInPlace(const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& itemPath) {
+        const bit7z::BitInFormat& format = input_format(self, inArchive);
+        bool zip = format == bit7z::BitFormat::Zip;
+        if (!zip && format != bit7z::BitFormat::Tar) {
+            return false;
+        }
+        os::MappedFile file = os::map_file(inArchive);
+        if (!file.valid()) {
+            return false;
+        }
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        std::string path = slash_path(itemPath);
+        bool found = false;
+        if (zip) {
+            zipdir::Directory directory;
+            if (!zipdir::read_directory(data, file.size(), directory)) {
+                return false;
+            }
+            for (const auto& entry : directory.entries) {
+                if (zipdir::item_path(entry) != path) {
+                    continue;
+                }
+                //A name found twice, or an item which needs decoding, is left to 7-Zip
+                if (found || zipdir::is_dir(entry) || entry.method != 0 || entry.encrypted() || entry.compressed != entry.size ||
+                    !zipdir::data_offset(data, file.size(), entry, mOffset)) {
+                    return false;
+                }
+                mSize = entry.size;
+                found = true;
+            }
+        } else {
+            std::vector<tarnative::Member> members;
+            if (!tarnative::scan(data, file.size(), members)) {
+                return false;
+            }
+            for (const auto& member : members) {
+                std::string name = member.header.name;
+                while (!name.empty() && name.back() == '/') {
+                    name.pop_back();
+                }
+                if (name != path) {
+                    continue;
+                }
+                //A later member with the same path replaces the earlier one when tar extracts them
+                found = member.header.type == '0' && member.stored == member.header.size;
+                mOffset = member.offset;
+                mSize = member.header.size;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        file.advise(os::Advice::Random);
+        mMapped = std::move(file);
+        mSizeKnown = true;
+        return true;
+    }
+
+    void checkOpen() const {
+        if (mClosed) {
+            throw std::runtime_error("I/O operation on a closed archive file");
+        }
+    }
+
+    std::string chunkKey(uint32_t index, uint64_t number) const {
+        return mKeyPrefix + std::to_string(index) + ':' + std::to_string(number);
+    }
+
+    //Decodes up to the end when the size was not reported by the archive
+    void findSize() {
+        if (mSizeKnown) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!mRunning || mStopping) {
+            lock.unlock();
+            startDecoder();
+            lock.lock();
+        }
+        mTarget = std::numeric_limits<uint64_t>::max();
+        mCondition.notify_all();
+        mCondition.wait(lock, [this](){ return mDone; });
+        rethrowLocked();
+        mSize = mDecodedBytes;
+        mSizeKnown = true;
+    }
+
+    //The decoded data of a chunk of the item, or null after the end of the item
+    BlockCache::Data chunk(uint64_t number) {
+        BlockCache& cache = BlockCache::global();
+        BlockCache::Data data = cache.get(chunkKey(mIndex, number));
+        if (!data && !mSolidTried) {
+            mSolidTried = true;
+            if (decodeSolid()) {
+                data = cache.get(chunkKey(mIndex, number));
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!data && number < mProduced) {
+            //The running decoder may have delivered the chunk since the lookup above (it is cached under mMutex)
+            data = cache.get(chunkKey(mIndex, number));
+        }
+        if (data) {
+            //Sequential reads through cached chunks keep the running decoder ahead of them
+            if (mRunning && !mStopping && number + mReadAhead > mTarget) {
+                mTarget = number + mReadAhead;
+                mCondition.notify_all();
+            }
+            return data;
+        }
+        if (mSizeKnown && number * mChunkSize >= mSize) {
+            return nullptr;
+        }
+        //The decoder cannot go back: a chunk behind it was evicted, and the item is decoded again from its beginning
+        if (!mRunning || mStopping || number < mProduced) {
+            lock.unlock();
+            startDecoder();
+            lock.lock();
+        }
+        mWanted = number;
+        mWantedData = nullptr;
+        mTarget = std::max(mTarget, number + mReadAhead);
+        mCondition.notify_all();
+        mCondition.wait(lock, [this](){ return mWantedData != nullptr || mDone; });
+        data = std::move(mWantedData);
+        mWanted = std::numeric_limits<uint64_t>::max();
+        if (!data) {
+            rethrowLocked();
+        }
+        return data;
+    }
+
+    //Decodes a small solid archive in one pass into the cache
+    bool decodeSolid() {
+        if (!mReader->isSolid()) {
+            return false;
+        }
+        stopDecoder();
+        uint64_t total = 0;
+        std::map<tstring, uint32_t> indices;
+        for (const auto& item : *mReader) {
+            total += item.size();
+            if (!item.isDir()) {
+                auto inserted = indices.emplace(item.path(), item.index());
+                if (!inserted.second) {
+                    inserted.first->second = std::numeric_limits<uint32_t>::max();
+                }
+            }
+        }
+        BlockCache& cache = BlockCache::global();
+        if (total > cache.capacity() / 4) {
+            return false;
+        }
+        std::map<tstring, std::vector<bit7z::byte_t>> decoded;
+        mReader->setProgressCallback(mUserProgress);
+        mReader->extractTo(decoded);
+        for (const auto& entry : decoded) {
+            auto it = indices.find(entry.first);
+            if (it == indices.end() || it->second == std::numeric_limits<uint32_t>::max()) {
+                continue;
+            }
+            const char* bytes = reinterpret_cast<const char*>(entry.second.data());
+            for (size_t offset = 0, number = 0; offset < entry.second.size(); offset += mChunkSize, ++number) {
+                size_t len = std::min(mChunkSize, entry.second.size() - offset);
+                cache.put(chunkKey(it->second, number), std::make_shared<const std::vector<char>>(bytes + offset, bytes + offset + len));
+            }
+        }
+        return true;
+    }
+
+    void startDecoder() {
+        stopDecoder();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = true;
+        mStopping = false;
+        mDone = false;
+        mError = nullptr;
+        mProduced = 0;
+        mDecodedBytes = 0;
+        mTarget = mReadAhead;
+        mThread = std::thread([this](){
+            decode();
+        });
+    }
+
+    void stopDecoder() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mThread.joinable()) {
+                return;
+            }
+            mStopping = true;
+        }
+        mCondition.notify_all();
+        mThread.join();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+
+    void rethrowLocked() {
+        if (mError) {
+            std::exception_ptr error = mError;
+            mError = nullptr;
+            mRunning = false;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void decode() {
+        bit7z::ProgressCallback user = mUserProgress;
+        mReader->setProgressCallback([this, user](uint64_t processed){
+            if (mStopping) {
+                return false;
+            }
+            return user ? user(processed) : true;
+        });
+        try {
+            bool failed = false;
+            //A flush of the stream in the middle of the item hands over a short piece, which is joined with the next ones,
+            //so that every chunk but the last has the chunk size
+            std::vector<char> pending;
+            {
+                //The last partial piece is flushed by the destructor, and dropped when the decoding failed
+                ChunkStreamBuf<> buffer(mChunkSize, [this, &failed, &pending](std::vector<char>&& data){
+                    if (failed) {
+                        return;
+                    }
+                    if (pending.empty() && data.size() == mChunkSize) {
+                        deliver(std::move(data));
+                        return;
+                    }
+                    pending.insert(pending.end(), data.begin(), data.end());
+                    if (pending.size() >= mChunkSize) {
+                        std::vector<char> rest(pending.begin() + static_cast<std::ptrdiff_t>(mChunkSize), pending.end());
+                        pending.resize(mChunkSize);
+                        deliver(std::move(pending));
+                        pending = std::move(rest);
+                    }
+                });
+                std::ostream out(&buffer);
+                try {
+                    mReader->extractTo(out, mIndex);
+                    out.flush();
+                } catch (...) {
+                    failed = true;
+                    throw;
+                }
+            }
+            if (!pending.empty()) {
+                deliver(std::move(pending));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mStopping) {
+                mError = std::current_exception();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDone = true;
+            mRunning = mError == nullptr && !mStopping;
+        }
+        mCondition.notify_all();
+    }
+
+    //Puts a decoded chunk into the cache, then waits while the decoder is readAhead chunks ahead of the reads
+    void deliver(std::vector<char>&& bytes) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mStopping) {
+            return;
+        }
+        uint64_t number = mProduced++;
+        mDecodedBytes += bytes.size();
+        BlockCache::Data data = std::make_shared<const std::vector<char>>(std::move(bytes));
+        if (number == mWanted) {
+            mWantedData = data;
+        }
+        //Cached before the lock is released, so a chunk counted in mProduced and missing from the cache was evicted
+        BlockCache::global().put(chunkKey(mIndex, number), data);
+        lock.unlock();
+        mCondition.notify_all();
+        lock.lock();
+        mCondition.wait(lock, [this, number](){ return mStopping || number < mTarget; });
+    }
+
+    tstring mName;
+    size_t mChunkSize;
+    size_t mReadAhead;
+    uint64_t mSize = 0;
+    bool mSizeKnown = true;
+
+    //Guards the position and the reads of the handle
+    mutable std::mutex mReadMutex;
+    uint64_t mPos = 0;
+    bool mClosed = false;
+
+    //The item in place in the mapped archive
+    os::MappedFile mMapped;
+    uint64_t mOffset = 0;
+
+    //The item decoded by 7-Zip
+    std::unique_ptr<bit7z::BitArchiveReader> mReader;
+    bit7z::ProgressCallback mUserProgress;
+    uint32_t mIndex = 0;
+    std::string mKeyPrefix;
+    bool mSolidTried = false;
+
+    //The state of the decoding thread
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mThread;
+    bool mRunning = false;
+    std::atomic<bool> mStopping{false};
+    bool mDone = false;
+    std::exception_ptr mError;
+    uint64_t mProduced = 0;      //The chunks delivered by the current run
+    uint64_t mDecodedBytes = 0;
+    uint64_t mTarget = 0;        //The decoder waits after delivering this chunk
+    uint64_t mWanted = std::numeric_limits<uint64_t>::max();
+    BlockCache::Data mWantedData;
+};
+
+//The decoded items of a transcoding, handed from the decoding thread to the encoder
+//The encoder asks for an item when it starts reading it; the decoder decodes the oldest request, and otherwise guesses
+//that the item after the last request comes next (7-Zip does not always read the items in the order they were added).
+//The queued chunks of all the items share one byte budget. The data of a guessed item which nobody asked for yet
+//is dropped when the budget is needed, and the item is decoded again once asked for, so a wrong guess never blocks the encoder
+//(The chunks are byte vectors like the ones bit7z decodes into memory, so those are queued without a copy)
+class TranscodePipe {
+public:
+    using Chunk = std::vector<bit7z::byte_t>;
+
+    TranscodePipe(size_t items, size_t maxBytes)
+        : mItems(items), mMaxBytes(std::max<size_t>(maxBytes, 1)) {}
+
+    //The next chunk of an item for the encoder, false at the end of the item or once the pipe is cancelled
+    bool read(size_t item, Chunk& chunk) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        if (!state.requested) {
+            state.requested = true;
+            mRequests.push_back(item);
+            mGuess = item + 1;
+            mGuessing = true;
+            mCondition.notify_all();
+        }
+        mCondition.wait(lock, [&](){ return mCancelled || !state.chunks.empty() || state.stage == Stage::Done; });
+        if (state.chunks.empty()) {
+            return false;
+        }
+        chunk = std::move(state.chunks.front());
+        state.chunks.pop_front();
+        state.taken += chunk.size();
+        mQueued -= chunk.size();
+        mCondition.notify_all();
+        return true;
+    }
+
+    //The next item to decode; it waits for a request when there is nothing to guess, and returns false once cancelled
+    bool next(size_t& item) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mCancelled) {
+            while (!mRequests.empty()) {
+                size_t requested = mRequests.front();
+                mRequests.pop_front();
+                if (mItems[requested].stage == Stage::Waiting) {
+                    item = start(requested);
+                    return true;
+                }
+            }
+            //Guess only while the pipe has room, so that the requested items are not held back by the guesses
+            while (mGuess < mItems.size() && mItems[mGuess].stage != Stage::Waiting) {
+                ++mGuess;
+            }
+            if (mGuessing && mGuess < mItems.size() && mQueued < mMaxBytes / 2) {
+                item = start(mGuess);
+                return true;
+            }
+            mCondition.wait(lock);
+        }
+        return false;
+    }
+
+    //Queues a decoded chunk; false when the item must be given up: the pipe is cancelled, or it is full and the item is only a guess
+    bool write(size_t item, Chunk&& chunk) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        if (state.restarting) {
+            return false;
+        }
+        //An item decoded again skips what the encoder has already read
+        if (state.skip > 0) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(state.skip, chunk.size()));
+            chunk.erase(chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(len));
+            state.skip -= len;
+            if (chunk.empty()) {
+                return !mCancelled;
+            }
+        }
+        while (true) {
+            if (mCancelled || state.restarting) {
+                return false;
+            }
+            //A guess gives way as soon as the encoder waits for another item
+            if (!state.requested && waitingRequest()) {
+                return false;
+            }
+            if (mQueued == 0 || mQueued + chunk.size() <= mMaxBytes) {
+                break;
+            }
+            if (!state.requested) {
+                return false;
+            }
+            if (!dropGuesses(item)) {
+                mCondition.wait(lock);
+            }
+        }
+        mQueued += chunk.size();
+        state.chunks.push_back(std::move(chunk));
+        mCondition.notify_all();
+        return true;
+    }
+
+    //Queues a whole item decoded in advance, even beyond the budget since it is already in memory
+    void preload(size_t item, Chunk&& data) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        if (!data.empty()) {
+            mQueued += data.size();
+            state.chunks.push_back(std::move(data));
+        }
+        state.stage = Stage::Done;
+        mCondition.notify_all();
+    }
+
+    void end(size_t item) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        if (state.restarting) {
+            requeue(state, item);
+        } else {
+            state.stage = Stage::Done;
+        }
+        mCondition.notify_all();
+    }
+
+    //Gives up the decoding of an item: its queued data is dropped and it is decoded again when asked for
+    //(No more guesses are made until the next request, otherwise the same guess would be decoded and dropped again)
+    void abort(size_t item) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        if (state.requested) {
+            requeue(state, item);
+        } else {
+            drop(state);
+            state.stage = Stage::Waiting;
+            mGuessing = false;
+        }
+        mCondition.notify_all();
+    }
+
+    //Makes the encoder read an item again from its beginning: the item is decoded again instead of keeping its data
+    //(A decoding still running is given up at its next chunk)
+    void restart(size_t item) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Item& state = mItems[item];
+        drop(state);
+        state.taken = 0;
+        state.requested = true;
+        if (state.stage == Stage::Decoding) {
+            state.restarting = true;
+        } else {
+            requeue(state, item);
+        }
+        mCondition.notify_all();
+    }
+
+    //Wakes both sides: the encoder sees the end of its items and the decoder stops
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCancelled = true;
+        mCondition.notify_all();
+    }
+
+    bool cancelled() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCancelled;
+    }
+
+private:
+    enum class Stage { Waiting, Decoding, Done };
+
+    struct Item {
+        Stage stage = Stage::Waiting;
+        bool requested = false;
+        bool restarting = false;    //The encoder restarted the item while it was decoded
+        std::deque<Chunk> chunks;
+        uint64_t taken = 0;     //The bytes read by the encoder
+        uint64_t skip = 0;      //The bytes the current decoding must skip
+    };
+
+    size_t start(size_t item) {
+        Item& state = mItems[item];
+        state.stage = Stage::Decoding;
+        state.skip = state.taken;
+        return item;
+    }
+
+    //Puts a requested item first in the requests, to be decoded again from its beginning
+    void requeue(Item& state, size_t item) {
+        drop(state);
+        state.stage = Stage::Waiting;
+        state.restarting = false;
+        mRequests.push_front(item);
+    }
+
+    void drop(Item& state) {
+        for (const auto& chunk : state.chunks) {
+            mQueued -= chunk.size();
+        }
+        state.chunks.clear();
+    }
+
+    bool waitingRequest() const {
+        for (size_t item : mRequests) {
+            if (mItems[item].stage == Stage::Waiting) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Drops the decoded guesses which were not asked for; false when there were none
+    bool dropGuesses(size_t except) {
+        bool dropped = false;
+        for (size_t i = 0; i < mItems.size(); ++i) {
+            Item& state = mItems[i];
+            if (i != except && !state.requested && state.stage == Stage::Done && !state.chunks.empty()) {
+                drop(state);
+                state.stage = Stage::Waiting;
+                dropped = true;
+            }
+        }
+        return dropped;
+    }
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<Item> mItems;
+    std::deque<size_t> mRequests;
+    size_t mMaxBytes;
+    size_t mQueued = 0;
+    size_t mGuess = 0;
+    bool mGuessing = true;
+    bool mCancelled = false;
+};
+
+//The input stream of one item of a TranscodePipe, given to the encoder
+//Seeking to the end reports the size of the item without reading it (7-Zip asks for it before reading the data).
+//With rewind, the item can be read again from any earlier position: the pipe decodes it again and the data before
+//the position is skipped, so the data read is not kept (the zip encoder reads an item again to store it when
+//compressing it made it larger)
+class PipeStreamBuf : public std::streambuf {
+public:
+    PipeStreamBuf(TranscodePipe& pipe, size_t item, uint64_t size, bool rewind)
+        : mPipe(pipe), mItem(item), mSize(size), mRewind(rewind) {}
+
+protected:
+    int_type underflow() override {
+        if (mAtEnd) {
+            return traits_type::eof();
+        }
+        if (gptr() < egptr() || fetch()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        return traits_type::eof();
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        off_type base = 0;
+        if (dir == std::ios_base::cur) {
+            base = static_cast<off_type>(position());
+        } else if (dir == std::ios_base::end) {
+            base = static_cast<off_type>(mSize);
+        }
+        off_type target = base + off;
+        off_type current = static_cast<off_type>(mBase) + (gptr() - eback());
+        if (target == current) {
+            mAtEnd = false;
+            return pos_type(target);
+        }
+        if (target == static_cast<off_type>(mSize)) {
+            mAtEnd = true;
+            return pos_type(target);
+        }
+        if (!mRewind || target < 0 || target > current) {
+            return pos_type(off_type(-1));
+        }
+        mPipe.restart(mItem);
+        mChunk.clear();
+        setg(nullptr, nullptr, nullptr);
+        mBase = 0;
+        mAtEnd = false;
+        uint64_t position = static_cast<uint64_t>(target);
+        while (mBase + static_cast<uint64_t>(egptr() - eback()) <= position) {
+            if (!fetch()) {
+                return pos_type(off_type(-1));
+            }
+        }
+        setg(eback(), eback() + (position - mBase), egptr());
+        return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    uint64_t position() const {
+        return mAtEnd ? mSize : mBase + static_cast<uint64_t>(gptr() - eback());
+    }
+
+    //Moves to the next chunk of the item, false at its end
+    bool fetch() {
+        mBase += static_cast<uint64_t>(egptr() - eback());
+        if (!mPipe.read(mItem, mChunk)) {
+            setg(nullptr, nullptr, nullptr);
+            return false;
+        }
+        char* data = reinterpret_cast<char*>(mChunk.data());
+        setg(data, data, data + mChunk.size());
+        return true;
+    }
+
+    TranscodePipe& mPipe;
+    size_t mItem;
+    uint64_t mSize;
+    bool mRewind;
+    bool mAtEnd = false;
+    uint64_t mBase = 0;              //The position of the current chunk in the item
+    TranscodePipe::Chunk mChunk;
+};
+
+//The result of a transcoding
+struct TranscodeReport {
+    uint64_t items = 0;              //The items written to the output
+    uint64_t bytes = 0;              //Their decoded bytes
+    bool metadata = false;           //Whether the modification times and the attributes were kept (tar and zip outputs)
+    std::vector<tstring> skipped;    //The items the output format cannot take
+};
+
+//One item of the input which goes through the pipe
+struct TranscodeItem {
+    ArchiveItem info;
+    uint64_t filetime = 0;           //The modification time as a Windows FILETIME (100 ns since 1601)
+};
+
+//Decodes the items of the pipe on the calling thread until the pipe is cancelled
+//(A small solid archive is decoded in one pass first: decoding its items one by one would decode the block again for each of them.
+//bit7z hands the items of a pass over only at its end, so the encoder waits for the whole pass; the pass stops past
+//maxSolidBytes of decoded data, since the sizes in the headers may lie, and the items are then decoded one by one)
+inline void decode_transcode_items(bit7z::BitArchiveReader& reader, TranscodePipe& pipe, const std::vector<TranscodeItem>& items,
+                                   bool whole, uint64_t maxSolidBytes, const CancelScope& scope){
+    if (whole) {
+        bool exceeded = false;
+        bit7z::ProgressCallback stop = scope.wrap(nullptr);
+        reader.setProgressCallback([&pipe, &exceeded, stop, maxSolidBytes](uint64_t processed){
+            if (processed > maxSolidBytes) {
+                exceeded = true;
+            }
+            return !exceeded && !pipe.cancelled() && stop(processed);
+        });
+        std::map<tstring, std::vector<bit7z::byte_t>> decoded;
+        try {
+            reader.extractTo(decoded);
+        } catch (...) {
+            if (!exceeded) {
+                throw;
+            }
+            decoded.clear();
+        }
+        if (!exceeded) {
+            for (size_t k = 0; k < items.size(); ++k) {
+                auto it = decoded.find(items[k].info.path);
+                TranscodePipe::Chunk data;
+                if (it != decoded.end()) {
+                    data = std::move(it->second);
+                    decoded.erase(it);
+                }
+                pipe.preload(k, std::move(data));
+            }
+        }
+    }
+    //The items are decoded one by one when asked for: the ones read again from their beginning, or all of them
+    std::atomic<bool> gaveUp{false};
+    reader.setProgressCallback([&gaveUp, &scope](uint64_t){
+        return !gaveUp && !scope.stopped();
+    });
+    size_t k;
+    while (pipe.next(k)) {
+        gaveUp = false;
+        {
+            ChunkStreamBuf<bit7z::byte_t> buffer(1024 * 1024, [&pipe, &gaveUp, k](TranscodePipe::Chunk&& data){
+                if (!gaveUp && !pipe.write(k, std::move(data))) {
+                    gaveUp = true;
+                }
+            });
+            std::ostream out(&buffer);
+            try {
+                reader.extractTo(out, items[k].info.index);
+                out.flush();
+            } catch (...) {
+                //Stopping the decoding of a given up item makes bit7z raise
+                if (!gaveUp) {
+                    throw;
+                }
+            }
+        }
+        if (gaveUp) {
+            pipe.abort(k);
+        } else {
+            pipe.end(k);
+        }
+    }
+}
+
+//Writes the modification times and the attributes of the input items into a zip written by 7-Zip
+//(7-Zip gives the items added from streams the current time and the default attributes;
+//items with the same path are matched in the order they were added)
+inline void patch_zip_metadata(const tstring& outFile, const std::vector<TranscodeItem>& items){
+    std::map<std::string, std::deque<const TranscodeItem*>> byPath;
+    for (const auto& item : items) {
+        byPath[slash_path(item.info.path)].push_back(&item);
+    }
+    std::vector<zipdir::Patch> patches;
+    {
+        os::MappedFile file = os::map_file(outFile);
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        zipdir::Directory directory;
+        if (!file.valid() || !zipdir::read_directory(data, file.size(), directory)) {
+            throw std::runtime_error("Cannot read the written archive: " + outFile);
+        }
+        for (const auto& entry : directory.entries) {
+            auto it = byPath.find(zipdir::item_path(entry));
+            if (it == byPath.end() || it->second.empty()) {
+                continue;
+            }
+            const TranscodeItem& item = *it->second.front();
+            it->second.pop_front();
+            if (!zipdir::metadata_patches(data, file.size(), entry, static_cast<int64_t>(item.info.mtime), item.filetime,
+                                          item.info.attributes, patches)) {
+                throw std::runtime_error("Cannot read the written archive: " + outFile);
+            }
+        }
+    }
+    std::fstream file(outFile, std::ios::in | std::ios::out | std::ios::binary);
+    for (const auto& patch : patches) {
+        file.seekp(static_cast<std::streamoff>(patch.offset));
+        file.write(reinterpret_cast<const char*>(patch.bytes.data()), static_cast<std::streamsize>(patch.bytes.size()));
+    }
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Cannot write the output file: " + outFile);
+    }
+}
+
+//Writes the items of the pipe as an uncompressed tar archive, with their times, permissions, directories and symbolic links
+inline void write_transcode_tar(const bit7z::BitFileCompressor& self, TranscodePipe& pipe, const std::vector<TranscodeItem>& entries,
+                                const std::vector<size_t>& streamed, const tstring& outFile, const CancelScope& scope,
+                                TranscodeReport& report){
+    std::ofstream out(outFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot open the output file: " + outFile);
+    }
+    uint64_t total = 0;
+    for (const auto& entry : entries) {
+        total += entry.info.isDir ? 0 : entry.info.size;
+    }
+    if (self.totalCallback()) {
+        self.totalCallback()(total);
+    }
+    bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+    uint64_t done = 0;
+    std::vector<char> header;
+    auto put = [&](const char* data, size_t size){
+        out.write(data, static_cast<std::streamsize>(size));
+        if (!out) {
+            throw std::runtime_error("Cannot write the output file: " + outFile);
+        }
+    };
+    for (size_t i = 0, k = 0; i < entries.size(); ++i) {
+        const ArchiveItem& info = entries[i].info;
+        if (self.fileCallback()) {
+            self.fileCallback()(info.path);
+        }
+        tarnative::Header fields;
+        fields.name = slash_path(info.path) + (info.isDir ? "/" : "");
+        fields.type = info.isDir ? '5' : info.isSymLink ? '2' : '0';
+        fields.mtime = static_cast<int64_t>(info.mtime);
+        fields.mode = (info.attributes & 0x8000u) != 0 ? (info.attributes >> 16) & 07777 : (info.isDir ? 0755 : 0644);
+        header.clear();
+        if (info.isDir) {
+            tarnative::append_header(header, fields);
+            put(header.data(), header.size());
+            report.items++;
+            continue;
+        }
+        size_t item = streamed[k++];
+        TranscodePipe::Chunk chunk;
+        //The link target and the data of an item of unknown size are collected before the header is written
+        bool known = !info.isSymLink && (info.size != 0 || info.packSize == 0);
+        TranscodePipe::Chunk collected;
+        if (!known) {
+            while (pipe.read(item, chunk)) {
+                collected.insert(collected.end(), chunk.begin(), chunk.end());
+            }
+        }
+        if (info.isSymLink) {
+            fields.link.assign(collected.begin(), collected.end());
+        } else {
+            fields.size = known ? info.size : collected.size();
+        }
+        tarnative::append_header(header, fields);
+        put(header.data(), header.size());
+        uint64_t written = 0;
+        auto step = [&](const bit7z::byte_t* bytes, size_t size){
+            const char* data = reinterpret_cast<const char*>(bytes);
+            if (written + size > fields.size) {
+                throw std::runtime_error("The size of the item changed: " + info.path);
+            }
+            put(data, size);
+            written += size;
+            done += size;
+            if (!progress(done)) {
+                throw OperationCancelled("The operation was aborted by the progress callback");
+            }
+        };
+        if (!known) {
+            step(collected.data(), info.isSymLink ? 0 : collected.size());
+        } else {
+            while (pipe.read(item, chunk)) {
+                step(chunk.data(), chunk.size());
+            }
+        }
+        if (written != fields.size) {
+            throw std::runtime_error(pipe.cancelled() ? "The decoding stopped" : "The size of the item changed: " + info.path);
+        }
+        header.clear();
+        tarnative::append_padding(header, fields.size);
+        put(header.data(), header.size());
+        report.items++;
+        report.bytes += written;
+    }
+    header.clear();
+    tarnative::append_end(header);
+    put(header.data(), header.size());
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Cannot write the output file: " + outFile);
+    }
+}
+
+//Converts an archive into a new archive of the format of the compressor without extracting it to disk
+//A decoding thread extracts the items into a TranscodePipe (at most maxPipeBytes of decoded data are queued)
+//while the calling thread encodes them from it, so the decoding and the encoding run at the same time.
+//Tar outputs are written natively with the times, the permissions, the directories and the symbolic links;
+//zip outputs get the times and the attributes written into their headers after 7-Zip has written them;
+//other formats only keep the data and the paths (bit7z cannot give 7-Zip the metadata of an item added from a stream),
+//and their directories and symbolic links are skipped. Losing the metadata or the skipped items is refused
+//with std::invalid_argument, before the output is written, unless dropMetadata is set.
+//A solid input whose decoded size is at most maxSolidBytes is decoded in one pass into memory; a larger one is decoded
+//item by item, which decodes each solid block again for every item in it.
+//A failed or cancelled transcoding removes the output file
+inline TranscodeReport transcode_archive(const bit7z::BitFileCompressor& self, const bit7z::BitFileExtractor& extractor,
+                                         const tstring& inArchive, const tstring& outFile, size_t maxPipeBytes,
+                                         uint64_t maxSolidBytes, bool dropMetadata, const CancelScope& scope){
+    TranscodeReport report;
+    const bit7z::BitInOutFormat& format = self.compressionFormat();
+    bool tar = format == bit7z::BitFormat::Tar;
+    bool zip = format == bit7z::BitFormat::Zip;
+    report.metadata = tar || zip;
+    if (!report.metadata && !dropMetadata) {
+        throw std::invalid_argument("The output format cannot keep the times and the attributes of the items (set dropMetadata to convert anyway)");
+    }
+
+    std::error_code ec;
+    if (std::filesystem::exists(outFile, ec)) {
+        if (self.overwriteMode() == bit7z::OverwriteMode::Skip) {
+            return report;
+        }
+        if (self.overwriteMode() == bit7z::OverwriteMode::None) {
+            throw std::runtime_error("The output file already exists: " + outFile);
+        }
+    }
+
+    bit7z::BitArchiveReader reader(extractor.library(), inArchive, input_format(extractor, inArchive));
+    apply_settings(extractor, reader);
+    //The file callbacks report the items written to the output
+    reader.setFileCallback(nullptr);
+    reader.setTotalCallback(nullptr);
+
+    //entries: the items written to the output in their order; streamed: the pipe item of each written file or link
+    std::vector<TranscodeItem> entries;
+    std::vector<TranscodeItem> items;
+    std::vector<size_t> streamed;
+    std::set<tstring> paths;
+    bool unique = true;
+    uint64_t total = 0;
+    for (const auto& item : reader) {
+        TranscodeItem entry;
+        entry.info = to_archive_item(item);
+        auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(item.lastWriteTime().time_since_epoch()).count();
+        entry.filetime = static_cast<uint64_t>(since / 100 + 116444736000000000LL);
+        if (!tar && (entry.info.isDir || entry.info.isSymLink) && !(zip && entry.info.isSymLink)) {
+            report.skipped.push_back(entry.info.path);
+            continue;
+        }
+        if (!entry.info.isDir) {
+            unique = paths.insert(entry.info.path).second && unique;
+            total += entry.info.size;
+            streamed.push_back(items.size());
+            items.push_back(entry);
+        }
+        entries.push_back(std::move(entry));
+    }
+    if (!report.skipped.empty() && !dropMetadata) {
+        throw std::invalid_argument("The output format cannot take the item " + report.skipped.front() +
+                                    " (set dropMetadata to convert without it)");
+    }
+    //7-Zip reads the items of a 7z archive sorted by path, so the pipe guesses right when they are added in that order
+    if (format == bit7z::BitFormat::SevenZip) {
+        std::stable_sort(items.begin(), items.end(), [](const TranscodeItem& a, const TranscodeItem& b){
+            return a.info.path < b.info.path;
+        });
+    }
+    bool whole = reader.isSolid() && unique && total <= maxSolidBytes;
+
+    TranscodePipe pipe(items.size(), maxPipeBytes);
+    //7-Zip takes an item reported as empty for an empty file, so the items whose size the input does not tell
+    //(gzip, bzip2 and the like) are decoded first: into memory while they fit in maxPipeBytes together,
+    //otherwise only to count their size, and the pipe decodes them again when they are read
+    if (!tar && !whole) {
+        reader.setProgressCallback(scope.wrap(nullptr));
+        uint64_t room = maxPipeBytes;
+        for (size_t k = 0; k < items.size(); ++k) {
+            ArchiveItem& info = items[k].info;
+            if (info.size != 0 || info.packSize == 0) {
+                continue;
+            }
+            TranscodePipe::Chunk data;
+            try {
+                bool fits;
+                {
+                    LimitedStreamBuf<bit7z::byte_t> buffer(data, room);
+                    std::ostream out(&buffer);
+                    try {
+                        reader.extractTo(out, info.index);
+                    } catch (...) {
+                        if (!buffer.exceeded()) {
+                            throw;
+                        }
+                    }
+                    fits = !buffer.exceeded();
+                }
+                if (fits) {
+                    info.size = data.size();
+                    room -= data.size();
+                    pipe.preload(k, std::move(data));
+                    continue;
+                }
+                data = TranscodePipe::Chunk();
+                CountingStreamBuf counter;
+                std::ostream out(&counter);
+                reader.extractTo(out, info.index);
+                info.size = counter.count();
+            } catch (...) {
+                if (scope.stopped()) {
+                    scope.raise();
+                }
+                throw;
+            }
+        }
+    }
+    std::exception_ptr decodeError;
+    std::thread decoder([&](){
+        try {
+            decode_transcode_items(reader, pipe, items, whole, maxSolidBytes, scope);
+        } catch (...) {
+            decodeError = std::current_exception();
+            pipe.cancel();
+        }
+    });
+    auto stopDecoder = [&](){
+        pipe.cancel();
+        if (decoder.joinable()) {
+            decoder.join();
+        }
+    };
+
+    try {
+        if (tar) {
+            write_transcode_tar(self, pipe, entries, streamed, outFile, scope, report);
+        } else {
+            bit7z::BitArchiveWriter writer(self.library(), format);
+            apply_settings(self, writer);
+            writer.setProgressCallback(scope.wrap(self.progressCallback()));
+            std::vector<std::unique_ptr<PipeStreamBuf>> buffers;
+            std::vector<std::unique_ptr<std::istream>> streams;
+            for (size_t k = 0; k < items.size(); ++k) {
+                buffers.emplace_back(new PipeStreamBuf(pipe, k, items[k].info.size, zip));
+                streams.emplace_back(new std::istream(buffers.back().get()));
+                writer.addFile(*streams.back(), items[k].info.path);
+                report.bytes += items[k].info.size;
+            }
+            writer.compressTo(outFile);
+            report.items = items.size();
+        }
+        stopDecoder();
+        //An item cut short by a failed decoding still makes a valid output, so the error of the decoder decides
+        if (decodeError) {
+            std::rethrow_exception(decodeError);
+        }
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        if (zip) {
+            patch_zip_metadata(outFile, items);
+        }
+    } catch (...) {
+        stopDecoder();
+        std::filesystem::remove(outFile, ec);
+        if (scope.stopped()) {
+            scope.raise();
+        }
+        if (decodeError) {
+            std::rethrow_exception(decodeError);
+        }
+        throw;
+    }
+    return report;
+}
+
+//Chains a file callback which reports the position of the compressor to a prefetcher
+//(The callback of the user is still called, and it is restored when the guard is destroyed)
+class PrefetchGuard {
+public:
+    //The compressor must be used exclusively by the caller
+    PrefetchGuard(bit7z::BitFileCompressor& compressor, FilePrefetcher& prefetcher)
+        : mCompressor(compressor), mUserCallback(compressor.fileCallback()) {
+        bit7z::FileCallback user = mUserCallback;
+        SettingsWrite write(&compressor, false);
+        compressor.setFileCallback([&prefetcher, user](tstring name){
+            prefetcher.consumed(name);
+            if (user) {
+                user(name);
+            }
+        });
+    }
+
+    ~PrefetchGuard() {
+        SettingsWrite write(&mCompressor, false);
+        mCompressor.setFileCallback(mUserCallback);
+    }
+
+    PrefetchGuard(const PrefetchGuard&) = delete;
+    PrefetchGuard& operator=(const PrefetchGuard&) = delete;
+
+private:
+    bit7z::BitFileCompressor& mCompressor;
+    bit7z::FileCallback mUserCallback;
+};
+
+#endif
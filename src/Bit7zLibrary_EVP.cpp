@@ -17,7 +17,8 @@ void init_lib(py::module_& mod){
     mod.attr("DEFAULT_7ZIP_DLL") = py::cast(bit7z::kDefaultLibrary);
 
     //Bind the Bit7zLibrary class
-    py::class_<bit7z::Bit7zLibrary>(mod, "Bit7zLibrary")
+    py::class_<bit7z::Bit7zLibrary>(mod, "Bit7zLibrary",
+        "The loaded 7-zip shared library. It can be shared by any number of threads; call set_large_page_mode() before using it from several threads.")
         .def(py::init<const std::string&>(), "Constructs a Bit7zLibrary object by loading the specified 7zip shared library. By default, it searches a 7z.dll in the same path of the application. Args: libraryPath(str): the path to the shared library file to be loaded.")
         .def("set_large_page_mode", &bit7z::Bit7zLibrary::setLargePageMode, "Set the 7-zip shared library to use large memory pages.");
 }
@@ -12,48 +12,311 @@ License: This project is under the Apache-2.0 Lincense, see LICENSE for more det
 //bit7z headers
 #include <bitfilecompressor.hpp>
 
+//Helpers
+#include <ArchiveTools.hpp>
+
+//Destroys a StreamArchiveWriter without the GIL, then releases the Python buffers it still holds with the GIL
+//(Its background thread may be waiting for the GIL inside a Python callback while it is joined)
+struct StreamArchiveWriterDeleter {
+    void operator()(StreamArchiveWriter* writer) const {
+        std::vector<StreamArchiveWriter::Entry> left;
+        {
+            py::gil_scoped_release release;
+            left = writer->abandon();
+            delete writer;
+        }
+    }
+};
+
+using StreamArchiveWriterHolder = std::unique_ptr<StreamArchiveWriter, StreamArchiveWriterDeleter>;
+
+//Wraps a Python buffer as an entry, the buffer is kept until the entry is released
+//(Non-contiguous buffers are copied into bytes first)
+StreamArchiveWriter::Entry make_entry(const tstring& name, const py::buffer& data){
+    std::shared_ptr<py::buffer_info> info(new py::buffer_info(data.request()));
+    if (!PyBuffer_IsContiguous(info->view(), 'C')) {
+        py::bytes copy(py::memoryview(data).attr("tobytes")());
+        info.reset(new py::buffer_info(py::buffer(copy).request()));
+    }
+    StreamArchiveWriter::Entry entry;
+    entry.name = name;
+    entry.data = static_cast<const char*>(info->ptr);
+    entry.size = static_cast<size_t>(info->size * info->itemsize);
+    entry.owner = info;
+    return entry;
+}
+
+//Adds an entry without the GIL (the call may wait for the previous batch); the copied entries are released with the GIL
+//(done outlives the release scope, so its buffers are released with the GIL also when the call throws)
+void add_entry(StreamArchiveWriter& writer, StreamArchiveWriter::Entry&& entry){
+    std::vector<StreamArchiveWriter::Entry> done;
+    {
+        py::gil_scoped_release release;
+        writer.add(std::move(entry), done);
+    }
+}
+
+void close_writer(StreamArchiveWriter& writer){
+    std::vector<StreamArchiveWriter::Entry> done;
+    {
+        py::gil_scoped_release release;
+        writer.close(done);
+    }
+}
+
+//Converts the values of a property dict: bool, int (0 to 2**32-1) or str
+std::vector<std::pair<std::string, FormatPropertyValue>> to_format_properties(const py::dict& properties){
+    std::vector<std::pair<std::string, FormatPropertyValue>> result;
+    for (auto item : properties) {
+        std::string name = py::str(item.first);
+        py::handle value = item.second;
+        //bool first, since bool is a subclass of int
+        if (py::isinstance<py::bool_>(value)) {
+            result.emplace_back(name, value.cast<bool>());
+        } else if (py::isinstance<py::int_>(value)) {
+            long long number = value.cast<long long>();
+            if (number < 0 || number > 0xFFFFFFFFLL) {
+                throw py::value_error("The format property '" + name + "' is out of the range of an unsigned 32-bit number");
+            }
+            result.emplace_back(name, static_cast<uint32_t>(number));
+        } else if (py::isinstance<py::str>(value)) {
+            std::string text = value.cast<std::string>();
+            for (unsigned char ch : text) {
+                if (ch >= 0x80) {
+                    throw py::value_error("The format property '" + name + "' must be an ASCII string");
+                }
+            }
+            result.emplace_back(name, text);
+        } else {
+            throw py::type_error("The format property '" + name + "' must be a bool, an int or a str");
+        }
+    }
+    return result;
+}
+
 void init_BitFileCompressor(py::module_& mod){
-    py::class_<bit7z::BitFileCompressor>(mod, "BitFileCompressor")
+    py::class_<StreamArchiveWriter, StreamArchiveWriterHolder>(mod, "StreamArchiveWriter",
+        "A writer of one archive. Its methods may be called from several threads, they are run one at a time.")
+        //Add an entry from an object with the buffer protocol (bytes, bytearray, memoryview, numpy array...)
+        //The buffer is referenced rather than copied until its batch is copied to the temporary file, so it must not be modified meanwhile
+        .def("add", [](StreamArchiveWriter& writer, const tstring& name, const py::buffer& data){
+            add_entry(writer, make_entry(name, data));
+        },
+        py::arg("name"), py::arg("data"))
+
+        //Write the remaining entries and finish the archive
+        .def("close", &close_writer)
+
+        .def_property_readonly("closed", &StreamArchiveWriter::closed)
+
+        .def("__enter__", [](py::object self){
+            return self;
+        })
+
+        //The archive is finished only when the block exits without an exception
+        .def("__exit__", [](StreamArchiveWriter& writer, py::object type, py::object, py::object){
+            if (type.is_none()) {
+                close_writer(writer);
+                return;
+            }
+            std::vector<StreamArchiveWriter::Entry> left;
+            {
+                py::gil_scoped_release release;
+                left = writer.abandon();
+            }
+        });
+
+    py::class_<CompressorLease>(mod, "CompressorLease",
+        "A compressor checked out from the pool of a preset: with preset.checkout() as compressor: ... "
+        "The compressor goes back to the pool when the block exits: it raises RuntimeError if it is used afterwards.")
+        //The first call hands the compressor to Python, which owns it from then on; the lease keeps it alive
+        //(After the block the compressor raises on use, and it goes back to the pool once it is no longer referenced)
+        .def("__enter__", [](py::object self){
+            return lease_handler(self.cast<CompressorLease&>());
+        },
+        py::keep_alive<1, 0>())
+
+        .def("__exit__", [](CompressorLease& lease, py::object, py::object, py::object){
+            lease.giveBack();
+        })
+
+        .def_property_readonly("compressor", [](py::object self){
+            return lease_handler(self.cast<CompressorLease&>());
+        },
+        py::keep_alive<1, 0>())
+
+        //Return the compressor to the pool before the lease is destroyed
+        .def("release", &CompressorLease::giveBack);
+
+    py::class_<CompressorPreset, std::shared_ptr<CompressorPreset>>(mod, "CompressorPreset",
+        "The settings of a compressor, captured by BitFileCompressor.preset(). It makes configured compressors in one call.")
+        //Make a new compressor with the settings of the preset
+        .def("create", [](const CompressorPreset& preset){
+            return preset.create();
+        },
+        py::keep_alive<0, 1>())
+
+        //Take a compressor from the pool of the preset (or make one) and set the settings of the preset on it again
+        .def("checkout", [](std::shared_ptr<CompressorPreset> preset){
+            return std::unique_ptr<CompressorLease>(new CompressorLease(std::move(preset)));
+        },
+        py::keep_alive<0, 1>())
+
+        //Set the settings of the preset on an existing compressor (it waits like the setters)
+        .def("apply", [](const CompressorPreset& preset, bit7z::BitFileCompressor& target){
+            std::unique_ptr<SettingsWrite> write;
+            {
+                py::gil_scoped_release release;
+                write.reset(new SettingsWrite(&target));
+            }
+            preset.apply(target);
+        },
+        py::arg("target"))
+
+        .def_property_readonly("pooled", &CompressorPreset::pooled, "The number of idle compressors in the pool.")
+
+        .def("clear_pool", &CompressorPreset::clearPool, "Drop the idle compressors of the pool.");
+
+    py::class_<bit7z::BitFileCompressor, HandlerHolder<bit7z::BitFileCompressor>>(mod, "BitFileCompressor",
+        "A file compressor. Several threads may compress with the same compressor at the same time; "
+        "a setter waits until the running compressions (and open writers) are finished, and raises RuntimeError "
+        "when it is called by a callback of a running compression. Calls with a token, a timeout or prefetch threads "
+        "use the compressor alone, so they wait for the other compressions. The callbacks may be called from several threads at once.")
         //BitFileCompressor( const Bit7zLibrary& lib, const BitInOutFormat& format )
-        .def(py::init<const bit7z::Bit7zLibrary&, const bit7z::BitInOutFormat&>())
+        //The compressor refers to the library, which is kept alive with it
+        .def(py::init<const bit7z::Bit7zLibrary&, const bit7z::BitInOutFormat&>(), py::keep_alive<1, 2>())
 
         //void clearPassword() noexcept
-        .def("clear_password", &bit7z::BitFileCompressor::clearPassword, "Clear the current password used by the handler. Calling clearPassword() will disable the encryption/decryption of archives.")
+        .def("clear_password", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::clearPassword), "Clear the current password used by the handler. Calling clearPassword() will disable the encryption/decryption of archives.")
         
         //void compress( const std::map< tstring, tstring >& inPaths, const tstring& outFile ) const
-        .def("compress", static_cast<void (bit7z::BitFileCompressor::*)(
+        .def("compress", locked_operation<bit7z::BitFileCompressor>(static_cast<void (bit7z::BitFileCompressor::*)(
             const std::map<tstring, tstring>&,
             const tstring&
-        ) const>(&bit7z::BitFileCompressor::compress))
+        ) const>(&bit7z::BitFileCompressor::compress)),
+        py::call_guard<py::gil_scoped_release>())
 
         //void compress( const std::map< tstring, tstring >& inPaths, std::ostream& outStream ) const
         //...
         
         //void compress( const std::vector< tstring >& inPaths, const tstring& outFile ) const
-        .def("compress", static_cast<void (bit7z::BitFileCompressor::*)(
-            const std::vector<tstring>&,
-            const tstring&
-        ) const>(&bit7z::BitFileCompressor::compress))
+        //(With nativeTar, an uncompressed tar archive is written without 7-Zip, the data being copied by the kernel;
+        //the inputs it cannot write, like symbolic links, leave the compression to 7-Zip)
+        .def("compress", [](const bit7z::BitFileCompressor& self, const std::vector<tstring>& inPaths, const tstring& outFile,
+                            bool nativeTar){
+            HandlerUse use(&self);
+            if (nativeTar && compress_tar_native(self, inPaths, outFile, CancelScope(nullptr, 0.0))) {
+                return;
+            }
+            self.compress(inPaths, outFile);
+        },
+        py::arg("inPaths"), py::arg("outFile"), py::arg("nativeTar")=false,
+        py::call_guard<py::gil_scoped_release>())
 
         //void compress( const std::vector< tstring >& inPaths, std::ostream& outStream ) const
         //...
         
         //void compressDirectory( const tstring& inDir, const tstring& outFile ) const
-        .def("compress_directory", &bit7z::BitFileCompressor::compressDirectory)
+        //(With a token or a timeout, the compression can be stopped: a new output file is removed and OperationCancelled is raised)
+        .def("compress_directory", [](bit7z::BitFileCompressor& self, const tstring& inDir, const tstring& outFile,
+                                      const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self, scope.active());
+            run_cancellable(self, outFile, scope, [&](){
+                self.compressDirectory(inDir, outFile);
+            });
+        },
+        py::arg("inDir"), py::arg("outFile"), py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
         
         //void compressDirectoryContents( const tstring& inDir, const tstring& outFile, bool recursive = true, const tstring& filter = "*" ) const
-        .def("compress_directory_contents", &bit7z::BitFileCompressor::compressDirectoryContents,
-        py::arg("inDir"), py::arg("outFile"), py::arg("recursive") = true, py::arg("filter") = "*")
+        .def("compress_directory_contents", locked_operation<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::compressDirectoryContents),
+        py::arg("inDir"), py::arg("outFile"), py::arg("recursive") = true, py::arg("filter") = "*",
+        py::call_guard<py::gil_scoped_release>())
         
         //void compressFile( const tstring& inFile, const tstring& outFile, const tstring& inputName = {} ) const
-        .def("compress_file", static_cast<void (bit7z::BitFileCompressor::*)(
-            const tstring&,
-            const tstring&,
-            const tstring&
-        ) const>(&bit7z::BitFileCompressor::compressFile),
+        //(With blockThreads > 0, a gzip, bzip2 or xz file is compressed in blocks of blockSize bytes (0 for the default of the format)
+        //on that many threads, into a multi-member gzip, multi-stream bzip2 or multi-stream xz file which the stock tools read)
+        .def("compress_file", [](bit7z::BitFileCompressor& self, const tstring& inFile, const tstring& outFile,
+                                 const tstring& inputName, unsigned blockThreads, size_t blockSize,
+                                 const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            if (blockThreads > 0) {
+                //The blocks are compressed by their own compressors, so this one is only read
+                HandlerUse use(&self);
+                compress_file_blocks(self, inFile, outFile, inputName, blockThreads, blockSize, scope);
+                return;
+            }
+            HandlerUse use(&self, scope.active());
+            run_cancellable(self, outFile, scope, [&](){
+                self.compressFile(inFile, outFile, inputName);
+            });
+        },
         py::arg("inFile"),
         py::arg("outFile"),
-        py::arg("inputName") = "")
+        py::arg("inputName") = "",
+        py::arg("blockThreads") = 0,
+        py::arg("blockSize") = 0,
+        py::arg("token") = nullptr,
+        py::arg("timeout") = 0.0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Compress into a 7z archive with solid blocks of at most blockBytes bytes and blockFiles files (0 for no limit),
+        //so that reading one item (BitFileExtractor.extract_path or open) decodes little more than the item
+        .def("compress_seekable", [](const bit7z::BitFileCompressor& self, const std::vector<tstring>& inPaths, const tstring& outFile,
+                                     uint64_t blockBytes, uint64_t blockFiles,
+                                     const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            //The archive is written by its own writer, so this compressor is only read
+            HandlerUse use(&self);
+            compress_seekable(self, inPaths, outFile, blockBytes, blockFiles, scope);
+        },
+        py::arg("inPaths"),
+        py::arg("outFile"),
+        py::arg("blockBytes") = 16u << 20,
+        py::arg("blockFiles") = 256,
+        py::arg("token") = nullptr,
+        py::arg("timeout") = 0.0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Convert an archive into an archive of the format and settings of this compressor without extracting it to disk:
+        //the items are decoded by a thread into bounded in-memory pipes (maxPipeBytes) while they are encoded.
+        //The extractor gives the password and the format of the input (auto-detected when it is not given).
+        //It returns {"items", "bytes", "metadata", "skipped"}: metadata tells whether the times and the attributes were kept
+        //(tar and zip outputs), skipped lists the directories and symbolic links the output format cannot take.
+        //Other outputs lose the times and the attributes, so they raise ValueError unless dropMetadata is True
+        .def("transcode", [](const bit7z::BitFileCompressor& self, const tstring& inArchive, const tstring& outFile,
+                             const bit7z::BitFileExtractor* extractor, size_t maxPipeBytes, uint64_t maxSolidBytes,
+                             bool dropMetadata, const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            TranscodeReport report;
+            {
+                py::gil_scoped_release release;
+                //The archive is written by its own writer, so this compressor is only read
+                HandlerUse use(&self);
+                if (extractor) {
+                    HandlerUse useExtractor(extractor);
+                    report = transcode_archive(self, *extractor, inArchive, outFile, maxPipeBytes, maxSolidBytes, dropMetadata, scope);
+                } else {
+                    bit7z::BitFileExtractor detect(self.library(), bit7z::BitFormat::Auto);
+                    report = transcode_archive(self, detect, inArchive, outFile, maxPipeBytes, maxSolidBytes, dropMetadata, scope);
+                }
+            }
+            py::dict result;
+            result["items"] = report.items;
+            result["bytes"] = report.bytes;
+            result["metadata"] = report.metadata;
+            result["skipped"] = report.skipped;
+            return result;
+        },
+        py::arg("inArchive"),
+        py::arg("outFile"),
+        py::arg("extractor") = nullptr,
+        py::arg("maxPipeBytes") = 64u << 20,
+        py::arg("maxSolidBytes") = 1ull << 30,
+        py::arg("dropMetadata") = false,
+        py::arg("token") = nullptr,
+        py::arg("timeout") = 0.0)
 
         //void compressFile( const tstring& inFile, ostream& outStream, const tstring& inputName = {} ) const
         //...
@@ -62,155 +325,337 @@ void init_BitFileCompressor(py::module_& mod){
         //...
 
         //void compressFiles( const std::vector< tstring >& inFiles, const tstring& outFile ) const
-        .def("compress_files", static_cast<void (bit7z::BitFileCompressor::*)(
-            const std::vector< tstring >& inFiles,
-            const tstring& outFile 
-        ) const>(&bit7z::BitFileCompressor::compressFiles))
+        //(With prefetchThreads > 0, reader threads load the next files into the page cache ahead of the encoder)
+        .def("compress_files", [](bit7z::BitFileCompressor& self,
+                                  const std::vector<tstring>& inFiles,
+                                  const tstring& outFile,
+                                  unsigned prefetchThreads,
+                                  const CancelToken* token,
+                                  double timeout){
+            CancelScope scope(token, timeout);
+            //Cancelling and prefetching change the callbacks of the compressor while it runs
+            HandlerUse use(&self, scope.active() || prefetchThreads > 0);
+            if (prefetchThreads == 0) {
+                run_cancellable(self, outFile, scope, [&](){
+                    self.compressFiles(inFiles, outFile);
+                });
+                return;
+            }
+            //compressFiles names the items after the files, which lets the prefetcher follow the file callback;
+            //7-Zip reorders the items of a 7z archive by name, so they are prefetched in that order
+            std::vector<size_t> order(inFiles.size());
+            std::vector<tstring> names;
+            names.reserve(inFiles.size());
+            for (size_t i = 0; i < inFiles.size(); ++i) {
+                order[i] = i;
+                names.push_back(os::path::basename(inFiles[i]));
+            }
+            if (self.compressionFormat() == bit7z::BitFormat::SevenZip) {
+                std::stable_sort(order.begin(), order.end(), [&names](size_t a, size_t b){
+                    return names[a] < names[b];
+                });
+            }
+            std::vector<std::string> paths, orderedNames;
+            std::vector<uint64_t> sizes;
+            for (size_t i : order) {
+                paths.push_back(inFiles[i]);
+                orderedNames.push_back(names[i]);
+                sizes.push_back(os::path::getsize(inFiles[i]));
+            }
+            FilePrefetcher prefetcher(std::move(paths), sizes, orderedNames, prefetchThreads);
+            PrefetchGuard guard(self, prefetcher);
+            run_cancellable(self, outFile, scope, [&](){
+                self.compressFiles(inFiles, outFile);
+            });
+        },
+        py::arg("inFiles"), py::arg("outFile"), py::arg("prefetchThreads")=0,
+        py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Open a writer which takes in-memory entries one by one: writer.add(name, data), then writer.close()
+        //(The settings of the compressor cannot be changed until the writer is closed: the setters wait for it)
+        .def("open_writer", [](const bit7z::BitFileCompressor& self, const tstring& outFile, size_t batchBytes){
+            StreamArchiveWriter* writer;
+            {
+                py::gil_scoped_release release;
+                writer = new StreamArchiveWriter(self, outFile, batchBytes);
+            }
+            return StreamArchiveWriterHolder(writer);
+        },
+        py::arg("outFile"), py::arg("batchBytes")=64*1024*1024,
+        py::keep_alive<0, 1>(),
+        "Opens a writer taking in-memory entries: writer.add(name, data), then writer.close(). At most two batches of about batchBytes are held in memory. A new tar archive is written while the entries are added; other formats copy the entries into a temporary file and compress it on close(), so their peak disk use is the total size of the entries besides the archive.")
+
+        //Compress the (name, data) pairs of an iterable, for example a generator producing the files on the fly
+        .def("compress_stream", [](const bit7z::BitFileCompressor& self, const py::iterable& entries, const tstring& outFile, size_t batchBytes){
+            StreamArchiveWriterHolder writer;
+            {
+                py::gil_scoped_release release;
+                writer.reset(new StreamArchiveWriter(self, outFile, batchBytes));
+            }
+            for (py::handle pair : entries) {
+                py::tuple entry = py::reinterpret_borrow<py::object>(pair).cast<py::tuple>();
+                if (entry.size() != 2) {
+                    throw py::value_error("compress_stream expects (name, data) pairs");
+                }
+                add_entry(*writer, make_entry(entry[0].cast<tstring>(), entry[1].cast<py::buffer>()));
+            }
+            close_writer(*writer);
+        },
+        py::arg("entries"), py::arg("outFile"), py::arg("batchBytes")=64*1024*1024,
+        "Compresses the (name, data) pairs of an iterable like open_writer does. A new tar archive is written while the pairs are read; other formats need a temporary file as large as all the data together, since 7-Zip starts only after the last entry.")
 
         //void compressFiles( const tstring& inDir, const tstring& outFile, bool recursive = true, const tstring& filter = "*" ) const
-        .def("compress_files", static_cast<void (bit7z::BitFileCompressor::*)(
+        .def("compress_files", locked_operation<bit7z::BitFileCompressor>(static_cast<void (bit7z::BitFileCompressor::*)(
             const tstring&,
             const tstring&,
             bool,
             const tstring&
-        ) const>(&bit7z::BitFileCompressor::compressFiles),
-        py::arg("inDir"), py::arg("outFile"), py::arg("recursive")=true, py::arg("filter")="*")
+        ) const>(&bit7z::BitFileCompressor::compressFiles)),
+        py::arg("inDir"), py::arg("outFile"), py::arg("recursive")=true, py::arg("filter")="*",
+        py::call_guard<py::gil_scoped_release>())
+
+        //Compress a directory which is walked only once by the parallel scanner of pyos
+        //(bit7z walks the tree again inside compressDirectory, here the scanned list is handed to compress() directly;
+        //bit7z still reads the attributes of every listed path again, since it cannot take the scanned ones)
+        .def("compress_scanned", [](bit7z::BitFileCompressor& self,
+                                    const tstring& inDir,
+                                    const tstring& outFile,
+                                    const std::vector<std::string>& include,
+                                    const std::vector<std::string>& exclude,
+                                    unsigned threads,
+                                    unsigned prefetchThreads,
+                                    const CancelToken* token,
+                                    double timeout){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self, scope.active() || prefetchThreads > 0);
+            os::ScanOptions options;
+            options.include = include;
+            options.exclude = exclude;
+            options.threads = threads;
+            options.include_dirs = true;
+            std::vector<os::DirEntry> entries = os::scantree(inDir, options);
+
+            //Like compressDirectory, the items are stored under the name of the directory
+            bool endsWithSep = !inDir.empty() && (inDir.back() == '/' || inDir.back() == '\\');
+            size_t prefixLen = inDir.size() + (endsWithSep ? 0 : 1);
+            tstring topName = os::path::basename(os::path::normpath(inDir));
+
+            std::map<tstring, tstring> inPaths;
+            for (const auto& entry : entries) {
+                //Only empty directories are needed, bit7z would index a non-empty one recursively
+                //(a directory whose children were all filtered out is not empty on disk and is left out,
+                //otherwise bit7z would add its children again, bypassing include and exclude)
+                if (entry.is_dir() && entry.children != 0) {
+                    continue;
+                }
+                inPaths.emplace(entry.path, topName + "/" + entry.path.substr(prefixLen));
+            }
+            if (prefetchThreads == 0) {
+                run_cancellable(self, outFile, scope, [&](){
+                    self.compress(inPaths, outFile);
+                });
+                return;
+            }
+
+            //bit7z consumes the map in the order of the paths, which is also the order of the scanned entries
+            std::vector<std::string> paths, names;
+            std::vector<uint64_t> sizes;
+            for (const auto& entry : entries) {
+                if (!entry.is_dir()) {
+                    paths.push_back(entry.path);
+                    names.push_back(inPaths[entry.path]);
+                    sizes.push_back(entry.size);
+                }
+            }
+            FilePrefetcher prefetcher(std::move(paths), sizes, names, prefetchThreads);
+            PrefetchGuard guard(self, prefetcher);
+            run_cancellable(self, outFile, scope, [&](){
+                self.compress(inPaths, outFile);
+            });
+        },
+        py::arg("inDir"), py::arg("outFile"), py::arg("include")=std::vector<std::string>{},
+        py::arg("exclude")=std::vector<std::string>{}, py::arg("threads")=0, py::arg("prefetchThreads")=0,
+        py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Capture all the settings of the compressor into a preset, which keeps up to maxPooled idle compressors
+        .def("preset", [](const bit7z::BitFileCompressor& self, size_t maxPooled){
+            std::unique_ptr<SettingsRead> read;
+            {
+                py::gil_scoped_release release;
+                read.reset(new SettingsRead(&self));
+            }
+            return std::make_shared<CompressorPreset>(self, maxPooled);
+        },
+        py::arg("maxPooled")=8,
+        py::keep_alive<0, 1>())
 
         //const BitInOutFormat & compressionFormat() const noexcept
         .def("compression_format", &bit7z::BitFileCompressor::compressionFormat, py::return_value_policy::reference_internal)
 
         //BitCompressionLevel compressionLevel() const noexcept
-        .def("compression_level", &bit7z::BitFileCompressor::compressionLevel)
+        .def("compression_level", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::compressionLevel))
 
         //BitCompressionMethod compressionMethod() const noexcept
-        .def("compression_method", &bit7z::BitFileCompressor::compressionMethod)
+        .def("compression_method", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::compressionMethod))
 
         //bool cryptHeaders() const noexcept
-        .def("crypt_headers", &bit7z::BitFileCompressor::cryptHeaders)
+        .def("crypt_headers", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::cryptHeaders))
 
         //uint32_t dictionarySize() const noexcept
-        .def("dictionary_size", &bit7z::BitFileCompressor::dictionarySize)
+        .def("dictionary_size", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::dictionarySize))
 
         //FileCallback fileCallback() const
-        .def("file_callback", &bit7z::BitFileCompressor::fileCallback)
+        .def("file_callback", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::fileCallback))
 
         //[virtual] const BitInFormat &override format() const noexcept
         .def("format", &bit7z::BitFileCompressor::format, py::return_value_policy::reference_internal)
 
         //bool isPasswordDefined() const noexcept
-        .def("is_password_defined", &bit7z::BitFileCompressor::isPasswordDefined)
+        .def("is_password_defined", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::isPasswordDefined))
 
         //const Bit7zLibrary & library() const noexcept
         .def("library", &bit7z::BitFileCompressor::library, py::return_value_policy::reference_internal)
 
         //OverwriteMode overwriteMode() const
-        .def("overwrite_mode", &bit7z::BitFileCompressor::overwriteMode)
+        .def("overwrite_mode", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::overwriteMode))
 
         //tstring password() const
-        .def("password", &bit7z::BitFileCompressor::password)
+        .def("password", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::password))
 
         //PasswordCallback passwordCallback() const
-        .def("password_callback", &bit7z::BitFileCompressor::passwordCallback)
+        .def("password_callback", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::passwordCallback))
 
         //ProgressCallback progressCallback() const
-        .def("progress_callback", &bit7z::BitFileCompressor::progressCallback)
+        .def("progress_callback", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::progressCallback))
 
         //RatioCallback ratioCallback() const
-        .def("ratio_callback" , &bit7z::BitFileCompressor::ratioCallback)
+        .def("ratio_callback", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::ratioCallback))
 
         //bool retainDirectories() const noexcept
-        .def("retain_directories", &bit7z::BitFileCompressor::retainDirectories)
+        .def("retain_directories", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::retainDirectories))
 
         //void setCompressionLevel( BitCompressionLevel level ) noexcept
-        .def("set_compression_level", &bit7z::BitFileCompressor::setCompressionLevel)
+        .def("set_compression_level", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setCompressionLevel))
 
         //void setCompressionMethod( BitCompressionMethod method )
-        .def("set_compression_method", &bit7z::BitFileCompressor::setCompressionMethod)
+        .def("set_compression_method", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setCompressionMethod))
 
         //void setDictionarySize( uint32_t dictionarySize )
-        .def("set_dictionary_size", &bit7z::BitFileCompressor::setDictionarySize)
+        .def("set_dictionary_size", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setDictionarySize))
 
         //void setFileCallback( const FileCallback& callback )
-        .def("set_file_callback", &bit7z::BitFileCompressor::setFileCallback)
+        .def("set_file_callback", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setFileCallback))
 
         //void setFormatProperty( const wchar_t(&) name, const T& value ) noexcept
-        //...
-
         //void setFormatProperty( const wchar_t(&) name, T value ) noexcept
-        //...
+        //Set 7-Zip format properties from a dict like {"mt": 4, "mf": "hc4", "fb": 32, "qs": True}, and return the applied values
+        //(The names are the 7-Zip ones or the command line ones like mmt; the whole dict is checked against the format first,
+        //so an invalid property raises ValueError and changes nothing. A property cannot be removed once set)
+        .def("set_format_properties", [](bit7z::BitFileCompressor& self, const py::dict& properties){
+            FormatProperties checked = validate_format_properties(self.compressionFormat(), to_format_properties(properties));
+            std::unique_ptr<SettingsWrite> write;
+            {
+                py::gil_scoped_release release;
+                write.reset(new SettingsWrite(&self));
+            }
+            apply_format_properties(self, checked);
+            FormatPropertyStore::global().merge(&self, checked);
+            return checked;
+        },
+        py::arg("properties"))
+
+        //The format properties set on the compressor so far
+        .def("format_properties", [](const bit7z::BitFileCompressor& self){
+            py::gil_scoped_release release;
+            SettingsRead read(&self);
+            return FormatPropertyStore::global().get(&self);
+        })
+
+        //The names of the format properties which the format of the compressor supports, with their descriptions
+        .def("supported_format_properties", [](const bit7z::BitFileCompressor& self){
+            std::map<std::string, std::string> result;
+            for (const auto& spec : format_property_specs()) {
+                if (spec.supports(self.compressionFormat())) {
+                    result[spec.name] = spec.help;
+                }
+            }
+            return result;
+        })
 
         //void setOverwriteMode( OverwriteMode mode )
-        .def("set_overwrite_mode", &bit7z::BitFileCompressor::setOverwriteMode)
+        .def("set_overwrite_mode", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setOverwriteMode))
 
         //[virtual] void setPassword( const tstring& password ) override
-        .def("set_password", static_cast<void (bit7z::BitFileCompressor::*)(
+        .def("set_password", locked_setter<bit7z::BitFileCompressor>(static_cast<void (bit7z::BitFileCompressor::*)(
             const tstring&
-        ) >(&bit7z::BitFileCompressor::setPassword))
+        ) >(&bit7z::BitFileCompressor::setPassword)))
 
         //void setPassword( const tstring& password, bool cryptHeaders )
-        .def("set_password", static_cast<void (bit7z::BitFileCompressor::*)(
+        .def("set_password", locked_setter<bit7z::BitFileCompressor>(static_cast<void (bit7z::BitFileCompressor::*)(
             const tstring&,
             bool
-        ) >(&bit7z::BitFileCompressor::setPassword))
+        ) >(&bit7z::BitFileCompressor::setPassword)))
 
         //void setPasswordCallback( const PasswordCallback& callback )
-        .def("set_password_callback", &bit7z::BitFileCompressor::setPasswordCallback)
+        .def("set_password_callback", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setPasswordCallback))
 
         //void setProgressCallback( const ProgressCallback& callback )
-        .def("set_progress_callback", &bit7z::BitFileCompressor::setProgressCallback)
+        .def("set_progress_callback", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setProgressCallback))
 
         //void setRatioCallback( const RatioCallback& callback )
-        .def("set_ratio_callback", &bit7z::BitFileCompressor::setRatioCallback)
+        .def("set_ratio_callback", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setRatioCallback))
 
         //void setRetainDirectories( bool retain ) noexcept
-        .def("set_retain_directories", &bit7z::BitFileCompressor::setRetainDirectories)
+        .def("set_retain_directories", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setRetainDirectories))
 
         //void setSolidMode( bool solidMode ) noexcept
-        .def("set_solid_mode", &bit7z::BitFileCompressor::setSolidMode)
+        .def("set_solid_mode", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setSolidMode))
 
         //void setStoreSymbolicLinks( bool storeSymlinks ) noexcept
-        .def("set_store_symbolic_links", &bit7z::BitFileCompressor::setStoreSymbolicLinks)
+        .def("set_store_symbolic_links", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setStoreSymbolicLinks))
 
         //void setThreadsCount( uint32_t threadsCount ) noexcept
-        .def("set_threads_count", &bit7z::BitFileCompressor::setThreadsCount)
+        .def("set_threads_count", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setThreadsCount))
 
         //void setTotalCallback( const TotalCallback& callback )
-        .def("set_total_callback", &bit7z::BitFileCompressor::setTotalCallback)
+        .def("set_total_callback", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setTotalCallback))
 
         //void setUpdateMode( bool canUpdate )
         //Deprecated since bit7z-4.0, and we won't use this API in new project
 
         //[virtual] void setUpdateMode( UpdateMode mode )
-        .def("set_update_mode", static_cast<void (bit7z::BitFileCompressor::*)(
+        .def("set_update_mode", locked_setter<bit7z::BitFileCompressor>(static_cast<void (bit7z::BitFileCompressor::*)(
             bit7z::UpdateMode
-        ) >(&bit7z::BitFileCompressor::setUpdateMode))
+        ) >(&bit7z::BitFileCompressor::setUpdateMode)))
 
         //void setVolumeSize( uint64_t volumeSize ) noexcept
-        .def("set_volume_size", &bit7z::BitFileCompressor::setVolumeSize)
+        .def("set_volume_size", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setVolumeSize))
 
         //void setWordSize( uint32_t wordSize )
-        .def("set_word_size", &bit7z::BitFileCompressor::setWordSize)
+        .def("set_word_size", locked_setter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::setWordSize))
 
         //bool solidMode() const noexcept
-        .def("solid_mode", &bit7z::BitFileCompressor::solidMode)
+        .def("solid_mode", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::solidMode))
 
         //bool storeSymbolicLinks() const noexcept
-        .def("store_symbolic_links", &bit7z::BitFileCompressor::storeSymbolicLinks)
+        .def("store_symbolic_links", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::storeSymbolicLinks))
 
         //uint32_t threadsCount() const noexcept
-        .def("threads_count", &bit7z::BitFileCompressor::threadsCount)
+        .def("threads_count", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::threadsCount))
 
         //TotalCallback totalCallback() const
-        .def("total_callback", &bit7z::BitFileCompressor::totalCallback)
+        .def("total_callback", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::totalCallback))
 
         //UpdateMode updateMode() const noexcept
-        .def("update_mode", &bit7z::BitFileCompressor::updateMode)
+        .def("update_mode", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::updateMode))
 
         //uint64_t volumeSize() const noexcept
-        .def("volume_size", &bit7z::BitFileCompressor::volumeSize)
+        .def("volume_size", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::volumeSize))
 
         //uint32_t wordSize() const noexcept
-        .def("word_size", &bit7z::BitFileCompressor::wordSize)
+        .def("word_size", locked_getter<bit7z::BitFileCompressor>(&bit7z::BitFileCompressor::wordSize))
         ;
 }
 
@@ -219,12 +664,14 @@ void init_BitFileCompressor(py::module_& mod){
 #include <Enums_EVP.cpp>
 #include <Bit7zLibrary_EVP.cpp>
 #include <BitFormat_EVP.cpp>
+#include <Cancel_EVP.cpp>
 
 #ifdef PYTHON_NO_GIL //Compat Python 3.13+ free-threadind build
 PYBIND11_MODULE(bfcps, mod, py::mod_gil_not_used()){
     init_lib(mod);
     init_enums(mod);
     init_formats(mod);
+    init_cancel(mod);
     init_BitFileCompressor(mod);
     mod.attr("VERSION_INFO") = VERSION_STRING;
 }
@@ -233,6 +680,7 @@ PYBIND11_MODULE(bfcps, mod){
     init_lib(mod);
     init_enums(mod);
     init_formats(mod);
+    init_cancel(mod);
     init_BitFileCompressor(mod);
     mod.attr("VERSION_INFO") = VERSION_STRING;
 }
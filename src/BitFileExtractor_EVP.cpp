@@ -11,124 +11,828 @@ License: This project is under the Apache-2.0 Lincense, see LICENSE for more det
 
 //bit7z header
 #include <bitfileextractor.hpp>
+#include <bitarchivereader.hpp>
+
+//Helpers
+#include <ArchiveTools.hpp>
+#include <asyncwriter.hpp>
+
+//The size of the buffers handed from the decoding thread to the writer threads
+constexpr size_t kWriteChunkSize = 1024 * 1024;
+
+//Destroys an ItemStream without the GIL
+//(Its decoding thread may be waiting for the GIL inside a Python callback while it is joined)
+struct ItemStreamDeleter {
+    void operator()(ItemStream* stream) const {
+        py::gil_scoped_release release;
+        delete stream;
+    }
+};
+
+using ItemStreamHolder = std::unique_ptr<ItemStream, ItemStreamDeleter>;
+
+//Destroys an ArchiveFile without the GIL, for the same reason
+struct ArchiveFileDeleter {
+    void operator()(ArchiveFile* file) const {
+        py::gil_scoped_release release;
+        delete file;
+    }
+};
+
+using ArchiveFileHolder = std::unique_ptr<ArchiveFile, ArchiveFileDeleter>;
 
 void init_BitFileExtractor(py::module_& mod){
-    py::class_<bit7z::BitFileExtractor>(mod, "BitFileExtractor")
+    //Raised when the fast paths of extract() cannot create or write an output file
+    py::register_exception<OutputError>(mod, "OutputError", PyExc_OSError);
+
+    py::class_<ItemStream, ItemStreamHolder>(mod, "ItemStream",
+        "A stream of the decoded items of one archive. Several threads may consume it, every chunk is returned once.")
+        .def("__iter__", [](py::object self){
+            return self;
+        })
+
+        //Returns (path, data); the pieces of an item larger than the chunk size come as consecutive tuples with the same path
+        .def("__next__", [](ItemStream& stream){
+            ItemChunk chunk;
+            bool more;
+            {
+                py::gil_scoped_release release;
+                more = stream.next(chunk);
+            }
+            if (!more) {
+                throw py::stop_iteration();
+            }
+            py::bytes data(chunk.data.data(), chunk.data.size());
+            stream.recycle(std::move(chunk.data));
+            return py::make_tuple(chunk.item.path, data);
+        })
+
+        //Returns (item, offset, last, data), or None after the last chunk
+        .def("next_chunk", [](ItemStream& stream) -> py::object {
+            ItemChunk chunk;
+            bool more;
+            {
+                py::gil_scoped_release release;
+                more = stream.next(chunk);
+            }
+            if (!more) {
+                return py::none();
+            }
+            py::bytes data(chunk.data.data(), chunk.data.size());
+            stream.recycle(std::move(chunk.data));
+            return py::make_tuple(chunk.item, chunk.offset, chunk.last, data);
+        })
+
+        //Stops decoding; the iteration ends after it
+        .def("close", &ItemStream::cancel);
+
+    py::class_<ArchiveFile, ArchiveFileHolder>(mod, "ArchiveFile",
+        "A read-only, seekable file object over one archive item, made by BitFileExtractor.open(). "
+        "Wrap it in io.BufferedReader for readline() and iteration.")
+        //Reads up to size bytes (all the rest when size is negative); it returns b"" at the end of the item
+        .def("read", [](ArchiveFile& file, int64_t size){
+            std::string data;
+            {
+                py::gil_scoped_release release;
+                //Clamped to the rest of the item before allocating, so a large size does not reserve memory for nothing
+                uint64_t rest = file.remaining();
+                uint64_t want = size >= 0 ? std::min<uint64_t>(rest, static_cast<uint64_t>(size)) : rest;
+                //The size of some items is known only after decoding them, those are read piece by piece
+                const uint64_t piece = rest == std::numeric_limits<uint64_t>::max() ? (1 << 20) : want;
+                while (data.size() < want) {
+                    size_t used = data.size();
+                    size_t len = static_cast<size_t>(std::min<uint64_t>(want - used, piece));
+                    data.resize(used + len);
+                    size_t got = file.read(&data[used], len);
+                    data.resize(used + got);
+                    if (got == 0) {
+                        break;
+                    }
+                }
+            }
+            return py::bytes(data);
+        },
+        py::arg("size")=-1)
+
+        //Reads into a writable buffer (a bytearray, a memoryview...) and returns the number of bytes read
+        //(A read-only or strided buffer raises BufferError)
+        .def("readinto", [](ArchiveFile& file, py::buffer buffer){
+            ContiguousBuffer out(buffer, true);
+            py::gil_scoped_release release;
+            return file.read(out.data(), out.size());
+        },
+        py::arg("buffer"))
+
+        .def("seek", &ArchiveFile::seek,
+        py::arg("offset"), py::arg("whence")=0, py::call_guard<py::gil_scoped_release>())
+
+        .def("tell", &ArchiveFile::tell)
+
+        .def("readable", [](const ArchiveFile&){
+            return true;
+        })
+
+        .def("seekable", [](const ArchiveFile&){
+            return true;
+        })
+
+        .def("writable", [](const ArchiveFile&){
+            return false;
+        })
+
+        //The size of the item (an item whose size the archive does not tell is decoded to its end first)
+        .def_property_readonly("size", &ArchiveFile::size, py::call_guard<py::gil_scoped_release>())
+
+        .def_property_readonly("name", &ArchiveFile::name)
+
+        .def_property_readonly("closed", &ArchiveFile::closed)
+
+        //Whether the item is read in place from the archive (a stored zip item or a tar file) instead of decoded
+        .def_property_readonly("in_place", &ArchiveFile::inPlace)
+
+        .def("close", &ArchiveFile::close, py::call_guard<py::gil_scoped_release>())
+
+        .def("__enter__", [](py::object self){
+            return self;
+        })
+
+        .def("__exit__", [](ArchiveFile& file, py::object, py::object, py::object){
+            py::gil_scoped_release release;
+            file.close();
+        });
+
+    py::class_<VerifyFailure>(mod, "VerifyFailure")
+        .def_readonly("archive", &VerifyFailure::archive, "The path of the archive.")
+        .def_readonly("index", &VerifyFailure::index, "The index of the failed item (-1 if the failure is about the whole archive).")
+        .def_readonly("path", &VerifyFailure::path, "The path of the failed item in the archive.")
+        .def_readonly("source", &VerifyFailure::source, "The BitFailureSource of the failure.")
+        .def_readonly("message", &VerifyFailure::message, "The error message.")
+        .def("__repr__", [](const VerifyFailure& failure){
+            return "<VerifyFailure '" + failure.archive + "' [" + std::to_string(failure.index) + "] " + failure.message + ">";
+        });
+
+    py::class_<VerifyReport>(mod, "VerifyReport")
+        .def_readonly("archives", &VerifyReport::archives, "The number of verified archives.")
+        .def_readonly("items", &VerifyReport::items, "The number of verified items.")
+        .def_readonly("bytes", &VerifyReport::bytes, "The uncompressed bytes of the verified items.")
+        .def_readonly("failures", &VerifyReport::failures, "The failures, ordered by archive and item index.")
+        .def_property_readonly("ok", [](const VerifyReport& report){
+            return report.failures.empty();
+        });
+
+    py::class_<ExtractorLease>(mod, "ExtractorLease",
+        "A extractor checked out from the pool of a preset: with preset.checkout() as extractor: ... "
+        "The extractor goes back to the pool when the block exits: it raises RuntimeError if it is used afterwards.")
+        //The first call hands the extractor to Python, which owns it from then on; the lease keeps it alive
+        //(After the block the extractor raises on use, and it goes back to the pool once it is no longer referenced)
+        .def("__enter__", [](py::object self){
+            return lease_handler(self.cast<ExtractorLease&>());
+        },
+        py::keep_alive<1, 0>())
+
+        .def("__exit__", [](ExtractorLease& lease, py::object, py::object, py::object){
+            lease.giveBack();
+        })
+
+        .def_property_readonly("extractor", [](py::object self){
+            return lease_handler(self.cast<ExtractorLease&>());
+        },
+        py::keep_alive<1, 0>())
+
+        //Return the extractor to the pool before the lease is destroyed
+        .def("release", &ExtractorLease::giveBack);
+
+    py::class_<ExtractorPreset, std::shared_ptr<ExtractorPreset>>(mod, "ExtractorPreset",
+        "The settings of a extractor, captured by BitFileExtractor.preset(). It makes configured extractors in one call.")
+        //Make a new extractor with the settings of the preset
+        .def("create", [](const ExtractorPreset& preset){
+            return preset.create();
+        },
+        py::keep_alive<0, 1>())
+
+        //Take a extractor from the pool of the preset (or make one) and set the settings of the preset on it again
+        .def("checkout", [](std::shared_ptr<ExtractorPreset> preset){
+            return std::unique_ptr<ExtractorLease>(new ExtractorLease(std::move(preset)));
+        },
+        py::keep_alive<0, 1>())
+
+        //Set the settings of the preset on an existing extractor (it waits like the setters)
+        .def("apply", [](const ExtractorPreset& preset, bit7z::BitFileExtractor& target){
+            std::unique_ptr<SettingsWrite> write;
+            {
+                py::gil_scoped_release release;
+                write.reset(new SettingsWrite(&target));
+            }
+            preset.apply(target);
+        },
+        py::arg("target"))
+
+        .def_property_readonly("pooled", &ExtractorPreset::pooled, "The number of idle extractors in the pool.")
+
+        .def("clear_pool", &ExtractorPreset::clearPool, "Drop the idle extractors of the pool.");
+
+    py::class_<bit7z::BitFileExtractor, HandlerHolder<bit7z::BitFileExtractor>>(mod, "BitFileExtractor",
+        "A file extractor. Several threads may extract with the same extractor at the same time; "
+        "a setter waits until the running extractions are finished, and raises RuntimeError when it is called "
+        "by a callback of a running extraction. The callbacks may be called from several threads at once.")
         //BitExtractor( const Bit7zLibrary& lib, const BitInFormat& format = BitFormat::Auto )
-        .def(py::init<const bit7z::Bit7zLibrary&, const bit7z::BitInFormat&>(), py::arg("lib"), py::arg("format")=bit7z::BitFormat::Auto)
+        //The extractor refers to the library, which is kept alive with it
+        .def(py::init<const bit7z::Bit7zLibrary&, const bit7z::BitInFormat&>(), py::arg("lib"), py::arg("format")=bit7z::BitFormat::Auto,
+             py::keep_alive<1, 2>())
         
         //void clearPassword() noexcept
-        .def("clear_password", &bit7z::BitFileExtractor::clearPassword)
+        .def("clear_password", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::clearPassword))
 
         //void extract( const tstring& inArchive, const tstring& outDir = {} ) const
-        .def("extract", static_cast<void (bit7z::BitFileExtractor::*)(
-            const tstring&,
-            const tstring&
-        ) const>(&bit7z::BitFileExtractor::extract),
-        py::arg("inArchive"), py::arg("outDir")="")
+        //(With useMmap, the archive is mapped into memory and read by 7-Zip as an in-memory stream)
+        //(With a token or a timeout, the extraction can be stopped: the files written by it are removed and OperationCancelled is raised)
+        //(With decodeThreads other than 1, a gzip, bzip2 or xz file made of independent members or blocks is decoded
+        //on that many threads, 0 for all the cores; a file which cannot be split, or whose pieces decode to more than
+        //the memory cap, is decoded as one stream. An output file which cannot be written raises OutputError)
+        //(With nativeTar, an uncompressed tar archive of files and directories is extracted without 7-Zip,
+        //the data being copied by the kernel; other tar archives, and retainDirectories turned off, go through 7-Zip)
+        //(With copyStored, the large stored items of a zip archive are copied by the kernel with their CRC checked on another thread,
+        //before 7-Zip extracts the other items)
+        .def("extract", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& outDir, bool useMmap,
+                           const CancelToken* token, double timeout, unsigned decodeThreads, bool nativeTar,
+                           bool copyStored){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self);
+            if (decodeThreads != 1 && extract_parallel(self, inArchive, outDir, input_format(self, inArchive), decodeThreads, scope)) {
+                return;
+            }
+            if (nativeTar && !useMmap && extract_tar_native(self, inArchive, outDir, scope)) {
+                return;
+            }
+            if (copyStored && !useMmap && extract_stored_copies(self, inArchive, outDir, scope)) {
+                return;
+            }
+            if (!useMmap && !scope.active()) {
+                //Opened with the detected format, so 7-Zip does not probe its handlers one by one
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                reader.extractTo(outDir);
+                return;
+            }
+            if (!useMmap) {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                extract_cancellable(self, reader, outDir, scope);
+                return;
+            }
+            MappedArchive archive(inArchive, os::Advice::Sequential);
+            bit7z::BitArchiveReader reader(self.library(), archive.stream, input_format(self, inArchive));
+            apply_settings(self, reader);
+            extract_cancellable(self, reader, outDir, scope);
+        },
+        py::arg("inArchive"), py::arg("outDir")="", py::arg("useMmap")=false,
+        py::arg("token")=nullptr, py::arg("timeout")=0.0, py::arg("decodeThreads")=1, py::arg("nativeTar")=false,
+        py::arg("copyStored")=false,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Extract the archive with an asynchronous output backend:
+        //the decoding thread only fills buffers, while the writer threads create, preallocate, write and close the files.
+        //The writer threads use plain blocking writes (there is no io_uring backend).
+        //A solid archive which decodes to at most maxSolidBytes is decoded in one pass into memory and its items are then
+        //handed to the writer threads (decoding its items one by one would decode the solid blocks again);
+        //a larger one, or one with duplicate paths, is extracted by 7-Zip
+        .def("extract_async", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& outDir, unsigned ioThreads,
+                                 uint64_t maxSolidBytes, const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self);
+            bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+            apply_settings(self, reader);
+#ifdef _WIN32
+            //The output paths cannot be resolved safely below outDir here, so 7-Zip extracts them
+            extract_cancellable(self, reader, outDir, scope);
+#else
+            bit7z::ProgressCallback progress = scope.wrap(self.progressCallback());
+            std::map<tstring, std::vector<bit7z::byte_t>> solid;
+            if (reader.isSolid()) {
+                bool decoded;
+                try {
+                    decoded = decode_solid_pass(reader, maxSolidBytes, progress, solid);
+                } catch (...) {
+                    if (scope.stopped()) {
+                        scope.raise();
+                    }
+                    throw;
+                }
+                if (!decoded) {
+                    extract_cancellable(self, reader, outDir, scope);
+                    return;
+                }
+            }
+            reader.setProgressCallback(progress);
+
+            //The item paths are resolved below outDir without following any symbolic link,
+            //and the cancelled extraction removes only what it created
+            safepath::Root root(outDir);
+            if (!root.valid()) {
+                throw std::runtime_error("Cannot open the output directory: " + outDir);
+            }
+            safepath::Existing existing = existing_mode(self.overwriteMode());
+            bool retain = self.retainDirectories();
+            //Declared after the root, so the writer is destroyed (and waited for) first
+            AsyncFileWriter writer(ioThreads, 64 * 1024 * 1024, &chunk_pool());
+            //The handle of the file being written, closed when the decoding stops in the middle of it
+            bool writing = false;
+            uint64_t handle = 0;
+            bool cancelled = false;
+            try {
+                for (const auto& item : reader) {
+                    if (scope.stopped()) {
+                        cancelled = true;
+                        break;
+                    }
+                    if (item_output_path(outDir, item.path()).empty()) {
+                        continue;
+                    }
+                    std::string rel = item_relative_path(item.path(), retain);
+                    if (item.isDir()) {
+                        if (retain && !root.make_dirs(rel)) {
+                            throw std::runtime_error("Cannot create the directory " + rel + ": " + std::strerror(errno));
+                        }
+                        continue;
+                    }
+                    auto decoded = solid.find(item.path());
+                    if (item.isSymLink()) {
+                        //The data of a symbolic link is its target
+                        std::ostringstream target;
+                        if (decoded != solid.end()) {
+                            target.write(reinterpret_cast<const char*>(decoded->second.data()),
+                                         static_cast<std::streamsize>(decoded->second.size()));
+                        } else {
+                            reader.extractTo(target, item.index());
+                        }
+                        bool skipped;
+                        if (!root.symlink(rel, target.str(), existing, skipped)) {
+                            throw std::runtime_error("Cannot create the link " + rel + ": " + std::strerror(errno));
+                        }
+                        continue;
+                    }
+
+                    handle = writer.open_at(root, rel, existing, item.size());
+                    writing = true;
+                    {
+                        ChunkStreamBuf<> buffer(kWriteChunkSize, [&writer, handle](std::vector<char>&& chunk){
+                            writer.write(handle, std::move(chunk));
+                        }, &chunk_pool());
+                        std::ostream out(&buffer);
+                        if (decoded != solid.end()) {
+                            //The decoded item is handed over in pooled chunks and freed
+                            out.write(reinterpret_cast<const char*>(decoded->second.data()),
+                                      static_cast<std::streamsize>(decoded->second.size()));
+                            out.flush();
+                            solid.erase(decoded);
+                        } else {
+                            reader.extractTo(out, item.index());
+                        }
+                    }
+                    writer.close(handle, std::chrono::system_clock::to_time_t(item.lastWriteTime()));
+                    writing = false;
+                }
+            } catch (...) {
+                if (writing) {
+                    writer.close(handle);
+                }
+                if (!scope.stopped()) {
+                    writer.wait();
+                    throw;
+                }
+                cancelled = true;
+            }
+
+            writer.wait();
+            if (cancelled) {
+                root.remove_created();
+                scope.raise();
+            }
+            auto errors = writer.errors();
+            if (!errors.empty()) {
+                throw std::runtime_error("Cannot write file " + errors.front().first + ": " + std::strerror(errors.front().second));
+            }
+#endif
+        },
+        py::arg("inArchive"), py::arg("outDir")="", py::arg("ioThreads")=0, py::arg("maxSolidBytes")=256ull << 20,
+        py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
 
         //void extract( const tstring& inArchive, std::map< tstring, vector< byte_t > >& outMap ) const
-        //...
+        //(The items are decoded into the buffers of the per-thread buffer pool, which are reused across calls)
+        .def("extract_to_memory", [](const bit7z::BitFileExtractor& self, const tstring& inArchive){
+            BufferPool<char>& pool = ThreadBufferPools<char>::local();
+            std::vector<std::pair<tstring, std::vector<char>>> decoded;
+            std::map<tstring, std::vector<bit7z::byte_t>> solid;
+            {
+                py::gil_scoped_release release;
+                HandlerUse use(&self);
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                if (reader.isSolid()) {
+                    //Decoding the items of a solid block one by one would decode the block again for each item
+                    reader.extractTo(solid);
+                } else {
+                    for (const auto& item : reader) {
+                        if (item.isDir()) {
+                            continue;
+                        }
+                        std::vector<char> buffer = pool.acquire(initial_reserve(item.size()));
+                        {
+                            VectorStreamBuf streamBuf(buffer);
+                            std::ostream out(&streamBuf);
+                            reader.extractTo(out, item.index());
+                        }
+                        decoded.emplace_back(item.path(), std::move(buffer));
+                    }
+                }
+            }
+
+            py::dict result;
+            for (auto& entry : decoded) {
+                result[py::str(entry.first)] = py::bytes(entry.second.data(), entry.second.size());
+                pool.release(std::move(entry.second));
+            }
+            for (auto& entry : solid) {
+                result[py::str(entry.first)] = py::bytes(reinterpret_cast<const char*>(entry.second.data()), entry.second.size());
+            }
+            return result;
+        },
+        py::arg("inArchive"))
 
         //void extract( const tstring& inArchive, std::ostream& outStream, uint32_t index = 0 ) const
         //...
 
         //void extract( const tstring& inArchive, vector< byte_t >& outBuffer, uint32_t index = 0 ) const
-        //...
+        //(The item is decoded into a buffer of the per-thread buffer pool)
+        .def("extract_item", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, uint32_t index){
+            BufferPool<char>& pool = ThreadBufferPools<char>::local();
+            std::vector<char> buffer;
+            {
+                py::gil_scoped_release release;
+                HandlerUse use(&self);
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                buffer = pool.acquire(initial_reserve(reader.itemAt(index).size()));
+                VectorStreamBuf streamBuf(buffer);
+                std::ostream out(&streamBuf);
+                reader.extractTo(out, index);
+            }
+            py::bytes result(buffer.data(), buffer.size());
+            pool.release(std::move(buffer));
+            return result;
+        },
+        py::arg("inArchive"), py::arg("index")=0)
+
+        //Extract one item by its path into bytes (either separator matches)
+        //(Out of an archive written by BitFileCompressor.compress_seekable, only the small solid block of the item is decoded)
+        .def("extract_path", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& itemPath){
+            BufferPool<char>& pool = ThreadBufferPools<char>::local();
+            std::vector<char> buffer;
+            {
+                py::gil_scoped_release release;
+                HandlerUse use(&self);
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                uint32_t index = find_item_path(reader, itemPath);
+                buffer = pool.acquire(initial_reserve(reader.itemAt(index).size()));
+                VectorStreamBuf streamBuf(buffer);
+                std::ostream out(&streamBuf);
+                reader.extractTo(out, index);
+            }
+            py::bytes result(buffer.data(), buffer.size());
+            pool.release(std::move(buffer));
+            return result;
+        },
+        py::arg("inArchive"), py::arg("itemPath"))
+
+        //Capture all the settings of the extractor into a preset, which keeps up to maxPooled idle extractors
+        .def("preset", [](const bit7z::BitFileExtractor& self, size_t maxPooled){
+            std::unique_ptr<SettingsRead> read;
+            {
+                py::gil_scoped_release release;
+                read.reset(new SettingsRead(&self));
+            }
+            return std::make_shared<ExtractorPreset>(self, maxPooled);
+        },
+        py::arg("maxPooled")=8,
+        py::keep_alive<0, 1>())
 
         //const BitInFormat & extractionFormat() const noexcept
         .def("extraction_format", &bit7z::BitFileExtractor::extractionFormat, py::return_value_policy::reference_internal)
         
         //void extractItems( const tstring& inArchive, const std::vector< uint32_t >& indices, const tstring& outDir = {} ) const
-        .def("extract_items", &bit7z::BitFileExtractor::extractItems, 
-        py::arg("inArchive"), py::arg("indices"), py::arg("outDir")="")
+        .def("extract_items", [](const bit7z::BitFileExtractor& self, const tstring& inArchive,
+                                 const std::vector<uint32_t>& indices, const tstring& outDir, bool useMmap,
+                                 const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self);
+            if (!useMmap && !scope.active()) {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                reader.extractTo(outDir, indices);
+                return;
+            }
+            if (!useMmap) {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                extract_cancellable(self, reader, outDir, scope, &indices);
+                return;
+            }
+            MappedArchive archive(inArchive, os::Advice::Random);
+            bit7z::BitArchiveReader reader(self.library(), archive.stream, input_format(self, inArchive));
+            apply_settings(self, reader);
+            extract_cancellable(self, reader, outDir, scope, &indices);
+        },
+        py::arg("inArchive"), py::arg("indices"), py::arg("outDir")="", py::arg("useMmap")=false,
+        py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
 
         //void extractMatching( const tstring& inArchive, const tstring& itemFilter, const tstring& outDir = {}, FilterPolicy policy = FilterPolicy::Include ) const
-        .def("extract_matching", static_cast<void (bit7z::BitFileExtractor::*)(
+        .def("extract_matching", locked_operation<bit7z::BitFileExtractor>(static_cast<void (bit7z::BitFileExtractor::*)(
             const tstring&,
             const tstring&,
             const tstring&,
             bit7z::FilterPolicy
-        ) const>(&bit7z::BitFileExtractor::extractMatching),
+        ) const>(&bit7z::BitFileExtractor::extractMatching)),
         py::arg("inArchive"), py::arg("itemFilter"), py::arg("outDir")="",
-        py::arg("policy")=bit7z::FilterPolicy::Include)
+        py::arg("policy")=bit7z::FilterPolicy::Include,
+        py::call_guard<py::gil_scoped_release>())
 
         //void extractMatching( const tstring& inArchive, const tstring& itemFilter, vector< byte_t >& outBuffer, FilterPolicy policy = FilterPolicy::Include ) const
         //...
 
         //void extractMatchingRegex( const tstring& inArchive, const tstring& regex, const tstring& outDir = {}, FilterPolicy policy = FilterPolicy::Include ) const
-        .def("extract_matching_regex", static_cast<void (bit7z::BitFileExtractor::*)(
+        .def("extract_matching_regex", locked_operation<bit7z::BitFileExtractor>(static_cast<void (bit7z::BitFileExtractor::*)(
             const tstring&,
             const tstring&,
             const tstring&,
             bit7z::FilterPolicy
-        ) const>(&bit7z::BitFileExtractor::extractMatchingRegex),
+        ) const>(&bit7z::BitFileExtractor::extractMatchingRegex)),
         py::arg("inArchive"), py::arg("regex"), py::arg("outDir")="",
-        py::arg("policy")=bit7z::FilterPolicy::Include)
+        py::arg("policy")=bit7z::FilterPolicy::Include,
+        py::call_guard<py::gil_scoped_release>())
 
         //void extractMatchingRegex( const tstring& inArchive, const tstring& regex, vector< byte_t >& outBuffer, FilterPolicy policy = FilterPolicy::Include ) const
         //...
 
         //FileCallback fileCallback() const
-        .def("file_callback", &bit7z::BitFileExtractor::fileCallback)
+        .def("file_callback", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::fileCallback))
 
         //[virtual] const BitInFormat &override format() const noexcept
         .def("format", &bit7z::BitFileExtractor::format, py::return_value_policy::reference_internal)
 
         //bool isPasswordDefined() const noexcept
-        .def("is_password_defined", &bit7z::BitFileExtractor::isPasswordDefined)
+        .def("is_password_defined", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::isPasswordDefined))
 
         //const Bit7zLibrary & library() const noexcept
         .def("library", &bit7z::BitFileExtractor::library, py::return_value_policy::reference_internal)
 
         //OverwriteMode overwriteMode() const
-        .def("overwrite_mode", &bit7z::BitFileExtractor::overwriteMode)
+        .def("overwrite_mode", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::overwriteMode))
 
         //tstring password() const
-        .def("password", &bit7z::BitFileExtractor::password)
+        .def("password", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::password))
 
         //PasswordCallback passwordCallback() const
-        .def("password_callback", &bit7z::BitFileExtractor::passwordCallback)
+        .def("password_callback", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::passwordCallback))
 
         //ProgressCallback progressCallback() const
-        .def("progress_callback", &bit7z::BitFileExtractor::progressCallback)
+        .def("progress_callback", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::progressCallback))
 
         //RatioCallback ratioCallback() const
-        .def("ratio_callback", &bit7z::BitFileExtractor::ratioCallback)
+        .def("ratio_callback", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::ratioCallback))
 
         //bool retainDirectories() const noexcept
-        .def("retain_directories", &bit7z::BitFileExtractor::retainDirectories)
+        .def("retain_directories", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::retainDirectories))
 
         //void setFileCallback( const FileCallback& callback )
-        .def("set_file_callback", &bit7z::BitFileExtractor::setFileCallback)
+        .def("set_file_callback", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setFileCallback))
 
         //void setOverwriteMode( OverwriteMode mode )
-        .def("set_overwrite_mode", &bit7z::BitFileExtractor::setOverwriteMode)
+        .def("set_overwrite_mode", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setOverwriteMode))
 
         //[virtual] void setPassword( const tstring& password )
-        .def("set_password", &bit7z::BitFileExtractor::setPassword)
+        .def("set_password", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setPassword))
 
         //void setPasswordCallback( const PasswordCallback& callback )
-        .def("set_password_callback", &bit7z::BitFileExtractor::setPasswordCallback)
+        .def("set_password_callback", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setPasswordCallback))
 
         //void setProgressCallback( const ProgressCallback& callback )
-        .def("set_progress_callback", &bit7z::BitFileExtractor::setProgressCallback)
+        .def("set_progress_callback", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setProgressCallback))
 
         //void setRatioCallback( const RatioCallback& callback )
-        .def("set_ratio_callback", &bit7z::BitFileExtractor::setRatioCallback)
+        .def("set_ratio_callback", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setRatioCallback))
 
         //void setRetainDirectories( bool retain ) noexcept
-        .def("set_retain_directories", &bit7z::BitFileExtractor::setRetainDirectories)
+        .def("set_retain_directories", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setRetainDirectories))
 
         //void setTotalCallback( const TotalCallback& callback )
-        .def("set_total_callback", &bit7z::BitFileExtractor::setTotalCallback)
+        .def("set_total_callback", locked_setter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::setTotalCallback))
 
         //void test( const tstring& inArchive ) const
-        .def("test", &bit7z::BitFileExtractor::test)
+        .def("test", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, bool useMmap,
+                        const CancelToken* token, double timeout){
+            CancelScope scope(token, timeout);
+            HandlerUse use(&self);
+            if (!useMmap && !scope.active()) {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                reader.test();
+                return;
+            }
+            auto run = [&](bit7z::BitArchiveReader& reader){
+                apply_settings(self, reader);
+                reader.setProgressCallback(scope.wrap(self.progressCallback()));
+                try {
+                    reader.test();
+                } catch (...) {
+                    if (!scope.stopped()) {
+                        throw;
+                    }
+                    scope.raise();
+                }
+            };
+            if (!useMmap) {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                run(reader);
+                return;
+            }
+            MappedArchive archive(inArchive, os::Advice::Sequential);
+            bit7z::BitArchiveReader reader(self.library(), archive.stream, input_format(self, inArchive));
+            run(reader);
+        },
+        py::arg("inArchive"), py::arg("useMmap")=false, py::arg("token")=nullptr, py::arg("timeout")=0.0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Verify an archive with several threads and report the failed items instead of raising
+        //(The items of a non-solid archive are checked concurrently, a solid archive is tested by one thread)
+        .def("verify", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, unsigned threads){
+            HandlerUse use(&self);
+            return verify_archives(self, {inArchive}, threads);
+        },
+        py::arg("inArchive"), py::arg("threads")=0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Verify many archives with one pool of threads, shared by the archives and their items
+        .def("verify_many", [](const bit7z::BitFileExtractor& self, const std::vector<tstring>& inArchives, unsigned threads){
+            HandlerUse use(&self);
+            return verify_archives(self, inArchives, threads);
+        },
+        py::arg("inArchives"), py::arg("threads")=0,
+        py::call_guard<py::gil_scoped_release>())
+
+        //List the items of an archive (like BitArchiveReader::items())
+        //(With native, a zip or tar archive is listed by the native parser, without opening a 7-Zip handler)
+        .def("list_items", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, bool useMmap, bool native){
+            HandlerUse use(&self);
+            std::vector<ArchiveItem> items;
+            const bit7z::BitInFormat& format = input_format(self, inArchive);
+            if (native && (format == bit7z::BitFormat::Zip || format == bit7z::BitFormat::Tar) && list_native(inArchive, items)) {
+                return items;
+            }
+            auto collect = [&items](const bit7z::BitArchiveReader& reader){
+                items.reserve(reader.itemsCount());
+                for (const auto& item : reader) {
+                    items.push_back(to_archive_item(item));
+                }
+            };
+            if (useMmap) {
+                //Listing only touches the headers, so no read-ahead of the whole archive
+                MappedArchive archive(inArchive, os::Advice::Random);
+                bit7z::BitArchiveReader reader(self.library(), archive.stream, input_format(self, inArchive));
+                apply_settings(self, reader);
+                collect(reader);
+            } else {
+                bit7z::BitArchiveReader reader(self.library(), inArchive, input_format(self, inArchive));
+                apply_settings(self, reader);
+                collect(reader);
+            }
+            return items;
+        },
+        py::arg("inArchive"), py::arg("useMmap")=false, py::arg("native")=false,
+        py::call_guard<py::gil_scoped_release>())
+
+        //Decode the items on a background thread into a bounded queue: for name, data in extractor.iter_items(archive)
+        //(Directories are skipped; the queued buffers never exceed maxQueueBytes, except for a single chunk.
+        //A solid archive which decodes to at most maxSolidBytes and has no duplicate paths is decoded in one pass into
+        //memory, so up to maxSolidBytes are held for it whatever maxQueueBytes is; other ones are decoded item by item)
+        //The stream keeps the extractor (and so the library) alive
+        .def("iter_items", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, size_t chunkSize, size_t maxQueueBytes,
+                              uint64_t maxSolidBytes){
+            py::gil_scoped_release release;
+            HandlerUse use(&self);
+            return ItemStreamHolder(new ItemStream(self, inArchive, chunkSize, maxQueueBytes, maxSolidBytes));
+        },
+        py::arg("inArchive"), py::arg("chunkSize")=4*1024*1024, py::arg("maxQueueBytes")=64*1024*1024,
+        py::arg("maxSolidBytes")=256*1024*1024,
+        py::keep_alive<0, 1>())
+
+        //Decode an archive and the archives nested in it (found by their signatures) in memory, without temporary files:
+        //for path, data in extractor.iter_nested(archive): ... where path continues through the containers, like
+        //"outer/a.tar.gz/a.tar/b.7z/file.txt" (each item comes in one piece; an inner archive deeper than maxDepth
+        //comes as a file, and decoding more than maxBytes at all levels together raises ValueError)
+        .def("iter_nested", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, unsigned maxDepth,
+                               uint64_t maxBytes, const std::set<std::string>& formats, size_t maxQueueBytes){
+            NestedLimits limits;
+            limits.maxDepth = maxDepth;
+            limits.maxBytes = maxBytes;
+            limits.formats = formats;
+            py::gil_scoped_release release;
+            HandlerUse use(&self);
+            return ItemStreamHolder(nested_stream(self, inArchive, limits, maxQueueBytes));
+        },
+        py::arg("inArchive"), py::arg("maxDepth")=8, py::arg("maxBytes")=1ull<<32, py::arg("formats")=std::set<std::string>(),
+        py::arg("maxQueueBytes")=64*1024*1024,
+        py::keep_alive<0, 1>())
+
+        //The same as iter_nested, collected into a dict of path: bytes
+        .def("extract_nested_to_memory", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, unsigned maxDepth,
+                                            uint64_t maxBytes, const std::set<std::string>& formats){
+            NestedLimits limits;
+            limits.maxDepth = maxDepth;
+            limits.maxBytes = maxBytes;
+            limits.formats = formats;
+            std::vector<ItemChunk> chunks;
+            {
+                py::gil_scoped_release release;
+                //Destroyed here, without the GIL already
+                std::unique_ptr<ItemStream> stream;
+                {
+                    HandlerUse use(&self);
+                    stream.reset(nested_stream(self, inArchive, limits, std::numeric_limits<size_t>::max()));
+                }
+                ItemChunk chunk;
+                while (stream->next(chunk)) {
+                    chunks.push_back(std::move(chunk));
+                }
+            }
+            py::dict result;
+            for (const auto& chunk : chunks) {
+                result[py::str(chunk.item.path)] = py::bytes(chunk.data.data(), chunk.data.size());
+            }
+            return result;
+        },
+        py::arg("inArchive"), py::arg("maxDepth")=8, py::arg("maxBytes")=1ull<<32, py::arg("formats")=std::set<std::string>())
+
+        //Open one item as a seekable file object: with extractor.open(archive, "data/table.parquet") as f: f.seek(-8, 2)
+        //(The decoded chunks of chunkSize bytes go to a cache shared by all the open items, see set_item_cache_size;
+        //the decoding runs up to readAhead chunks ahead of the reads)
+        .def("open", [](const bit7z::BitFileExtractor& self, const tstring& inArchive, const tstring& itemPath,
+                        size_t chunkSize, size_t readAhead){
+            py::gil_scoped_release release;
+            HandlerUse use(&self);
+            return ArchiveFileHolder(new ArchiveFile(self, inArchive, itemPath, chunkSize, readAhead));
+        },
+        py::arg("inArchive"), py::arg("itemPath"), py::arg("chunkSize")=1024*1024, py::arg("readAhead")=4,
+        py::keep_alive<0, 1>())
 
         //TotalCallback totalCallback() const
-        .def("total_callback", &bit7z::BitFileExtractor::totalCallback)
+        .def("total_callback", locked_getter<bit7z::BitFileExtractor>(&bit7z::BitFileExtractor::totalCallback))
         ;
+
+    //The buffer pools used by extract_to_memory and extract_item (one pool per thread)
+    mod.def("buffer_pool_stats", [](){
+        auto stats = ThreadBufferPools<char>::stats();
+        py::dict result;
+        result["hits"] = stats.hits;
+        result["misses"] = stats.misses;
+        result["hit_rate"] = (stats.hits + stats.misses) ? double(stats.hits) / double(stats.hits + stats.misses) : 0.0;
+        result["released"] = stats.released;
+        result["dropped"] = stats.dropped;
+        result["held_bytes"] = stats.held_bytes;
+        result["held_buffers"] = stats.held_buffers;
+        return result;
+    }, "Returns the counters of the buffer pools of all threads, summed up.");
+
+    mod.def("set_buffer_pool_limits", &ThreadBufferPools<char>::set_limits,
+    py::arg("maxBytes"), py::arg("maxBuffers"),
+    "Sets the maximum bytes and the maximum number of buffers kept by the pool of each thread.");
+
+    //The cache of the decoded chunks of the files made by BitFileExtractor.open (shared by all of them)
+    mod.def("item_cache_stats", [](){
+        BlockCache::Stats stats = BlockCache::global().stats();
+        py::dict result;
+        result["capacity"] = stats.capacity;
+        result["used"] = stats.used;
+        result["entries"] = stats.entries;
+        result["hits"] = stats.hits;
+        result["misses"] = stats.misses;
+        return result;
+    }, "Returns the size, the usage and the counters of the cache of decoded chunks.");
+
+    mod.def("set_item_cache_size", [](size_t maxBytes){
+        BlockCache::global().set_capacity(maxBytes);
+    },
+    py::arg("maxBytes"),
+    "Sets the memory limit of the cache of decoded chunks (256 MiB by default); 0 disables the cache.");
+
+    mod.def("clear_item_cache", [](){
+        BlockCache::global().clear();
+    }, "Drops all the decoded chunks.");
+
+    mod.def("trim_buffer_pools", &ThreadBufferPools<char>::trim, py::arg("maxBytes")=0,
+    "Frees the pooled buffers until each pool keeps at most maxBytes.");
 }
 
 #ifndef BIT7Z_PYTHON_MAIN //The macro of the main binding file
@@ -136,12 +840,16 @@ void init_BitFileExtractor(py::module_& mod){
 #include <Enums_EVP.cpp>
 #include <Bit7zLibrary_EVP.cpp>
 #include <BitFormat_EVP.cpp>
+#include <ArchiveItem_EVP.cpp>
+#include <Cancel_EVP.cpp>
 
 #ifdef PYTHON_NO_GIL //Compat Python 3.13+ free-threadind build
 PYBIND11_MODULE(bfext, mod, py::mod_gil_not_used()){
     init_lib(mod);
     init_enums(mod);
     init_formats(mod);
+    init_ArchiveItem(mod);
+    init_cancel(mod);
     init_BitFileExtractor(mod);
     mod.attr("VERSION_INFO") = VERSION_STRING;
 }
@@ -150,6 +858,8 @@ PYBIND11_MODULE(bfext, mod){
     init_lib(mod);
     init_enums(mod);
     init_formats(mod);
+    init_ArchiveItem(mod);
+    init_cancel(mod);
     init_BitFileExtractor(mod);
     mod.attr("VERSION_INFO") = VERSION_STRING;
 }
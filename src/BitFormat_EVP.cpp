@@ -14,6 +14,8 @@ License: This project is under the Apache-2.0 Lincense, see LICENSE for more det
 
 #include <API.hpp>
 #include <bitformat.hpp>
+#include <formatsniff.hpp>
+#include <LazyModule.hpp>
 
 void init_formats(py::module_& mod){
     py::class_<bit7z::BitInFormat>(mod, "BitInFormat")
@@ -27,60 +29,96 @@ void init_formats(py::module_& mod){
         .def("value", &bit7z::BitInOutFormat::value, "Returns the ID value of this BitOutFormat object.");
 
     // 导出格式常量 —— 使用 py::cast 并指定引用策略，避免拷贝不可拷贝对象
-    mod.attr("FORMAT_APM") = py::cast(bit7z::BitFormat::APM, py::return_value_policy::reference);
-    mod.attr("FORMAT_ARJ") = py::cast(bit7z::BitFormat::Arj, py::return_value_policy::reference);
-    mod.attr("FORMAT_AUTO") = py::cast(bit7z::BitFormat::Auto, py::return_value_policy::reference); // 已注释
-    mod.attr("FORMAT_BZIP2") = py::cast(bit7z::BitFormat::BZip2, py::return_value_policy::reference);
-    mod.attr("FORMAT_CAB") = py::cast(bit7z::BitFormat::Cab, py::return_value_policy::reference);
-    mod.attr("FORMAT_CHM") = py::cast(bit7z::BitFormat::Chm, py::return_value_policy::reference);
-    mod.attr("FORMAT_COFF") = py::cast(bit7z::BitFormat::COFF, py::return_value_policy::reference);
-    mod.attr("FORMAT_COMPOUND") = py::cast(bit7z::BitFormat::Compound, py::return_value_policy::reference);
-    mod.attr("FORMAT_CPIO") = py::cast(bit7z::BitFormat::Cpio, py::return_value_policy::reference);
-    mod.attr("FORMAT_CRAMFS") = py::cast(bit7z::BitFormat::CramFS, py::return_value_policy::reference);
-    mod.attr("FORMAT_DEB") = py::cast(bit7z::BitFormat::Deb, py::return_value_policy::reference);
-    mod.attr("FORMAT_DMG") = py::cast(bit7z::BitFormat::Dmg, py::return_value_policy::reference);
-    mod.attr("FORMAT_ELF") = py::cast(bit7z::BitFormat::Elf, py::return_value_policy::reference);
-    mod.attr("FORMAT_EXT") = py::cast(bit7z::BitFormat::Ext, py::return_value_policy::reference);
-    mod.attr("FORMAT_FAT") = py::cast(bit7z::BitFormat::Fat, py::return_value_policy::reference);
-    mod.attr("FORMAT_FLV") = py::cast(bit7z::BitFormat::Flv, py::return_value_policy::reference);
-    mod.attr("FORMAT_GPT") = py::cast(bit7z::BitFormat::GPT, py::return_value_policy::reference);
-    mod.attr("FORMAT_GZIP") = py::cast(bit7z::BitFormat::GZip, py::return_value_policy::reference);
-    mod.attr("FORMAT_HFS") = py::cast(bit7z::BitFormat::Hfs, py::return_value_policy::reference);
-    mod.attr("FORMAT_HXS") = py::cast(bit7z::BitFormat::Hxs, py::return_value_policy::reference);
-    mod.attr("FORMAT_IHEX") = py::cast(bit7z::BitFormat::IHex, py::return_value_policy::reference);
-    mod.attr("FORMAT_ISO") = py::cast(bit7z::BitFormat::Iso, py::return_value_policy::reference);
-    mod.attr("FORMAT_LZH") = py::cast(bit7z::BitFormat::Lzh, py::return_value_policy::reference);
-    mod.attr("FORMAT_LZMA") = py::cast(bit7z::BitFormat::Lzma, py::return_value_policy::reference);
-    mod.attr("FORMAT_LZMA86") = py::cast(bit7z::BitFormat::Lzma86, py::return_value_policy::reference);
-    mod.attr("FORMAT_MACHO") = py::cast(bit7z::BitFormat::Macho, py::return_value_policy::reference);
-    mod.attr("FORMAT_MBR") = py::cast(bit7z::BitFormat::Mbr, py::return_value_policy::reference);
-    mod.attr("FORMAT_MSLZ") = py::cast(bit7z::BitFormat::Mslz, py::return_value_policy::reference);
-    mod.attr("FORMAT_MUB") = py::cast(bit7z::BitFormat::Mub, py::return_value_policy::reference);
-    mod.attr("FORMAT_NSIS") = py::cast(bit7z::BitFormat::Nsis, py::return_value_policy::reference);
-    mod.attr("FORMAT_NTFS") = py::cast(bit7z::BitFormat::Ntfs, py::return_value_policy::reference);
-    mod.attr("FORMAT_PE") = py::cast(bit7z::BitFormat::Pe, py::return_value_policy::reference);
-    mod.attr("FORMAT_PPMD") = py::cast(bit7z::BitFormat::Ppmd, py::return_value_policy::reference);
-    mod.attr("FORMAT_QCOW") = py::cast(bit7z::BitFormat::QCow, py::return_value_policy::reference);
-    mod.attr("FORMAT_RAR") = py::cast(bit7z::BitFormat::Rar, py::return_value_policy::reference);
-    mod.attr("FORMAT_RAR5") = py::cast(bit7z::BitFormat::Rar5, py::return_value_policy::reference);
-    mod.attr("FORMAT_RPM") = py::cast(bit7z::BitFormat::Rpm, py::return_value_policy::reference);
-    mod.attr("FORMAT_7Z") = py::cast(bit7z::BitFormat::SevenZip, py::return_value_policy::reference);
-    mod.attr("FORMAT_SPLIT") = py::cast(bit7z::BitFormat::Split, py::return_value_policy::reference);
-    mod.attr("FORMAT_SQUASHFS") = py::cast(bit7z::BitFormat::SquashFS, py::return_value_policy::reference);
-    mod.attr("FORMAT_SWF") = py::cast(bit7z::BitFormat::Swf, py::return_value_policy::reference);
-    mod.attr("FORMAT_SWFC") = py::cast(bit7z::BitFormat::Swfc, py::return_value_policy::reference);
-    mod.attr("FORMAT_TAR") = py::cast(bit7z::BitFormat::Tar, py::return_value_policy::reference);
-    mod.attr("FORMAT_TE") = py::cast(bit7z::BitFormat::TE, py::return_value_policy::reference);
-    mod.attr("FORMAT_UDF") = py::cast(bit7z::BitFormat::Udf, py::return_value_policy::reference);
-    mod.attr("FORMAT_UEFIC") = py::cast(bit7z::BitFormat::UEFIc, py::return_value_policy::reference);
-    mod.attr("FORMAT_UEFIS") = py::cast(bit7z::BitFormat::UEFIs, py::return_value_policy::reference);
-    mod.attr("FORMAT_VDI") = py::cast(bit7z::BitFormat::VDI, py::return_value_policy::reference);
-    mod.attr("FORMAT_VHD") = py::cast(bit7z::BitFormat::Vhd, py::return_value_policy::reference);
-    mod.attr("FORMAT_VHDX") = py::cast(bit7z::BitFormat::Vhdx, py::return_value_policy::reference);
-    mod.attr("FORMAT_VMDK") = py::cast(bit7z::BitFormat::VMDK, py::return_value_policy::reference);
-    mod.attr("FORMAT_WIM") = py::cast(bit7z::BitFormat::Wim, py::return_value_policy::reference);
-    mod.attr("FORMAT_XAR") = py::cast(bit7z::BitFormat::Xar, py::return_value_policy::reference);
-    mod.attr("FORMAT_XZ") = py::cast(bit7z::BitFormat::Xz, py::return_value_policy::reference);
-    mod.attr("FORMAT_Z") = py::cast(bit7z::BitFormat::Z, py::return_value_policy::reference);
-    mod.attr("FORMAT_ZIP") = py::cast(bit7z::BitFormat::Zip, py::return_value_policy::reference);
+    //The constants are made on the first access (see LazyModule.hpp), each with the type of its format (BitInFormat or BitOutFormat)
+    LazyAttributes& lazy = lazy_attributes(mod);
+    auto add = [&lazy](const char* name, const auto& format){
+        lazy.add(name, [name, &format](py::module_& mod){
+            mod.attr(name) = py::cast(format, py::return_value_policy::reference);
+        });
+    };
+    add("FORMAT_APM", bit7z::BitFormat::APM);
+    add("FORMAT_ARJ", bit7z::BitFormat::Arj);
+    add("FORMAT_AUTO", bit7z::BitFormat::Auto); // 已注释
+    add("FORMAT_BZIP2", bit7z::BitFormat::BZip2);
+    add("FORMAT_CAB", bit7z::BitFormat::Cab);
+    add("FORMAT_CHM", bit7z::BitFormat::Chm);
+    add("FORMAT_COFF", bit7z::BitFormat::COFF);
+    add("FORMAT_COMPOUND", bit7z::BitFormat::Compound);
+    add("FORMAT_CPIO", bit7z::BitFormat::Cpio);
+    add("FORMAT_CRAMFS", bit7z::BitFormat::CramFS);
+    add("FORMAT_DEB", bit7z::BitFormat::Deb);
+    add("FORMAT_DMG", bit7z::BitFormat::Dmg);
+    add("FORMAT_ELF", bit7z::BitFormat::Elf);
+    add("FORMAT_EXT", bit7z::BitFormat::Ext);
+    add("FORMAT_FAT", bit7z::BitFormat::Fat);
+    add("FORMAT_FLV", bit7z::BitFormat::Flv);
+    add("FORMAT_GPT", bit7z::BitFormat::GPT);
+    add("FORMAT_GZIP", bit7z::BitFormat::GZip);
+    add("FORMAT_HFS", bit7z::BitFormat::Hfs);
+    add("FORMAT_HXS", bit7z::BitFormat::Hxs);
+    add("FORMAT_IHEX", bit7z::BitFormat::IHex);
+    add("FORMAT_ISO", bit7z::BitFormat::Iso);
+    add("FORMAT_LZH", bit7z::BitFormat::Lzh);
+    add("FORMAT_LZMA", bit7z::BitFormat::Lzma);
+    add("FORMAT_LZMA86", bit7z::BitFormat::Lzma86);
+    add("FORMAT_MACHO", bit7z::BitFormat::Macho);
+    add("FORMAT_MBR", bit7z::BitFormat::Mbr);
+    add("FORMAT_MSLZ", bit7z::BitFormat::Mslz);
+    add("FORMAT_MUB", bit7z::BitFormat::Mub);
+    add("FORMAT_NSIS", bit7z::BitFormat::Nsis);
+    add("FORMAT_NTFS", bit7z::BitFormat::Ntfs);
+    add("FORMAT_PE", bit7z::BitFormat::Pe);
+    add("FORMAT_PPMD", bit7z::BitFormat::Ppmd);
+    add("FORMAT_QCOW", bit7z::BitFormat::QCow);
+    add("FORMAT_RAR", bit7z::BitFormat::Rar);
+    add("FORMAT_RAR5", bit7z::BitFormat::Rar5);
+    add("FORMAT_RPM", bit7z::BitFormat::Rpm);
+    add("FORMAT_7Z", bit7z::BitFormat::SevenZip);
+    add("FORMAT_SPLIT", bit7z::BitFormat::Split);
+    add("FORMAT_SQUASHFS", bit7z::BitFormat::SquashFS);
+    add("FORMAT_SWF", bit7z::BitFormat::Swf);
+    add("FORMAT_SWFC", bit7z::BitFormat::Swfc);
+    add("FORMAT_TAR", bit7z::BitFormat::Tar);
+    add("FORMAT_TE", bit7z::BitFormat::TE);
+    add("FORMAT_UDF", bit7z::BitFormat::Udf);
+    add("FORMAT_UEFIC", bit7z::BitFormat::UEFIc);
+    add("FORMAT_UEFIS", bit7z::BitFormat::UEFIs);
+    add("FORMAT_VDI", bit7z::BitFormat::VDI);
+    add("FORMAT_VHD", bit7z::BitFormat::Vhd);
+    add("FORMAT_VHDX", bit7z::BitFormat::Vhdx);
+    add("FORMAT_VMDK", bit7z::BitFormat::VMDK);
+    add("FORMAT_WIM", bit7z::BitFormat::Wim);
+    add("FORMAT_XAR", bit7z::BitFormat::Xar);
+    add("FORMAT_XZ", bit7z::BitFormat::Xz);
+    add("FORMAT_Z", bit7z::BitFormat::Z);
+    add("FORMAT_ZIP", bit7z::BitFormat::Zip);
+
+    //Detect the format by the signatures at the head and the tail of the file, without the 7-Zip library
+    //(The result is cached per path, and reused while the size and the modification time are unchanged)
+    //(The detector names a format by the suffix of its FORMAT_* constant, which is looked up in the module)
+    py::handle module = mod;
+    mod.def("detect_format", [module](const std::string& path, bool useCache){
+        sniff::Detection detection;
+        {
+            py::gil_scoped_release release;
+            detection = useCache ? sniff::FormatCache::global().detect(path) : sniff::detect_file(path);
+        }
+        if (detection.format.empty()) {
+            return module.attr("FORMAT_AUTO");
+        }
+        return py::getattr(module, ("FORMAT_" + detection.format).c_str(), module.attr("FORMAT_AUTO"));
+    },
+    py::arg("path"), py::arg("useCache")=true,
+    "Returns the format detected from the file signature, or FORMAT_AUTO if it is unknown.");
+
+    mod.def("clear_format_cache", [](){
+        sniff::FormatCache::global().clear();
+    }, "Forgets the cached format detections.");
+
+    mod.def("format_cache_stats", [](){
+        py::dict result;
+        result["hits"] = sniff::FormatCache::global().hits();
+        result["misses"] = sniff::FormatCache::global().misses();
+        return result;
+    }, "Returns the hits and the misses of the format detection cache.");
 }
\ No newline at end of file
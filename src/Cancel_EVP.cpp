@@ -0,0 +1,28 @@
+/*
+This file binds the CancellationToken and the OperationCancelled exception, which stop the long-running operations.
+(The token is checked by the native progress callbacks, so a cancellation never waits for the GIL)
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+//My headers
+#include <API.hpp>
+#include <ArchiveTools.hpp>
+
+void init_cancel(py::module_& mod){
+    py::register_exception<OperationCancelled>(mod, "OperationCancelled", PyExc_RuntimeError);
+
+    py::class_<CancelToken>(mod, "CancellationToken",
+        "A cancellation flag with an optional deadline. It may be shared by any number of threads and operations.")
+        .def(py::init([](double timeout){
+            auto token = new CancelToken();
+            token->setTimeout(timeout);
+            return token;
+        }), py::arg("timeout")=0.0, "Creates a token; with a timeout, it is cancelled after the given seconds.")
+        .def("cancel", &CancelToken::cancel, "Stops the operations using this token (it can be called from any thread).")
+        .def("set_timeout", &CancelToken::setTimeout, py::arg("seconds"), "Cancels the token after the given seconds from now (0 removes the deadline).")
+        .def("reset", &CancelToken::reset, "Clears the cancellation and the deadline, so the token can be used again.")
+        .def_property_readonly("cancelled", &CancelToken::cancelled, "Whether the token is cancelled or its deadline has passed.")
+        .def_property_readonly("expired", &CancelToken::expired, "Whether the deadline of the token has passed.");
+}
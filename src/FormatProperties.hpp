@@ -0,0 +1,313 @@
+/*
+This file provides the typed format properties of the compressors (the 7-Zip method switches like mt, mf, fb, s, qs, f...).
+(bit7z only takes them as wide string literals, so the known properties are listed here with their types, ranges and formats)
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+#ifndef FORMAT_PROPERTIES_HPP
+#define FORMAT_PROPERTIES_HPP
+
+#include <API.hpp>
+#include <handlerusage.hpp>
+
+#include <map>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <variant>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+//bit7z headers
+#include <bitabstractarchivecreator.hpp>
+#include <bitformat.hpp>
+
+//The value of a property: a switch, a number or a string (like "bt4" or "1g")
+using FormatPropertyValue = std::variant<bool, uint32_t, std::string>;
+using FormatProperties = std::map<std::string, FormatPropertyValue>;
+
+//Sets one property on an archive creator, the name must be a literal for bit7z
+template<std::size_t N>
+void set_format_property(bit7z::BitAbstractArchiveCreator& creator, const wchar_t (&name)[N], const FormatPropertyValue& value){
+    if (const bool* flag = std::get_if<bool>(&value)) {
+        creator.setFormatProperty(name, *flag);
+    } else if (const uint32_t* number = std::get_if<uint32_t>(&value)) {
+        creator.setFormatProperty(name, *number);
+    } else {
+        const std::string& text = std::get<std::string>(value);
+        //The values are checked to be ASCII, so they are widened byte by byte
+        const std::wstring wide(text.begin(), text.end());
+        creator.setFormatProperty(name, wide);
+    }
+}
+
+#define FORMAT_PROPERTY_SETTER(name) \
+    [](bit7z::BitAbstractArchiveCreator& creator, const FormatPropertyValue& value){ set_format_property(creator, L##name, value); }
+
+struct FormatPropertySpec {
+    enum Kind : unsigned { Bool = 1, UInt = 2, String = 4 };
+
+    const char* name;                                 //The 7-Zip name of the property
+    std::vector<std::string> aliases;                 //The command line spellings (like mmt for mt)
+    unsigned kinds;
+    uint32_t min;
+    uint32_t max;
+    std::vector<std::string> choices;                 //The accepted strings, empty for free strings
+    bool (*check)(const std::string&);                //Checks a free string, or nullptr
+    std::vector<const bit7z::BitInOutFormat*> formats;
+    void (*set)(bit7z::BitAbstractArchiveCreator&, const FormatPropertyValue&);
+    const char* help;
+
+    bool supports(const bit7z::BitInOutFormat& format) const {
+        for (const auto* supported : formats) {
+            if (*supported == format) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+//A solid block limit: e, or numbers with the units b/k/m/g/t (bytes) or f (files), like 1g, 100f, 4g100fe
+inline bool is_solid_limit(const std::string& text){
+    bool digits = false;
+    for (char ch : text) {
+        char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        if (std::isdigit(static_cast<unsigned char>(ch))) {
+            digits = true;
+        } else if (lower == 'e' && !digits) {
+            continue;
+        } else if (digits && std::string("bkmgtf").find(lower) != std::string::npos) {
+            digits = false;
+        } else {
+            return false;
+        }
+    }
+    return !text.empty() && !digits;
+}
+
+//A filter with a parameter: Delta:N (N from 1 to 256)
+inline bool is_param_filter(const std::string& text){
+    if (text.size() < 7 || text.size() > 9) {
+        return false;
+    }
+    std::string head = text.substr(0, 6);
+    for (auto& ch : head) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    if (head != "delta:") {
+        return false;
+    }
+    unsigned long distance = 0;
+    for (size_t i = 6; i < text.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(text[i]))) {
+            return false;
+        }
+        distance = distance * 10 + static_cast<unsigned long>(text[i] - '0');
+    }
+    return distance >= 1 && distance <= 256;
+}
+
+//The known properties, the ones which tune the speed against the ratio
+inline const std::vector<FormatPropertySpec>& format_property_specs(){
+    using namespace bit7z;
+    using Spec = FormatPropertySpec;
+    static const std::vector<FormatPropertySpec> specs = {
+        {"x", {}, Spec::UInt, 0, 9, {}, nullptr,
+         {&BitFormat::SevenZip, &BitFormat::Zip, &BitFormat::GZip, &BitFormat::BZip2, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("x"), "compression level, 0 (store) to 9 (ultra)"},
+        {"mt", {"mmt"}, Spec::Bool | Spec::UInt, 1, 256, {}, nullptr,
+         {&BitFormat::SevenZip, &BitFormat::Zip, &BitFormat::BZip2, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("mt"), "multithreading, True/False or the number of threads"},
+        {"mf", {}, Spec::String, 0, 0, {"bt2", "bt3", "bt4", "bt5", "hc4", "hc5"}, nullptr,
+         {&BitFormat::SevenZip, &BitFormat::Zip, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("mf"), "match finder of LZMA/LZMA2, hc4 is faster and bt4 compresses better"},
+        {"fb", {}, Spec::UInt, 3, 273, {}, nullptr,
+         {&BitFormat::SevenZip, &BitFormat::Zip, &BitFormat::GZip, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("fb"), "fast bytes (5-273 for LZMA, 3-258 for Deflate), fewer are faster"},
+        {"mc", {}, Spec::UInt, 1, 1000000000, {}, nullptr,
+         {&BitFormat::SevenZip, &BitFormat::Zip, &BitFormat::GZip, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("mc"), "match finder cycles, fewer are faster"},
+        {"pass", {}, Spec::UInt, 1, 15, {}, nullptr,
+         {&BitFormat::Zip, &BitFormat::GZip},
+         FORMAT_PROPERTY_SETTER("pass"), "passes of Deflate, fewer are faster"},
+        {"s", {"ms"}, Spec::Bool | Spec::String, 0, 0, {}, &is_solid_limit,
+         {&BitFormat::SevenZip},
+         FORMAT_PROPERTY_SETTER("s"), "solid mode, True/False or a block limit like 1g, 100f or e (per extension)"},
+        {"qs", {"mqs"}, Spec::Bool, 0, 0, {}, nullptr,
+         {&BitFormat::SevenZip},
+         FORMAT_PROPERTY_SETTER("qs"), "sorts the files by type in solid blocks"},
+        {"f", {}, Spec::Bool | Spec::String, 0, 0,
+         {"BCJ", "BCJ2", "ARM64", "ARM", "ARMT", "PPC", "SPARC", "IA64", "RISCV"}, &is_param_filter,
+         {&BitFormat::SevenZip, &BitFormat::Xz},
+         FORMAT_PROPERTY_SETTER("f"), "filter for executables, True for the automatic one, False, or BCJ2, ARM64, Delta:4..."},
+        {"hc", {"mhc"}, Spec::Bool, 0, 0, {}, nullptr,
+         {&BitFormat::SevenZip},
+         FORMAT_PROPERTY_SETTER("hc"), "compresses the headers"},
+        {"yx", {"myx"}, Spec::UInt, 0, 9, {}, nullptr,
+         {&BitFormat::SevenZip},
+         FORMAT_PROPERTY_SETTER("yx"), "file analysis level, 0 turns the analysis off"},
+    };
+    return specs;
+}
+
+#undef FORMAT_PROPERTY_SETTER
+
+inline std::string lower_ascii(std::string text){
+    for (auto& ch : text) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    return text;
+}
+
+//The property of a name or an alias (case-insensitive), or nullptr
+inline const FormatPropertySpec* find_format_property(const std::string& name){
+    std::string key = lower_ascii(name);
+    for (const auto& spec : format_property_specs()) {
+        if (key == spec.name) {
+            return &spec;
+        }
+        for (const auto& alias : spec.aliases) {
+            if (key == alias) {
+                return &spec;
+            }
+        }
+    }
+    return nullptr;
+}
+
+//Checks a property against a format and returns its normalized value
+//(It throws std::invalid_argument, so that the whole set is checked before anything is changed)
+inline FormatPropertyValue validate_format_property(const FormatPropertySpec& spec, const bit7z::BitInOutFormat& format,
+                                                    const FormatPropertyValue& value){
+    std::string name = spec.name;
+    if (!spec.supports(format)) {
+        throw std::invalid_argument("The format property '" + name + "' is not supported by this format");
+    }
+    if (const bool* flag = std::get_if<bool>(&value)) {
+        if (!(spec.kinds & FormatPropertySpec::Bool)) {
+            throw std::invalid_argument("The format property '" + name + "' is not a switch (" + spec.help + ")");
+        }
+        return *flag;
+    }
+    if (const uint32_t* number = std::get_if<uint32_t>(&value)) {
+        if (!(spec.kinds & FormatPropertySpec::UInt)) {
+            throw std::invalid_argument("The format property '" + name + "' is not a number (" + spec.help + ")");
+        }
+        if (*number < spec.min || *number > spec.max) {
+            throw std::invalid_argument("The format property '" + name + "' must be from " + std::to_string(spec.min) +
+                                        " to " + std::to_string(spec.max) + ", got " + std::to_string(*number));
+        }
+        return *number;
+    }
+    const std::string& text = std::get<std::string>(value);
+    if (!(spec.kinds & FormatPropertySpec::String)) {
+        throw std::invalid_argument("The format property '" + name + "' is not a string (" + spec.help + ")");
+    }
+    for (const auto& choice : spec.choices) {
+        if (lower_ascii(choice) == lower_ascii(text)) {
+            return choice;
+        }
+    }
+    if (spec.check != nullptr && spec.check(text)) {
+        return text;
+    }
+    std::string message = "Invalid value '" + text + "' of the format property '" + name + "' (" + spec.help + ")";
+    if (!spec.choices.empty()) {
+        message += ", expected one of:";
+        for (const auto& choice : spec.choices) {
+            message += " " + choice;
+        }
+    }
+    throw std::invalid_argument(message);
+}
+
+//Checks a set of properties given by any names, the result is keyed by the 7-Zip names
+inline FormatProperties validate_format_properties(const bit7z::BitInOutFormat& format,
+                                                   const std::vector<std::pair<std::string, FormatPropertyValue>>& properties){
+    FormatProperties result;
+    for (const auto& property : properties) {
+        const FormatPropertySpec* spec = find_format_property(property.first);
+        if (spec == nullptr) {
+            std::string message = "Unknown format property '" + property.first + "', the known ones are:";
+            for (const auto& known : format_property_specs()) {
+                message += std::string(" ") + known.name;
+            }
+            throw std::invalid_argument(message);
+        }
+        result[spec->name] = validate_format_property(*spec, format, property.second);
+    }
+    return result;
+}
+
+//Sets checked properties on a compressor or an archive writer
+inline void apply_format_properties(bit7z::BitAbstractArchiveCreator& creator, const FormatProperties& properties){
+    for (const auto& property : properties) {
+        const FormatPropertySpec* spec = find_format_property(property.first);
+        if (spec != nullptr) {
+            spec->set(creator, property.second);
+        }
+    }
+}
+
+//The properties set on each compressor, since bit7z cannot read them back
+//(The entry of a compressor is dropped when the compressor is deleted, see HandlerDeleter)
+class FormatPropertyStore {
+public:
+    static FormatPropertyStore& global() {
+        static FormatPropertyStore store;
+        return store;
+    }
+
+    void merge(const void* handler, const FormatProperties& properties) {
+        if (properties.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        FormatProperties& stored = mProperties[handler];
+        for (const auto& property : properties) {
+            stored[property.first] = property.second;
+        }
+    }
+
+    FormatProperties get(const void* handler) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mProperties.find(handler);
+        return it == mProperties.end() ? FormatProperties() : it->second;
+    }
+
+    void erase(const void* handler) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mProperties.erase(handler);
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::unordered_map<const void*, FormatProperties> mProperties;
+};
+
+//Deletes a handler together with what is recorded for its address
+//(A handler checked out from the pool of a preset is offered back to the pool first, see HandlerPreset::checkout)
+template<typename Handler>
+struct HandlerDeleter {
+    std::function<bool(Handler*)> recycle;
+
+    void operator()(Handler* handler) const {
+        if (recycle && recycle(handler)) {
+            return;
+        }
+        FormatPropertyStore::global().erase(handler);
+        HandlerRegistry::global().restore(handler);
+        delete handler;
+    }
+};
+
+//The holder of the bound handlers (and of the handlers made by the presets)
+template<typename Handler>
+using HandlerHolder = std::unique_ptr<Handler, HandlerDeleter<Handler>>;
+
+#endif
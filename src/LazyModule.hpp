@@ -0,0 +1,125 @@
+/*
+This file provides the lazy attributes of a module, which are made on the first access through the module __getattr__ (PEP 562).
+(Importing the module only registers the names, so the rarely used enums and constants cost nothing until they are used)
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+#ifndef LAZY_MODULE_HPP
+#define LAZY_MODULE_HPP
+
+#include <API.hpp>
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <functional>
+
+class LazyAttributes {
+public:
+    //A factory defines its attribute on the module (it may define other attributes too, like a whole enum)
+    using Factory = std::function<void(py::module_&)>;
+
+    void add(const std::string& name, Factory factory) {
+        std::lock_guard<std::recursive_mutex> lock(mMutex);
+        mFactories[name] = std::move(factory);
+    }
+
+    //Makes the attribute and returns it, or returns null when the name is not lazy
+    //(The factory runs once, even if several threads ask for the attribute at the same time)
+    py::object get(py::module_& mod, const std::string& name) {
+        std::unique_lock<std::recursive_mutex> lock(mMutex, std::defer_lock);
+        {
+            //Another thread may hold the lock while it waits for the GIL
+            py::gil_scoped_release release;
+            lock.lock();
+        }
+        auto it = mFactories.find(name);
+        if (it == mFactories.end()) {
+            return py::object();
+        }
+        //Looked up in the module dict: hasattr or attr would call the module __getattr__ again for a missing name
+        py::dict dict = mod.attr("__dict__");
+        if (!dict.contains(name)) {
+            it->second(mod);
+        }
+        if (!dict.contains(name)) {
+            return py::object();
+        }
+        return dict[name.c_str()];
+    }
+
+    //The lazy names which do not begin with an underscore
+    std::set<std::string> publicNames() {
+        std::set<std::string> result;
+        for (const auto& name : names()) {
+            if (name[0] != '_') {
+                result.insert(name);
+            }
+        }
+        return result;
+    }
+
+    std::set<std::string> names() {
+        std::lock_guard<std::recursive_mutex> lock(mMutex);
+        std::set<std::string> result;
+        for (const auto& factory : mFactories) {
+            result.insert(factory.first);
+        }
+        return result;
+    }
+
+private:
+    //Recursive, since a factory may read the names (like the one of __all__)
+    std::recursive_mutex mMutex;
+    std::map<std::string, Factory> mFactories;
+};
+
+//The lazy attributes of a module; the first call defines the __getattr__ and the __dir__ of the module
+inline LazyAttributes& lazy_attributes(py::module_& mod){
+    static std::map<std::string, std::shared_ptr<LazyAttributes>> modules;
+    std::string key = mod.attr("__name__").cast<std::string>();
+    auto it = modules.find(key);
+    if (it != modules.end()) {
+        return *it->second;
+    }
+    std::shared_ptr<LazyAttributes> attributes(new LazyAttributes());
+    modules[key] = attributes;
+
+    //The module is referenced weakly by the functions, since they are stored in the module itself
+    PyObject* module = mod.ptr();
+    mod.def("__getattr__", [attributes, module](const std::string& name){
+        py::module_ self = py::reinterpret_borrow<py::module_>(module);
+        py::object value = attributes->get(self, name);
+        if (!value) {
+            throw py::attribute_error("module '" + self.attr("__name__").cast<std::string>() + "' has no attribute '" + name + "'");
+        }
+        return value;
+    });
+    mod.def("__dir__", [attributes, module](){
+        py::module_ self = py::reinterpret_borrow<py::module_>(module);
+        std::set<std::string> names = attributes->names();
+        for (py::handle key : self.attr("__dict__")) {
+            names.insert(key.cast<std::string>());
+        }
+        return std::vector<std::string>(names.begin(), names.end());
+    });
+
+    //from module import * reads __all__, which lists the lazy names too (importing all of them then)
+    LazyAttributes* lazy = attributes.get();
+    attributes->add("__all__", [lazy](py::module_& self){
+        std::set<std::string> names = lazy->publicNames();
+        for (py::handle key : self.attr("__dict__")) {
+            std::string name = key.cast<std::string>();
+            if (name[0] != '_') {
+                names.insert(name);
+            }
+        }
+        self.attr("__all__") = std::vector<std::string>(names.begin(), names.end());
+    });
+    return *lazy;
+}
+
+#endif
@@ -0,0 +1,160 @@
+/*
+This file binds the fast file system helpers of pyos, which are used to prepare the inputs and outputs of archives.
+(pyos is our Python style system API library, see include/pyos.hpp)
+Author: ZhouSicheng-2011
+Time: 2026-10-18
+License: This project is under the Apache-2.0 Lincense, see LICENSE for more details.
+*/
+
+//My headers
+#include <API.hpp>
+#include <pybind11/native_enum.h>
+
+#include <mutex>
+#include <memory>
+
+//A mapped file which counts the buffers exported to Python
+//(A memoryview keeps the MappedFile object alive, but close() would still unmap the memory it points at.
+//The module runs without the GIL, so the count and close() are guarded by a mutex)
+struct ExportedMappedFile : os::MappedFile {
+    std::mutex mutex;
+    size_t exports = 0;
+};
+
+static int mapped_getbuffer(PyObject* obj, Py_buffer* view, int flags){
+    ExportedMappedFile* mapped = nullptr;
+    try {
+        mapped = py::cast<ExportedMappedFile*>(py::handle(obj));
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_BufferError, e.what());
+        view->obj = nullptr;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(mapped->mutex);
+    static char empty = 0;
+    void* data = mapped->size() != 0 ? const_cast<char*>(mapped->data()) : &empty;
+    //Fails with BufferError when a writable buffer is requested
+    if (PyBuffer_FillInfo(view, obj, data, static_cast<Py_ssize_t>(mapped->size()), 1, flags) != 0) {
+        return -1;
+    }
+    ++mapped->exports;
+    return 0;
+}
+
+static void mapped_releasebuffer(PyObject* obj, Py_buffer*){
+    try {
+        ExportedMappedFile* mapped = py::cast<ExportedMappedFile*>(py::handle(obj));
+        std::lock_guard<std::mutex> lock(mapped->mutex);
+        if (mapped->exports != 0) {
+            --mapped->exports;
+        }
+    } catch (const std::exception&) {
+    }
+}
+
+void init_pyos(py::module_& mod){
+    //Bind the scanned entry of pyos (like os.DirEntry, but the stat result is already filled)
+    py::class_<os::DirEntry>(mod, "DirEntry")
+        .def_readonly("path", &os::DirEntry::path, "The full path of the entry.")
+        .def_readonly("size", &os::DirEntry::size, "The size of the entry in bytes.")
+        .def_readonly("mtime", &os::DirEntry::mtime, "The last modification time (Unix timestamp).")
+        .def_readonly("mode", &os::DirEntry::mode, "The st_mode of the entry, including the file type bits.")
+        .def_readonly("inode", &os::DirEntry::inode, "The inode number of the entry (0 on Windows).")
+        .def_readonly("children", &os::DirEntry::children, "The number of entries of a directory on disk, the filtered out ones included (0 for the other entries).")
+        .def("is_dir", &os::DirEntry::is_dir)
+        .def("is_file", &os::DirEntry::is_file)
+        .def("is_symlink", &os::DirEntry::is_symlink)
+        .def("__repr__", [](const os::DirEntry& e){
+            return "<DirEntry '" + e.path + "'>";
+        });
+
+    //std::vector<DirEntry> scantree( const std::string& root, const ScanOptions& options )
+    mod.def("scan_tree", [](const std::string& root,
+                            const std::vector<std::string>& include,
+                            const std::vector<std::string>& exclude,
+                            unsigned threads,
+                            bool includeDirs){
+        os::ScanOptions options;
+        options.include = include;
+        options.exclude = exclude;
+        options.threads = threads;
+        options.include_dirs = includeDirs;
+        return os::scantree(root, options);
+    },
+    py::arg("root"), py::arg("include")=std::vector<std::string>{}, py::arg("exclude")=std::vector<std::string>{},
+    py::arg("threads")=0, py::arg("includeDirs")=false,
+    py::call_guard<py::gil_scoped_release>(),
+    "Scans a directory tree with multiple threads and returns the entries together with their size, mtime, mode and inode. Args: root(str): the directory to scan. include(list): wildcards of the files to keep. exclude(list): wildcards of the files and directories to skip. threads(int): the number of worker threads, 0 means the hardware concurrency. includeDirs(bool): whether to return the directories too.");
+
+    //Bind the access pattern hints of the memory mapped file
+    py::native_enum<os::Advice>(mod, "MapAdvice", "enum.Enum")
+        .value("Normal", os::Advice::Normal)
+        .value("Sequential", os::Advice::Sequential)
+        .value("Random", os::Advice::Random)
+        .value("WillNeed", os::Advice::WillNeed)
+        .value("DontNeed", os::Advice::DontNeed)
+        .finalize();
+
+    //Bind the read-only memory mapped file, it supports the buffer protocol so memoryview(mapped) does not copy
+    //(The buffer procs of the type are replaced to count the exported views, close() refuses to unmap while one is alive)
+    py::class_<ExportedMappedFile> mapped(mod, "MappedFile", py::buffer_protocol());
+    mapped
+        .def("__len__", &os::MappedFile::size)
+        .def("size", &os::MappedFile::size)
+        .def("valid", &os::MappedFile::valid)
+        .def("exports", [](ExportedMappedFile& self){
+            std::lock_guard<std::mutex> lock(self.mutex);
+            return self.exports;
+        }, "Returns the number of buffers (memoryviews) of the mapping which are still alive.")
+        .def("advise", &os::MappedFile::advise, "Gives the access pattern hint of the mapping to the kernel.")
+        .def("close", [](ExportedMappedFile& self){
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if (self.exports != 0) {
+                throw py::buffer_error("Cannot close a MappedFile while " + std::to_string(self.exports) + " memoryview(s) of it still exist");
+            }
+            self.close();
+        }, "Unmaps the file. Raises BufferError while a memoryview of the mapping is still alive, release them first.");
+    PyBufferProcs* procs = reinterpret_cast<PyTypeObject*>(mapped.ptr())->tp_as_buffer;
+    procs->bf_getbuffer = mapped_getbuffer;
+    procs->bf_releasebuffer = mapped_releasebuffer;
+
+    //MappedFile map_file( const std::string& filename )
+    mod.def("map_file", [](const std::string& filename){
+        //Returned through a pointer, since the mutex cannot be moved
+        std::unique_ptr<ExportedMappedFile> mapped(new ExportedMappedFile());
+        static_cast<os::MappedFile&>(*mapped) = os::map_file(filename);
+        if (!mapped->valid()) {
+            throw std::runtime_error("Cannot map file: " + filename);
+        }
+        return mapped;
+    }, py::arg("filename"), "Maps a whole file read-only into memory and returns a MappedFile, which can be read through memoryview without copying.");
+
+    //bool copyfile( const std::string& src, const std::string& dst )
+    mod.def("copyfile", &os::copyfile, py::arg("src"), py::arg("dst"),
+    py::call_guard<py::gil_scoped_release>(),
+    "Copies a file inside the kernel (reflink, copy_file_range or sendfile when available). Returns whether the copy succeeded.");
+
+    //Bind the result of the tree operations
+    py::class_<os::TreeResult>(mod, "TreeResult")
+        .def_readonly("count", &os::TreeResult::count, "The number of removed or copied entries, including directories.")
+        .def_readonly("bytes", &os::TreeResult::bytes, "The number of copied bytes (0 for removing).")
+        .def_readonly("errors", &os::TreeResult::errors, "The failed paths and their errno.");
+
+    //TreeResult rmtree( const std::string& path, unsigned threads = 0 )
+    mod.def("rmtree", &os::rmtree, py::arg("path"), py::arg("threads")=0,
+    py::call_guard<py::gil_scoped_release>(),
+    "Removes a directory tree with multiple threads. Args: path(str): the directory (or file) to remove. threads(int): the number of worker threads, 0 means the hardware concurrency.");
+
+    //TreeResult copytree( const std::string& src, const std::string& dst, unsigned threads = 0 )
+    mod.def("copytree", &os::copytree, py::arg("src"), py::arg("dst"), py::arg("threads")=0,
+    py::call_guard<py::gil_scoped_release>(),
+    "Copies a directory tree with multiple threads, the files are copied inside the kernel. The destination may already exist. Args: src(str): the source directory. dst(str): the destination directory. threads(int): the number of worker threads, 0 means the hardware concurrency.");
+
+    //bool write_file( const std::string& filename, const char* data, size_t size )
+    mod.def("write_file", [](const std::string& filename, py::buffer data){
+        ContiguousBuffer buffer(data, false);
+        py::gil_scoped_release release;
+        return os::write_file(filename, buffer.data(), buffer.size());
+    }, py::arg("filename"), py::arg("data"),
+    "Writes a bytes-like object to a file without copying it into a temporary string. Raises BufferError for a non-contiguous view. Returns whether the write succeeded.");
+}
@@ -14,8 +14,11 @@ License: This project is under the Apache-2.0 Lincense, see LICENSE for more det
 #include <Enums_EVP.cpp>
 #include <Bit7zLibrary_EVP.cpp>
 #include <BitFormat_EVP.cpp>
+#include <ArchiveItem_EVP.cpp>
+#include <Cancel_EVP.cpp>
 #include <BitFileExtractor_EVP.cpp>
 #include <BitFileCompressor_EVP.cpp>
+#include <PyOS_EVP.cpp>
 
 //Main module
 #ifdef PYTHON_NO_GIL
@@ -23,15 +26,21 @@ PYBIND11_MODULE(bit7z_python, mod, py::mod_gil_not_used()){
     init_enums(mod);
     init_lib(mod);
     init_formats(mod);
+    init_cancel(mod);
     init_BitFileCompressor(mod);
+    init_ArchiveItem(mod);
     init_BitFileExtractor(mod);
+    init_pyos(mod);
 }
 #else
 PYBIND11_MODULE(bit7z_python, mod){
     init_enums(mod);
     init_lib(mod);
     init_formats(mod);
+    init_cancel(mod);
     init_BitFileCompressor(mod);
+    init_ArchiveItem(mod);
     init_BitFileExtractor(mod);
+    init_pyos(mod);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,579 @@
+import bit7z_python as b7
+import os
+import sys
+import time
+import shutil
+
+lib = b7.Bit7zLibrary(sys.argv[1] if len(sys.argv) > 1 else b7.DEFAULT_7ZIP_DLL)
+work = "./bench"
+
+
+def timeit(name, func, *args):
+    s = time.time()
+    func(*args)
+    print(f"{name}: {time.time() - s:.3f} s")
+
+
+def make_small_files(root, count=20000, size=4096):
+    os.makedirs(root, exist_ok=True)
+    for i in range(count):
+        sub = os.path.join(root, f"d{i % 100}")
+        os.makedirs(sub, exist_ok=True)
+        with open(os.path.join(sub, f"f{i}.bin"), "wb") as fp:
+            fp.write(os.urandom(size // 2) + bytes(size // 2))
+
+
+def bench_extract_async():
+    # Many small files: the asynchronous writer overlaps decoding with file creation
+    src = os.path.join(work, "small")
+    make_small_files(src)
+    archive = os.path.join(work, "small.zip")
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_ZIP)
+    compressor.compress_directory(src, archive)
+
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_ZIP)
+    timeit("extract", extractor.extract, archive, os.path.join(work, "out1"))
+    timeit("extract_async", extractor.extract_async, archive, os.path.join(work, "out2"))
+
+
+def drop_caches():
+    # Cold page cache needs root on Linux, otherwise the numbers are for a warm cache
+    try:
+        os.sync()
+        with open("/proc/sys/vm/drop_caches", "w") as fp:
+            fp.write("3")
+    except OSError:
+        print("(cannot drop the page cache, results are for a warm cache)")
+
+
+def bench_prefetch():
+    # Many small files: the prefetching readers keep the encoder from waiting on open/read
+    src = os.path.join(work, "small")
+    if not os.path.exists(src):
+        make_small_files(src)
+    files = [e.path for e in b7.scan_tree(src)]
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_7Z)
+    compressor.set_compression_level(b7.BitCompressionLevel.Fastest)
+
+    drop_caches()
+    timeit("compress_files", compressor.compress_files, files, os.path.join(work, "p1.7z"))
+    drop_caches()
+    timeit("compress_files (prefetch)", compressor.compress_files, files, os.path.join(work, "p2.7z"), 8)
+
+
+def bench_mmap():
+    # Large archive: mmap input against file-path input, on a warm and a cold page cache
+    # (Run it under "strace -c -f python bench.py <7z.so> mmap" to compare the read/lseek counts)
+    src = os.path.join(work, "large")
+    os.makedirs(src, exist_ok=True)
+    for i in range(16):
+        with open(os.path.join(src, f"f{i}.bin"), "wb") as fp:
+            fp.write(os.urandom(8 * 1024 * 1024) + bytes(8 * 1024 * 1024))
+    archive = os.path.join(work, "large.zip")
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_ZIP)
+    compressor.set_compression_level(b7.BitCompressionLevel.Fastest)
+    compressor.compress_directory(src, archive)
+
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_ZIP)
+    extractor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    for cache in ("cold", "warm"):
+        for mmap in (False, True):
+            name = f"{cache}, {'mmap' if mmap else 'file'}"
+            if cache == "cold":
+                drop_caches()
+            timeit(f"extract ({name})", extractor.extract, archive, os.path.join(work, "out3"), mmap)
+            timeit(f"test ({name})", extractor.test, archive, mmap)
+            timeit(f"list_items ({name})", extractor.list_items, archive, mmap)
+
+
+def bench_detect():
+    # Mixed corpus: signature detection (cold and cached) against opening with FORMAT_AUTO and with the real format
+    import bz2, gzip, io, lzma, tarfile, zipfile
+    src = os.path.join(work, "corpus")
+    os.makedirs(src, exist_ok=True)
+    data = os.urandom(64 * 1024) + bytes(64 * 1024)
+    formats = {}
+    for i in range(50):
+        base = os.path.join(src, f"a{i}")
+        with zipfile.ZipFile(base + ".zip", "w") as fp:
+            fp.writestr("x.bin", data)
+        formats[base + ".zip"] = b7.FORMAT_ZIP
+        with tarfile.open(base + ".tar", "w") as fp:
+            info = tarfile.TarInfo("x.bin")
+            info.size = len(data)
+            fp.addfile(info, io.BytesIO(data))
+        formats[base + ".tar"] = b7.FORMAT_TAR
+        for ext, module, fmt in ((".gz", gzip, b7.FORMAT_GZIP), (".bz2", bz2, b7.FORMAT_BZIP2), (".xz", lzma, b7.FORMAT_XZ)):
+            with open(base + ext, "wb") as fp:
+                fp.write(module.compress(data))
+            formats[base + ext] = fmt
+        b7.BitFileCompressor(lib, b7.FORMAT_7Z).compress_file(base + ".tar", base + ".7z")
+        formats[base + ".7z"] = b7.FORMAT_7Z
+    # Hide the extensions, so that neither side can guess from them
+    corpus = {}
+    for i, (path, fmt) in enumerate(formats.items()):
+        os.rename(path, os.path.join(src, f"f{i}.bin"))
+        corpus[os.path.join(src, f"f{i}.bin")] = fmt
+
+    def detect(useCache):
+        for path in corpus:
+            b7.detect_format(path, useCache)
+
+    b7.clear_format_cache()
+    timeit("detect_format (no cache)", detect, False)
+    timeit("detect_format (fill cache)", detect, True)
+    timeit("detect_format (cached)", detect, True)
+    wrong = [p for p, f in corpus.items() if b7.detect_format(p).value() != f.value()]
+    print(f"misdetected: {len(wrong)} of {len(corpus)}")
+
+    def list_all(auto):
+        for path, fmt in corpus.items():
+            b7.BitFileExtractor(lib, b7.FORMAT_AUTO if auto else fmt).list_items(path)
+
+    timeit("list_items (FORMAT_AUTO, cached detection)", list_all, True)
+    timeit("list_items (known format)", list_all, False)
+    print(b7.format_cache_stats())
+
+
+def bench_threads():
+    # Free-threaded Python (3.13t/3.14t): one extractor and one compressor shared by all the threads
+    # For the data race check, build the module with CFLAGS="-fsanitize=thread" and run this bench with the TSan runtime preloaded
+    from concurrent.futures import ThreadPoolExecutor
+    gil = sys._is_gil_enabled() if hasattr(sys, "_is_gil_enabled") else True
+    print(f"GIL enabled: {gil}")
+    src = os.path.join(work, "threads")
+    os.makedirs(src, exist_ok=True)
+    data = os.urandom(1024 * 1024) + bytes(3 * 1024 * 1024)
+    for i in range(32):
+        with open(os.path.join(src, f"f{i}.bin"), "wb") as fp:
+            fp.write(data)
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_ZIP)
+    compressor.set_threads_count(1)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_ZIP)
+    archives = [os.path.join(src, f"f{i}.zip") for i in range(32)]
+    for i, archive in enumerate(archives):
+        compressor.compress_file(os.path.join(src, f"f{i}.bin"), archive)
+
+    def run(threads, func, jobs):
+        s = time.time()
+        with ThreadPoolExecutor(threads) as pool:
+            list(pool.map(func, jobs))
+        return time.time() - s
+
+    total = len(archives) * len(data) / 1024 / 1024
+    for threads in (1, 2, 4, 8):
+        t = run(threads, extractor.extract_to_memory, archives)
+        print(f"extract_to_memory, {threads} threads: {total / t:.1f} MB/s")
+    for threads in (1, 2, 4, 8):
+        t = run(threads, lambda i: compressor.compress_file(os.path.join(src, f"f{i}.bin"), os.path.join(src, f"o{i}.zip")), range(32))
+        print(f"compress_file, {threads} threads: {total / t:.1f} MB/s")
+
+    # Stress: operations, setters and getters on the same objects at the same time; every result must be intact
+    def extract_check(archive):
+        for content in extractor.extract_to_memory(archive).values():
+            assert content == data
+    def change_settings(i):
+        compressor.set_compression_level(b7.BitCompressionLevel.Fastest if i % 2 else b7.BitCompressionLevel.Normal)
+        extractor.set_progress_callback(lambda done: True)
+        compressor.compression_level()
+        extractor.progress_callback()
+    s = time.time()
+    with ThreadPoolExecutor(8) as pool:
+        jobs = [pool.submit(extract_check, archives[i % 32]) for i in range(256)]
+        jobs += [pool.submit(change_settings, i) for i in range(256)]
+        jobs += [pool.submit(compressor.compress_file, os.path.join(src, f"f{i % 32}.bin"), os.path.join(src, f"s{i}.zip")) for i in range(64)]
+        for job in jobs:
+            job.result()
+    for i in range(64):
+        assert extractor.extract_to_memory(os.path.join(src, f"s{i}.zip"))[f"f{i % 32}.bin"] == data
+    print(f"stress: {len(jobs)} calls in {time.time() - s:.3f} s, no errors")
+
+
+def bench_preset():
+    # Per-request setup: a dozen setter calls against one checkout from a preset
+    def configure():
+        compressor = b7.BitFileCompressor(lib, b7.FORMAT_7Z)
+        compressor.set_compression_level(b7.BitCompressionLevel.Fast)
+        compressor.set_compression_method(b7.BitCompressionMethod.LZMA2)
+        compressor.set_dictionary_size(1 << 22)
+        compressor.set_threads_count(2)
+        compressor.set_solid_mode(True)
+        compressor.set_password("secret", True)
+        compressor.set_retain_directories(True)
+        compressor.set_store_symbolic_links(False)
+        compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        compressor.set_progress_callback(lambda done: True)
+        compressor.set_file_callback(lambda name: None)
+        compressor.set_total_callback(lambda total: None)
+        return compressor
+
+    preset = configure().preset()
+
+    def setters():
+        for _ in range(10000):
+            configure()
+
+    def create():
+        for _ in range(10000):
+            preset.create()
+
+    def checkout():
+        for _ in range(10000):
+            with preset.checkout():
+                pass
+
+    timeit("setters (10000 compressors)", setters)
+    timeit("preset.create (10000 compressors)", create)
+    timeit("preset.checkout (10000 compressors)", checkout)
+
+
+def bench_import():
+    # Import time of a fresh interpreter (the rarely used enums and the FORMAT_* constants are made on the first access)
+    import subprocess
+    code = "import time; s = time.perf_counter(); import bit7z_python; print(time.perf_counter() - s)"
+    runs = [float(subprocess.check_output([sys.executable, "-c", code])) for _ in range(20)]
+    runs.sort()
+    print(f"import bit7z_python: best {runs[0] * 1000:.2f} ms, median {runs[len(runs) // 2] * 1000:.2f} ms")
+    code = ("import time, bit7z_python as b; s = time.perf_counter(); "
+            "[getattr(b, n) for n in dir(b) if n.startswith('FORMAT_') or n in ('BitProperty', 'BitError')]; "
+            "print(time.perf_counter() - s)")
+    print(f"first access of all lazy attributes: {float(subprocess.check_output([sys.executable, '-c', code])) * 1000:.2f} ms")
+
+
+def bench_properties():
+    # Throughput against ratio for the speed-relevant format properties
+    src = os.path.join(work, "mixed")
+    os.makedirs(src, exist_ok=True)
+    words = b" ".join(str(i).encode() * (i % 7 + 1) for i in range(200000))
+    for i in range(8):
+        with open(os.path.join(src, f"f{i}.bin"), "wb") as fp:
+            fp.write(words + os.urandom(1024 * 1024) + bytes(2 * 1024 * 1024))
+    total = sum(os.path.getsize(os.path.join(src, name)) for name in os.listdir(src))
+
+    combos = [
+        ("7z", b7.FORMAT_7Z, {"x": 1, "mf": "hc4", "fb": 32, "mt": True}),
+        ("7z", b7.FORMAT_7Z, {"x": 5, "mf": "bt4", "fb": 32, "mt": True}),
+        ("7z", b7.FORMAT_7Z, {"x": 5, "mf": "bt4", "fb": 64, "mt": True, "qs": True}),
+        ("7z", b7.FORMAT_7Z, {"x": 9, "mf": "bt4", "fb": 273, "mt": True, "s": "e"}),
+        ("7z", b7.FORMAT_7Z, {"x": 5, "mt": 1}),
+        ("7z", b7.FORMAT_7Z, {"x": 5, "s": "64m", "yx": 0}),
+        ("zip", b7.FORMAT_ZIP, {"x": 1, "pass": 1, "fb": 32}),
+        ("zip", b7.FORMAT_ZIP, {"x": 9, "pass": 4, "fb": 128}),
+        ("xz", b7.FORMAT_XZ, {"x": 3, "mf": "hc4", "mt": True}),
+        ("bzip2", b7.FORMAT_BZIP2, {"x": 9, "mt": True}),
+    ]
+    for name, format, properties in combos:
+        compressor = b7.BitFileCompressor(lib, format)
+        compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        applied = compressor.set_format_properties(properties)
+        archive = os.path.join(work, "props.bin")
+        s = time.time()
+        if name in ("xz", "bzip2"):
+            # Single-file formats: one input file
+            compressor.compress_file(os.path.join(src, "f0.bin"), archive)
+            size = os.path.getsize(os.path.join(src, "f0.bin"))
+        else:
+            compressor.compress_directory(src, archive)
+            size = total
+        elapsed = time.time() - s
+        print(f"{name:>5} {applied}: {size / elapsed / 1e6:.1f} MB/s, ratio {os.path.getsize(archive) / size:.3f}")
+
+
+def bench_blocks():
+    # Block compression of one large file: the throughput should grow with the threads, and the stock tools must read the output
+    import subprocess
+    src = os.path.join(work, "big.log")
+    if not os.path.exists(src):
+        os.makedirs(work, exist_ok=True)
+        line = b"2026-10-18T12:00:00 INFO request served in %d ms from host-%d\n"
+        with open(src, "wb") as fp:
+            for i in range(64):
+                fp.write(b"".join(line % (j % 977, j % 31) for j in range(i * 60000, (i + 1) * 60000)) + os.urandom(256 * 1024))
+    size = os.path.getsize(src)
+    for name, format, tool in (("gzip", b7.FORMAT_GZIP, "gzip"), ("bzip2", b7.FORMAT_BZIP2, "bzip2"), ("xz", b7.FORMAT_XZ, "xz")):
+        compressor = b7.BitFileCompressor(lib, format)
+        compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        out = os.path.join(work, "big." + name)
+        s = time.time()
+        compressor.compress_file(src, out)
+        base = time.time() - s
+        print(f"{name} single stream: {size / base / 1e6:.1f} MB/s, ratio {os.path.getsize(out) / size:.3f}")
+        threads = 1
+        while threads <= (os.cpu_count() or 1):
+            s = time.time()
+            compressor.compress_file(src, out, blockThreads=threads)
+            elapsed = time.time() - s
+            print(f"{name} {threads} threads: {size / elapsed / 1e6:.1f} MB/s ({base / elapsed:.2f}x), ratio {os.path.getsize(out) / size:.3f}")
+            threads *= 2
+        if shutil.which(tool):
+            print(f"{tool} -t: {'ok' if subprocess.call([tool, '-t', out]) == 0 else 'FAILED'}")
+
+
+def bench_parallel_extract():
+    # Multi-member gzip/bzip2 and multi-block xz decoded as one stream against decoded on all the cores
+    import subprocess
+    bench_blocks_input = os.path.join(work, "big.log")
+    if not os.path.exists(bench_blocks_input):
+        bench_blocks()
+    archives = []
+    for name, format in (("gzip", b7.FORMAT_GZIP), ("bzip2", b7.FORMAT_BZIP2), ("xz", b7.FORMAT_XZ)):
+        compressor = b7.BitFileCompressor(lib, format)
+        compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        out = os.path.join(work, "multi." + name)
+        compressor.compress_file(bench_blocks_input, out, blockThreads=os.cpu_count() or 1)
+        archives.append((name + " (blocks)", format, out))
+    if shutil.which("xz"):
+        out = os.path.join(work, "xzT.xz")
+        with open(out, "wb") as fp:
+            subprocess.check_call(["xz", "-T0", "-c", bench_blocks_input], stdout=fp)
+        archives.append(("xz -T0", b7.FORMAT_XZ, out))
+
+    for name, format, archive in archives:
+        extractor = b7.BitFileExtractor(lib, format)
+        extractor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        for threads in (1, 0):
+            s = time.time()
+            extractor.extract(archive, os.path.join(work, "px"), decodeThreads=threads)
+            elapsed = time.time() - s
+            label = "serial" if threads == 1 else "parallel"
+            print(f"{name} {label}: {os.path.getsize(bench_blocks_input) / elapsed / 1e6:.1f} MB/s")
+
+
+def bench_seekable():
+    # Reading single items out of a fully solid 7z against the bounded solid blocks of the seekable profile
+    import random
+    src = os.path.join(work, "seek_src")
+    if not os.path.exists(src):
+        os.makedirs(src)
+        for i in range(2000):
+            with open(os.path.join(src, f"f{i:05d}.txt"), "wb") as fp:
+                fp.write((b"record %d of the seekable benchmark\n" % i) * 1500)
+    files = sorted(os.path.join(src, name) for name in os.listdir(src))
+    names = random.Random(1).sample([os.path.basename(path) for path in files], 50)
+    solid = os.path.join(work, "solid.7z")
+    seekable = os.path.join(work, "seekable.7z")
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_7Z)
+    compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    compressor.set_solid_mode(True)
+    timeit("solid compress", compressor.compress_files, files, solid)
+    timeit("seekable compress", compressor.compress_seekable, files, seekable, 1 << 20, 64)
+    print(f"sizes: solid {os.path.getsize(solid)}, seekable {os.path.getsize(seekable)}")
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_7Z)
+    for label, archive in (("solid", solid), ("seekable", seekable)):
+        s = time.time()
+        for name in names:
+            extractor.extract_path(archive, name)
+        print(f"{label} read: {(time.time() - s) / len(names) * 1000:.2f} ms per item")
+
+
+def bench_tar():
+    # Uncompressed tar written and read by 7-Zip against the native path, on large incompressible files
+    src = os.path.join(work, "tar_src")
+    if not os.path.exists(src):
+        os.makedirs(src)
+        for i in range(8):
+            with open(os.path.join(src, f"media{i}.bin"), "wb") as fp:
+                for _ in range(64):
+                    fp.write(os.urandom(1 << 20))
+    size = sum(os.path.getsize(os.path.join(src, name)) for name in os.listdir(src))
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_TAR)
+    compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_TAR)
+    extractor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    for native in (False, True):
+        label = "native" if native else "7-Zip"
+        out = os.path.join(work, f"media_{label}.tar")
+        s = time.time()
+        compressor.compress([src], out, nativeTar=native)
+        print(f"{label} create: {size / (time.time() - s) / 1e6:.0f} MB/s")
+        s = time.time()
+        extractor.extract(out, os.path.join(work, "tx_" + label), nativeTar=native)
+        print(f"{label} extract: {size / (time.time() - s) / 1e6:.0f} MB/s")
+    same = open(os.path.join(work, "media_native.tar"), "rb").read() == open(os.path.join(work, "media_7-Zip.tar"), "rb").read()
+    print(f"native archive identical to the 7-Zip one: {same}")
+
+
+def bench_stored():
+    # A zip archive of stored media files extracted by 7-Zip against the kernel copies of the stored items
+    import zipfile
+    archive = os.path.join(work, "stored.zip")
+    if not os.path.exists(archive):
+        os.makedirs(work, exist_ok=True)
+        with zipfile.ZipFile(archive, "w", zipfile.ZIP_STORED) as zf:
+            for i in range(16):
+                zf.writestr(f"photos/img{i:03d}.jpg", os.urandom(32 << 20))
+            zf.writestr("index.txt", b"photo index\n" * 1000, compress_type=zipfile.ZIP_DEFLATED)
+    size = os.path.getsize(archive)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_ZIP)
+    extractor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    for copy in (False, True):
+        label = "kernel copy" if copy else "7-Zip"
+        s = time.time()
+        extractor.extract(archive, os.path.join(work, "sx"), copyStored=copy)
+        print(f"{label}: {size / (time.time() - s) / 1e6:.0f} MB/s")
+
+
+def bench_list_native():
+    # Listing many small zip and tar archives through 7-Zip against the native central directory and header readers
+    import zipfile
+    import io
+    import tarfile
+    archives = []
+    os.makedirs(work, exist_ok=True)
+    for i in range(200):
+        archive = os.path.join(work, f"list{i}.zip")
+        with zipfile.ZipFile(archive, "w", zipfile.ZIP_DEFLATED) as zf:
+            for j in range(50):
+                zf.writestr(f"dir{j % 5}/file{j}.txt", f"item {i} {j}\n" * 10)
+        archives.append(archive)
+    for i in range(20):
+        archive = os.path.join(work, f"list{i}.tar")
+        with tarfile.open(archive, "w", format=tarfile.GNU_FORMAT) as tf:
+            for j in range(50):
+                data = f"item {i} {j}\n".encode() * 10
+                info = tarfile.TarInfo(f"dir{j % 5}/file{j}.txt")
+                info.size = len(data)
+                info.mtime = 1700000000 + j
+                tf.addfile(info, io.BytesIO(data))
+        archives.append(archive)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_AUTO)
+    s = time.time()
+    listed = [extractor.list_items(a) for a in archives]
+    print(f"7-Zip: {(time.time() - s) / len(archives) * 1e3:.2f} ms per archive")
+    s = time.time()
+    native = [b7.list_items_native(a) for a in archives]
+    print(f"native: {(time.time() - s) / len(archives) * 1e3:.2f} ms per archive")
+    fields = ("path", "size", "pack_size", "crc", "is_dir", "mtime")
+    same = all([tuple(getattr(x, f) for f in fields) for x in a] == [tuple(getattr(x, f) for f in fields) for x in b]
+               for a, b in zip(listed, native))
+    print(f"same metadata: {same}")
+
+
+def bench_open():
+    # Small reads at random offsets of a deflated and a stored zip item: a whole extract_item per read against open()
+    import random
+    import zipfile
+    archive = os.path.join(work, "open.zip")
+    data = b"".join(b"row %08d of the random access benchmark\n" % i for i in range(600000))
+    if not os.path.exists(archive):
+        os.makedirs(work, exist_ok=True)
+        with zipfile.ZipFile(archive, "w") as zf:
+            zf.writestr("table.csv", data, compress_type=zipfile.ZIP_DEFLATED)
+            zf.writestr("table.raw", data, compress_type=zipfile.ZIP_STORED)
+    offsets = random.Random(1).sample(range(len(data) - 4096), 200)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_ZIP)
+    s = time.time()
+    for offset in offsets[:20]:
+        extractor.extract_item(archive, 0)[offset:offset + 4096]
+    print(f"extract_item: {(time.time() - s) / 20 * 1000:.2f} ms per read")
+    for name in ("table.csv", "table.raw"):
+        b7.clear_item_cache()
+        with extractor.open(archive, name) as fp:
+            s = time.time()
+            for offset in offsets:
+                fp.seek(offset)
+                assert fp.read(4096) == data[offset:offset + 4096]
+            print(f"open {name} (in place: {fp.in_place}): {(time.time() - s) / len(offsets) * 1000:.3f} ms per read")
+    print(b7.item_cache_stats())
+
+
+def bench_nested():
+    # A zip of tar.gz files of 7z archives: extracting level by level through temporary directories against iter_nested
+    import io
+    import tarfile
+    import zipfile
+    src = os.path.join(work, "nested_src")
+    archive = os.path.join(work, "nested.zip")
+    if not os.path.exists(archive):
+        make_small_files(src, count=2000)
+        inner = os.path.join(work, "inner.7z")
+        compressor = b7.BitFileCompressor(lib, b7.FORMAT_7Z)
+        compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+        compressor.compress_directory(src, inner)
+        with zipfile.ZipFile(archive, "w", zipfile.ZIP_STORED) as zf:
+            for i in range(8):
+                buffer = io.BytesIO()
+                with tarfile.open(fileobj=buffer, mode="w:gz") as tf:
+                    tf.add(inner, arcname=f"part{i}/inner.7z")
+                zf.writestr(f"batch/part{i}.tar.gz", buffer.getvalue())
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_AUTO)
+
+    def temp_dirs():
+        levels = [os.path.join(work, "nested_tmp")]
+        shutil.rmtree(levels[0], ignore_errors=True)
+        extractor.extract(archive, levels[0])
+        for _ in range(4):
+            found = [os.path.join(root, name) for root, _, names in os.walk(levels[-1]) for name in names
+                     if name.endswith((".gz", ".tar", ".7z"))]
+            if not found:
+                break
+            levels.append(levels[-1] + "_")
+            for path in found:
+                extractor.extract(path, os.path.join(levels[-1], os.path.relpath(path, levels[-2])))
+        return sum(len(names) for _, _, names in os.walk(levels[-1]))
+
+    def in_memory():
+        return sum(1 for _ in extractor.iter_nested(archive))
+
+    for label, run in (("temp dirs", temp_dirs), ("iter_nested", in_memory)):
+        s = time.time()
+        count = run()
+        print(f"{label}: {time.time() - s:.3f} s, {count} files")
+
+
+def bench_transcode():
+    # A zip of many files converted to 7z: extracting to a temporary directory and compressing it against transcode
+    src = os.path.join(work, "transcode_src")
+    archive = os.path.join(work, "transcode.zip")
+    if not os.path.exists(archive):
+        make_small_files(src, count=2000)
+        zipper = b7.BitFileCompressor(lib, b7.FORMAT_ZIP)
+        zipper.compress_directory(src, archive)
+    extractor = b7.BitFileExtractor(lib, b7.FORMAT_AUTO)
+    compressor = b7.BitFileCompressor(lib, b7.FORMAT_7Z)
+    compressor.set_overwrite_mode(b7.OverwriteMode.Overwrite)
+    out = os.path.join(work, "transcode.7z")
+
+    def through_disk():
+        tmp = os.path.join(work, "transcode_tmp")
+        shutil.rmtree(tmp, ignore_errors=True)
+        extractor.extract(archive, tmp)
+        compressor.compress_directory(tmp, out)
+        shutil.rmtree(tmp, ignore_errors=True)
+
+    def in_memory():
+        compressor.transcode(archive, out, extractor, dropMetadata=True)
+
+    for label, run in (("extract + compress", through_disk), ("transcode", in_memory)):
+        s = time.time()
+        run()
+        print(f"{label}: {time.time() - s:.3f} s, {os.path.getsize(out)} bytes")
+
+
+benches = {
+    "extract_async": bench_extract_async,
+    "prefetch": bench_prefetch,
+    "mmap": bench_mmap,
+    "detect": bench_detect,
+    "threads": bench_threads,
+    "preset": bench_preset,
+    "import": bench_import,
+    "properties": bench_properties,
+    "blocks": bench_blocks,
+    "parallel_extract": bench_parallel_extract,
+    "seekable": bench_seekable,
+    "tar": bench_tar,
+    "stored": bench_stored,
+    "list_native": bench_list_native,
+    "open": bench_open,
+    "nested": bench_nested,
+    "transcode": bench_transcode,
+}
+
+if __name__ == "__main__":
+    if os.path.exists(work):
+        shutil.rmtree(work, ignore_errors=True)
+    for name in (sys.argv[2:] or benches.keys()):
+        print(f"== {name} ==")
+        benches[name]()
+    shutil.rmtree(work, ignore_errors=True)
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+using namespace std;
+#include <time.hpp>
+#include <pyos.hpp>
+
+//Compare the zero-copy helpers of pyos with the previous std::filesystem/iostream implementations
+void bench_io(const string& path){
+    TimeProcessor timer = TimeProcessor();
+    uint64_t size = os::path::getsize(path);
+    cout<<"File: "<<path<<" ("<<size<<" bytes)"<<endl;
+
+    timer.startTimer();
+    ifstream file(path, ios::binary);
+    ostringstream ss;
+    ss<<file.rdbuf();
+    string old_content = ss.str();
+    cout<<"ostringstream read: "<<timer.stopTimer()<<"s"<<endl;
+
+    timer.startTimer();
+    string content = os::read_file(path);
+    cout<<"os::read_file: "<<timer.stopTimer()<<"s"<<endl;
+
+    timer.startTimer();
+    os::MappedFile mapped = os::map_file(path);
+    mapped.advise(os::Advice::Sequential);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < mapped.size(); i += 4096) sum += static_cast<unsigned char>(mapped.data()[i]);
+    cout<<"os::map_file (touch all pages): "<<timer.stopTimer()<<"s"<<endl;
+
+    string dst = path + ".bench_copy";
+    timer.startTimer();
+    filesystem::copy_file(path, dst, filesystem::copy_options::overwrite_existing);
+    cout<<"std::filesystem::copy_file: "<<timer.stopTimer()<<"s"<<endl;
+
+    timer.startTimer();
+    os::copyfile(path, dst);
+    cout<<"os::copyfile: "<<timer.stopTimer()<<"s"<<endl;
+    os::remove(dst);
+
+    if (sum == 1) cout<<endl; //Keep the page walk from being optimized out
+}
+
+//Compare the parallel tree helpers of pyos with std::filesystem
+void bench_tree(const string& dir){
+    TimeProcessor timer = TimeProcessor();
+    string dst = dir + ".bench_copy";
+    cout<<"Directory: "<<dir<<endl;
+
+    timer.startTimer();
+    vector<string> files = os::walk(dir);
+    cout<<"os::walk: "<<timer.stopTimer()<<"s ("<<files.size()<<" files)"<<endl;
+
+    timer.startTimer();
+    filesystem::copy(dir, dst, filesystem::copy_options::recursive | filesystem::copy_options::copy_symlinks);
+    cout<<"std::filesystem::copy: "<<timer.stopTimer()<<"s"<<endl;
+
+    timer.startTimer();
+    uintmax_t removed = filesystem::remove_all(dst);
+    cout<<"std::filesystem::remove_all: "<<timer.stopTimer()<<"s ("<<removed<<" entries)"<<endl;
+
+    timer.startTimer();
+    os::TreeResult copied = os::copytree(dir, dst);
+    cout<<"os::copytree: "<<timer.stopTimer()<<"s ("<<copied.count<<" entries, "<<copied.errors.size()<<" errors)"<<endl;
+
+    timer.startTimer();
+    os::TreeResult result = os::rmtree(dst);
+    cout<<"os::rmtree: "<<timer.stopTimer()<<"s ("<<result.count<<" entries, "<<result.errors.size()<<" errors)"<<endl;
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 2){
+        cout<<"Usage: bench_pyos <file or directory>"<<endl;
+        return 1;
+    }
+    if (os::path::isdir(argv[1])){
+        bench_tree(argv[1]);
+    } else {
+        bench_io(argv[1]);
+    }
+    return 0;
+}
+/*compile:
+built as the bench_pyos target of include/CMakeLists.txt, or by hand:
+g++ -O2 -std=c++17 -I../include bench_pyos.cpp -L../include/dist -lpyos -Wl,-rpath,../include/dist -o bench_pyos
+*/
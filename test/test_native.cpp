@@ -0,0 +1,635 @@
+//Behaviour tests of the self-contained native parts (the parsers, the caches and the pyos helpers)
+//They need neither 7-Zip nor Python: built with the pyos library and run by ctest
+//Malformed inputs are checked by truncating and corrupting valid data: the parsers must reject it or parse it, never crash
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <random>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+#include <pyos.hpp>
+#include <zipdir.hpp>
+#include <tarnative.hpp>
+#include <streamsplit.hpp>
+#include <blockcache.hpp>
+#include <safepath.hpp>
+#include <asyncwriter.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+        ++failures; \
+    } \
+} while (0)
+
+//A scratch directory under the system temporary directory, removed afterwards
+struct TempDir {
+    std::string path;
+
+    explicit TempDir(const std::string& name) {
+        path = os::path::join(os::gettempdir(), "bit7z_python_test_" + name);
+        os::rmtree(path);
+        os::makedirs(path);
+    }
+
+    ~TempDir() {
+        os::rmtree(path);
+    }
+};
+
+static void put_le(std::string& out, uint64_t value, int bytes){
+    for (int i = 0; i < bytes; ++i) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+//Every truncation and some random corruptions of data, given to a parser which must not crash
+static void mangle(const std::string& data, const std::function<void(const std::string&)>& parse){
+    for (size_t size = 0; size < data.size(); ++size) {
+        parse(data.substr(0, size));
+    }
+    std::mt19937 random(12345);
+    for (int round = 0; round < 2000; ++round) {
+        std::string copy = data;
+        int flips = 1 + static_cast<int>(random() % 4);
+        for (int i = 0; i < flips; ++i) {
+            copy[random() % copy.size()] = static_cast<char>(random());
+        }
+        parse(copy);
+    }
+}
+
+//---------- zipdir ----------
+
+struct ZipEntry {
+    std::string name;
+    std::string data;
+    uint16_t madeBy = 0x0314;
+    uint32_t external = 0100644u << 16;
+};
+
+//A zip of stored entries; zip64 adds the ZIP64 end records (with extensible bytes of extension data)
+static std::string make_zip(const std::vector<ZipEntry>& entries, bool zip64 = false, size_t extension = 0){
+    std::string body, directory;
+    for (const auto& entry : entries) {
+        uint32_t crc = checksum::crc32(entry.data.data(), entry.data.size());
+        uint64_t offset = body.size();
+        body += "PK\x03\x04";
+        put_le(body, 20, 2); put_le(body, 0x800, 2); put_le(body, 0, 2); put_le(body, 0x58210000, 4); put_le(body, crc, 4);
+        put_le(body, entry.data.size(), 4); put_le(body, entry.data.size(), 4); put_le(body, entry.name.size(), 2); put_le(body, 0, 2);
+        body += entry.name + entry.data;
+        directory += "PK\x01\x02";
+        put_le(directory, entry.madeBy, 2); put_le(directory, 20, 2); put_le(directory, 0x800, 2); put_le(directory, 0, 2);
+        put_le(directory, 0x58210000, 4); put_le(directory, crc, 4); put_le(directory, entry.data.size(), 4); put_le(directory, entry.data.size(), 4);
+        put_le(directory, entry.name.size(), 2); put_le(directory, 0, 2); put_le(directory, 0, 2); put_le(directory, 0, 2); put_le(directory, 0, 2);
+        put_le(directory, entry.external, 4); put_le(directory, offset, 4);
+        directory += entry.name;
+    }
+    std::string out = body + directory;
+    if (zip64) {
+        uint64_t record = out.size();
+        out += "PK\x06\x06";
+        put_le(out, 44 + extension, 8); put_le(out, 45, 2); put_le(out, 45, 2); put_le(out, 0, 4); put_le(out, 0, 4);
+        put_le(out, entries.size(), 8); put_le(out, entries.size(), 8); put_le(out, directory.size(), 8); put_le(out, body.size(), 8);
+        out += std::string(extension, 'e');
+        out += "PK\x06\x07";
+        put_le(out, 0, 4); put_le(out, record, 8); put_le(out, 1, 4);
+    }
+    out += "PK\x05\x06";
+    put_le(out, 0, 4);
+    put_le(out, zip64 ? 0xFFFF : entries.size(), 2); put_le(out, zip64 ? 0xFFFF : entries.size(), 2);
+    put_le(out, zip64 ? 0xFFFFFFFF : directory.size(), 4); put_le(out, zip64 ? 0xFFFFFFFF : body.size(), 4);
+    put_le(out, 0, 2);
+    return out;
+}
+
+static bool read_zip(const std::string& data, zipdir::Directory& directory){
+    return zipdir::read_directory(reinterpret_cast<const unsigned char*>(data.data()), data.size(), directory);
+}
+
+static void test_zipdir(){
+    std::vector<ZipEntry> entries = { { "dir/", "", 0x0314, 040755u << 16 }, { "dir/a.txt", "hello" }, { "b.bin", std::string(300, 'b') } };
+    std::string zip = make_zip(entries);
+    zipdir::Directory directory;
+    CHECK(read_zip(zip, directory));
+    CHECK(directory.entries.size() == 3 && directory.prefix == 0);
+    CHECK(zipdir::is_dir(directory.entries[0]) && zipdir::item_path(directory.entries[0]) == "dir");
+    CHECK(zipdir::item_path(directory.entries[1]) == "dir/a.txt");
+    CHECK(zipdir::attributes(directory.entries[1]) == ((0100644u << 16) | 0x8000u));
+    uint64_t offset = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(zip.data());
+    CHECK(zipdir::data_offset(bytes, zip.size(), directory.entries[1], offset) && zip.substr(offset, 5) == "hello");
+
+    //A self-extracting prefix moves every offset
+    std::string prefixed = std::string(1000, 'M') + zip;
+    CHECK(read_zip(prefixed, directory) && directory.prefix == 1000);
+    CHECK(zipdir::data_offset(reinterpret_cast<const unsigned char*>(prefixed.data()), prefixed.size(), directory.entries[2], offset));
+    CHECK(prefixed.substr(offset, 300) == std::string(300, 'b'));
+
+    //ZIP64 end records, with extension data and after a prefix
+    CHECK(read_zip(make_zip(entries, true), directory) && directory.entries.size() == 3);
+    CHECK(read_zip(make_zip(entries, true, 100), directory) && directory.entries.size() == 3);
+    std::string prefixed64 = std::string(777, 'M') + make_zip(entries, true, 40);
+    CHECK(read_zip(prefixed64, directory) && directory.entries.size() == 3 && directory.prefix == 777);
+    CHECK(zipdir::item_path(directory.entries[1]) == "dir/a.txt");
+
+    CHECK(!read_zip("not a zip at all, just some text which is long enough", directory));
+    mangle(zip, [](const std::string& data){
+        zipdir::Directory parsed;
+        if (read_zip(data, parsed)) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+            for (const auto& entry : parsed.entries) {
+                uint64_t position;
+                if (zipdir::data_offset(bytes, data.size(), entry, position)) {
+                    CHECK(position + entry.compressed <= data.size());
+                }
+                zipdir::item_path(entry);
+            }
+        }
+    });
+    mangle(make_zip(entries, true, 8), [](const std::string& data){
+        zipdir::Directory parsed;
+        read_zip(data, parsed);
+    });
+}
+
+static void test_zip_patches(){
+    std::string zip = make_zip({ { "a.txt", "hello" } });
+    zipdir::Directory directory;
+    CHECK(read_zip(zip, directory));
+    std::vector<zipdir::Patch> patches;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(zip.data());
+    CHECK(zipdir::metadata_patches(bytes, zip.size(), directory.entries[0], 1600000000, 0, 0x20, patches));
+    for (const auto& patch : patches) {
+        CHECK(patch.offset + patch.bytes.size() <= zip.size());
+        std::memcpy(&zip[patch.offset], patch.bytes.data(), patch.bytes.size());
+    }
+    CHECK(read_zip(zip, directory));
+    CHECK(directory.entries[0].host() == zipdir::kFAT && zipdir::attributes(directory.entries[0]) == 0x20);
+    CHECK(directory.entries[0].dosTime == zipdir::dos_time(1600000000));
+}
+
+//---------- tarnative ----------
+
+static std::string make_tar(const std::vector<std::pair<tarnative::Header, std::string>>& members){
+    std::vector<char> out;
+    for (const auto& member : members) {
+        tarnative::append_header(out, member.first);
+        out.insert(out.end(), member.second.begin(), member.second.end());
+        tarnative::append_padding(out, member.second.size());
+    }
+    tarnative::append_end(out);
+    return std::string(out.begin(), out.end());
+}
+
+//append_header writes sizes only for regular files: a pax record is written as one and retagged
+static std::string retag(std::string tar, size_t record, char type){
+    char* header = &tar[record];
+    header[156] = type;
+    std::memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (int i = 0; i < 512; ++i) {
+        sum += static_cast<unsigned char>(header[i]);
+    }
+    std::snprintf(header + 148, 8, "%06o", sum);
+    return tar;
+}
+
+static bool scan_tar(const std::string& data, std::vector<tarnative::Member>& members){
+    return tarnative::scan(reinterpret_cast<const unsigned char*>(data.data()), data.size(), members);
+}
+
+static tarnative::Header tar_header(const std::string& name, char type, uint64_t size, const std::string& link = std::string()){
+    tarnative::Header header;
+    header.name = name;
+    header.type = type;
+    header.size = size;
+    header.mode = type == '5' ? 0755 : 0644;
+    header.mtime = 1700000000;
+    header.link = link;
+    return header;
+}
+
+static void test_tarnative(){
+    std::string longName = std::string(150, 'n') + "/file";
+    std::string tar = make_tar({
+        { tar_header("dir/", '5', 0), "" },
+        { tar_header("dir/a.txt", '0', 5), "hello" },
+        { tar_header(longName, '0', 600), std::string(600, 'x') },
+        { tar_header("link", '2', 0, std::string(120, 't')), "" },
+        { tar_header("big", '0', 9000000000ull), "" },
+    });
+    //The size of "big" is written in base-256 but its data is missing: the scan must fail
+    std::vector<tarnative::Member> members;
+    CHECK(!scan_tar(tar, members));
+
+    tar = make_tar({
+        { tar_header("dir/", '5', 0), "" },
+        { tar_header("dir/a.txt", '0', 5), "hello" },
+        { tar_header(longName, '0', 600), std::string(600, 'x') },
+        { tar_header("link", '2', 0, std::string(120, 't')), "" },
+    });
+    CHECK(scan_tar(tar, members));
+    CHECK(members.size() == 4);
+    CHECK(members[0].header.type == '5' && members[0].header.name == "dir/");
+    CHECK(members[1].header.size == 5 && tar.substr(members[1].offset, 5) == "hello" && members[1].header.mtime == 1700000000);
+    CHECK(members[2].header.name == longName && members[2].stored == 600);
+    CHECK(members[3].header.type == '2' && members[3].header.link == std::string(120, 't'));
+
+    //A pax header overrides the path and the size
+    std::string pax = "29 path=pax/renamed/file.txt\n";
+    std::string paxTar = retag(make_tar({ { tar_header("PaxHeader", '0', pax.size()), pax }, { tar_header("short", '0', 3), "abc" } }), 0, 'x');
+    CHECK(scan_tar(paxTar, members) && members.size() == 1 && members[0].header.name == "pax/renamed/file.txt");
+    std::string badPax = "99999999999999999999999 path=x\n";
+    CHECK(!scan_tar(retag(make_tar({ { tar_header("PaxHeader", '0', badPax.size()), badPax }, { tar_header("f", '0', 0), "" } }), 0, 'x'), members));
+
+    //A wrong checksum is rejected
+    std::string corrupt = tar;
+    corrupt[512 + 10] ^= 1;
+    CHECK(!scan_tar(corrupt, members));
+
+    mangle(tar, [](const std::string& data){
+        std::vector<tarnative::Member> parsed;
+        if (scan_tar(data, parsed)) {
+            for (const auto& member : parsed) {
+                CHECK(member.offset + member.stored <= data.size());
+            }
+        }
+    });
+    mangle(paxTar, [](const std::string& data){
+        std::vector<tarnative::Member> parsed;
+        scan_tar(data, parsed);
+    });
+}
+
+//---------- streamsplit ----------
+
+static std::string gzip_member(const std::string& payload){
+    std::string out("\x1F\x8B\x08\x00\x00\x00\x00\x00\x00\x03", 10);
+    return out + payload;
+}
+
+static void test_member_splitter(){
+    std::string file;
+    for (int i = 0; i < 8; ++i) {
+        file += gzip_member(std::string(1000, static_cast<char>('a' + i)));
+    }
+    std::istringstream in(file);
+    streamsplit::MemberSplitter splitter(in, streamsplit::Kind::GZip, 1500);
+    std::vector<unsigned char> segment;
+    std::string joined;
+    size_t pieces = 0;
+    while (splitter.next(segment)) {
+        CHECK(streamsplit::is_gzip_header(segment.data(), segment.size()));
+        joined.append(segment.begin(), segment.end());
+        ++pieces;
+    }
+    CHECK(joined == file);
+    CHECK(pieces == 4);
+
+    //One member above the limit cannot be split
+    std::istringstream single(gzip_member(std::string(3 << 20, 'z')));
+    streamsplit::MemberSplitter tooLarge(single, streamsplit::Kind::GZip, 100, 1000);
+    bool thrown = false;
+    try {
+        while (tooLarge.next(segment)) {
+        }
+    } catch (const streamsplit::NotSplittable&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static std::string make_xz(const std::vector<std::pair<uint64_t, uint64_t>>& blocks){
+    std::vector<streamsplit::XzBlock> list;
+    std::string data;
+    for (const auto& block : blocks) {
+        streamsplit::XzBlock entry{};
+        entry.unpadded = block.first;
+        entry.uncompressed = block.second;
+        entry.flags = 0x0100;
+        list.push_back(entry);
+        data += std::string(static_cast<size_t>(entry.padded()), 'd');
+    }
+    std::vector<unsigned char> stream = streamsplit::make_xz_stream(list.data(), list.size(),
+                                                                    reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    return std::string(stream.begin(), stream.end());
+}
+
+static bool read_xz(const std::string& data, std::vector<streamsplit::XzBlock>& blocks){
+    std::istringstream in(data);
+    return streamsplit::read_xz_index(in, data.size(), blocks);
+}
+
+static void test_xz_index(){
+    std::string first = make_xz({ { 10, 100 }, { 21, 200 } });
+    std::string second = make_xz({ { 7, 50 } });
+    std::string file = first + std::string(8, '\0') + second;
+    std::vector<streamsplit::XzBlock> blocks;
+    CHECK(read_xz(file, blocks));
+    CHECK(blocks.size() == 3);
+    CHECK(blocks[0].offset == 12 && blocks[0].unpadded == 10 && blocks[0].uncompressed == 100 && blocks[0].stream == 0);
+    CHECK(blocks[1].offset == 24 && blocks[1].padded() == 24);
+    CHECK(blocks[2].stream == 1 && blocks[2].offset == first.size() + 8 + 12);
+
+    CHECK(!read_xz("plain text which is not xz at all.......", blocks));
+    mangle(file, [](const std::string& data){
+        std::vector<streamsplit::XzBlock> parsed;
+        if (read_xz(data, parsed)) {
+            for (const auto& block : parsed) {
+                CHECK(block.offset + block.padded() <= data.size());
+            }
+        }
+    });
+}
+
+//---------- blockcache ----------
+
+static BlockCache::Data block(size_t size, char fill){
+    return std::make_shared<const std::vector<char>>(size, fill);
+}
+
+static void test_blockcache(){
+    BlockCache cache(3 * (1000 + 128 + 1));
+    cache.put("a", block(1000, 'a'));
+    cache.put("b", block(1000, 'b'));
+    cache.put("c", block(1000, 'c'));
+    CHECK(cache.get("a") != nullptr);      //a becomes the most recently used
+    cache.put("d", block(1000, 'd'));       //b is evicted
+    CHECK(cache.get("b") == nullptr);
+    CHECK(cache.get("a") && cache.get("c") && cache.get("d"));
+    BlockCache::Stats stats = cache.stats();
+    CHECK(stats.entries == 3 && stats.used <= stats.capacity);
+
+    //A block larger than the capacity is not cached, and replacing a key keeps one entry
+    cache.put("huge", block(10000, 'h'));
+    CHECK(cache.get("huge") == nullptr);
+    cache.put("a", block(10, 'x'));
+    CHECK(cache.get("a")->size() == 10 && cache.stats().entries == 3);
+
+    //An evicted block stays valid for the reader which still holds it
+    BlockCache::Data held = cache.get("c");
+    cache.set_capacity(0);
+    CHECK(cache.stats().entries == 0 && cache.stats().used == 0);
+    CHECK(held->size() == 1000 && (*held)[0] == 'c');
+
+    //Tiny blocks are charged their bookkeeping, so many of them cannot exceed the capacity
+    cache.set_capacity(10000);
+    for (int i = 0; i < 1000; ++i) {
+        cache.put("tiny" + std::to_string(i), block(1, 't'));
+    }
+    CHECK(cache.stats().used <= 10000 && cache.stats().entries < 100);
+}
+
+//---------- pyos trees ----------
+
+static void test_trees(){
+    TempDir temp("trees");
+    std::string src = os::path::join(temp.path, "src");
+    for (int i = 0; i < 20; ++i) {
+        std::string dir = os::path::join(src, "d" + std::to_string(i), "sub");
+        CHECK(os::makedirs(dir));
+        CHECK(os::write_file(os::path::join(dir, "f.txt"), std::string(static_cast<size_t>(i), 'x')));
+    }
+    CHECK(os::makedirs(os::path::join(src, "empty")));
+
+    os::ScanOptions options;
+    options.threads = 4;
+    options.include_dirs = true;
+    std::vector<os::DirEntry> entries = os::scantree(src, options);
+    CHECK(entries.size() == 20 * 3 + 1);
+    for (const auto& entry : entries) {
+        if (entry.is_dir()) {
+            CHECK(entry.children == (os::path::basename(entry.path) == "empty" ? 0u : 1u));
+        }
+    }
+
+    std::string dst = os::path::join(temp.path, "dst");
+    os::TreeResult copied = os::copytree(src, dst, 4);
+    CHECK(copied.errors.empty() && copied.count == 20 * 3 + 1 && copied.bytes == 190);
+    CHECK(os::read_file(os::path::join(dst, "d7", "sub", "f.txt")) == std::string(7, 'x'));
+
+    os::TreeResult removed = os::rmtree(dst, 4);
+    CHECK(removed.errors.empty() && removed.count == 20 * 3 + 1 + 1 && !os::path::exists(dst));
+
+    //The copied directories get the modes of their sources once their children are written
+    std::string locked = os::path::join(src, "d3", "sub");
+    CHECK(::chmod(locked.c_str(), 0555) == 0);
+    copied = os::copytree(src, dst, 4);
+    struct stat st;
+    CHECK(copied.errors.empty() && ::stat(os::path::join(dst, "d3", "sub").c_str(), &st) == 0 && (st.st_mode & 07777) == 0555);
+    CHECK(os::read_file(os::path::join(dst, "d3", "sub", "f.txt")) == std::string(3, 'x'));
+    CHECK(::stat(os::path::join(dst, "d4", "sub").c_str(), &st) == 0 && (st.st_mode & 07777) != 0555);
+    ::chmod(locked.c_str(), 0755);
+    ::chmod(os::path::join(dst, "d3", "sub").c_str(), 0755);
+
+    //A missing root is not an error of the scan
+    CHECK(os::scantree(os::path::join(temp.path, "missing"), options).empty());
+}
+
+//---------- safepath ----------
+
+static bool write_output(safepath::Root& root, const std::string& rel, const std::string& data, bool commit = true,
+                         safepath::Existing existing = safepath::Existing::Replace){
+    safepath::Output out = root.create(rel, existing);
+    if (!out) {
+        return false;
+    }
+    bool ok = ::write(out.fd(), data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    return ok && (!commit || root.commit(out));
+}
+
+static void test_safepath(){
+    TempDir temp("safepath");
+    std::string outside = os::path::join(temp.path, "outside");
+    std::string outDir = os::path::join(temp.path, "out");
+    CHECK(os::makedirs(outside) && os::makedirs(outDir));
+    CHECK(os::write_file(os::path::join(outside, "target"), std::string("secret")));
+    safepath::Root root(outDir);
+    CHECK(root.valid());
+
+    std::vector<std::string> parts;
+    CHECK(safepath::split("./a//b/./c", parts) && parts.size() == 3 && parts[2] == "c");
+    CHECK(!safepath::split("a/../../x", parts) && !safepath::split("/etc/passwd", parts) && !safepath::split("./", parts));
+    CHECK(!write_output(root, "../escape", "x") && errno == EINVAL);
+
+    //A link on disk (or extracted before) is never followed, neither as a parent nor as the file itself
+    CHECK(::symlink(outside.c_str(), os::path::join(outDir, "d").c_str()) == 0);
+    CHECK(!write_output(root, "d/x", "x") && (errno == ELOOP || errno == ENOTDIR));
+    CHECK(!os::path::exists(os::path::join(outside, "x")));
+    CHECK(!root.make_dirs("d/sub") && !os::path::exists(os::path::join(outside, "sub")));
+    bool skipped = false;
+    CHECK(root.symlink("l", outside, safepath::Existing::Replace, skipped) && os::path::islink(os::path::join(outDir, "l")));
+    CHECK(!write_output(root, "l/x", "x") && !os::path::exists(os::path::join(outside, "x")));
+    CHECK(::symlink(os::path::join(outside, "target").c_str(), os::path::join(outDir, "f").c_str()) == 0);
+    CHECK(write_output(root, "f", "replaced"));
+    CHECK(!os::path::islink(os::path::join(outDir, "f")) && os::read_file(os::path::join(outDir, "f")) == "replaced");
+    CHECK(os::read_file(os::path::join(outside, "target")) == "secret");
+
+    //A hard link to a file outside is replaced, not written through
+    CHECK(::link(os::path::join(outside, "target").c_str(), os::path::join(outDir, "h").c_str()) == 0);
+    CHECK(write_output(root, "h", "new"));
+    CHECK(os::read_file(os::path::join(outside, "target")) == "secret" && os::read_file(os::path::join(outDir, "h")) == "new");
+
+    //An existing file keeps its content until the replacement is committed
+    std::string old = os::path::join(outDir, "old.txt");
+    CHECK(os::write_file(old, std::string("old")));
+    CHECK(write_output(root, "old.txt", "partial", false));
+    CHECK(os::read_file(old) == "old");
+    CHECK(os::listdir(outDir).size() == 5);  //d, l, f, h and old.txt: the temporary file is gone
+    CHECK(!write_output(root, "old.txt", "x", true, safepath::Existing::Fail) && errno == EEXIST);
+    safepath::Output skip = root.create("old.txt", safepath::Existing::Skip);
+    CHECK(!skip && skip.skipped());
+    CHECK(root.make_dirs("realdir") && !write_output(root, "realdir", "x") && errno == EISDIR);
+
+    //Only the created entries are removed
+    CHECK(write_output(root, "old.txt", "new"));
+    CHECK(write_output(root, "new/dir/file.txt", "created"));
+    CHECK(root.make_dirs("empty/dir"));
+    root.remove_created();
+    CHECK(os::read_file(old) == "new");
+    CHECK(!os::path::exists(os::path::join(outDir, "new")) && !os::path::exists(os::path::join(outDir, "empty")));
+    CHECK(!os::path::exists(os::path::join(outDir, "l")) && os::path::exists(os::path::join(outDir, "f")));
+}
+
+static void test_tar_extract(){
+    TempDir temp("tar_extract");
+    std::string outside = os::path::join(temp.path, "outside");
+    std::string outDir = os::path::join(temp.path, "out");
+    CHECK(os::makedirs(outside) && os::makedirs(outDir));
+    std::string tarPath = os::path::join(temp.path, "a.tar");
+    std::string tar = make_tar({
+        { tar_header("dir/", '5', 0), "" },
+        { tar_header("dir/a.txt", '0', 5), "hello" },
+        { tar_header("dir/sub/b.bin", '0', 700), std::string(700, 'b') },
+        { tar_header("keep.txt", '0', 3), "new" },
+    });
+    CHECK(os::write_file(tarPath, tar));
+    std::vector<tarnative::Member> members;
+    CHECK(scan_tar(tar, members) && tarnative::extractable(members));
+
+    //Links and paths which leave the output directory are left to 7-Zip
+    std::vector<tarnative::Member> other;
+    CHECK(scan_tar(make_tar({ { tar_header("link", '2', 0, "target"), "" } }), other) && !tarnative::extractable(other));
+    CHECK(scan_tar(make_tar({ { tar_header("../evil", '0', 1), "x" } }), other) && !tarnative::extractable(other));
+
+    tarnative::Fd archive(::open(tarPath.c_str(), O_RDONLY | O_CLOEXEC));
+    CHECK(os::write_file(os::path::join(outDir, "keep.txt"), std::string("old")));
+    {
+        safepath::Root root(outDir);
+        uint64_t copied = 0;
+        std::vector<std::string> names;
+        tarnative::extract(archive.get(), members, root, safepath::Existing::Skip,
+                           [&](const std::string& name){ names.push_back(name); }, [&](uint64_t bytes){ copied += bytes; });
+        CHECK(names.size() == 4 && copied == 708);
+        CHECK(os::read_file(os::path::join(outDir, "dir/a.txt")) == "hello");
+        CHECK(os::read_file(os::path::join(outDir, "dir/sub/b.bin")) == std::string(700, 'b'));
+        CHECK(os::read_file(os::path::join(outDir, "keep.txt")) == "old");
+        struct stat st;
+        CHECK(::stat(os::path::join(outDir, "dir/a.txt").c_str(), &st) == 0 && (st.st_mode & 0777) == 0644 && st.st_mtime == 1700000000);
+        CHECK(::stat(os::path::join(outDir, "dir").c_str(), &st) == 0 && st.st_mtime == 1700000000);
+    }
+
+    //A link on disk is not followed: the extraction fails and removes only what it created
+    os::rmtree(outDir);
+    CHECK(os::makedirs(outDir));
+    CHECK(os::write_file(os::path::join(outDir, "keep.txt"), std::string("old")));
+    CHECK(::symlink(outside.c_str(), os::path::join(outDir, "dir").c_str()) == 0);
+    {
+        safepath::Root root(outDir);
+        bool thrown = false;
+        try {
+            tarnative::extract(archive.get(), members, root, safepath::Existing::Replace, nullptr, nullptr);
+        } catch (const std::system_error&) {
+            thrown = true;
+            root.remove_created();
+        }
+        CHECK(thrown);
+        CHECK(os::listdir(outside).empty() && os::read_file(os::path::join(outDir, "keep.txt")) == "old");
+        CHECK(os::listdir(outDir).size() == 2);
+    }
+
+    //A range whose check fails is not committed: the existing file keeps its content and no temporary file is left
+    {
+        safepath::Root root(outDir);
+        bool thrown = false;
+        try {
+            tarnative::copy_range(archive.get(), members[1].offset, 5, root, "keep.txt", safepath::Existing::Replace, 0644, 0,
+                                  nullptr, [](){ throw std::runtime_error("CRC error"); });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown && os::read_file(os::path::join(outDir, "keep.txt")) == "old" && os::listdir(outDir).size() == 2);
+        CHECK(tarnative::copy_range(archive.get(), members[1].offset, 5, root, "copy/a.txt", safepath::Existing::Replace, 0600,
+                                    1600000000ll * 1000000000 + 5, nullptr));
+        struct stat st;
+        CHECK(::stat(os::path::join(outDir, "copy/a.txt").c_str(), &st) == 0 && (st.st_mode & 0777) == 0600 && st.st_mtime == 1600000000);
+        CHECK(os::read_file(os::path::join(outDir, "copy/a.txt")) == "hello");
+        root.remove_created();
+        CHECK(!os::path::exists(os::path::join(outDir, "copy")));
+    }
+}
+
+static void test_async_writer(){
+    TempDir temp("asyncwriter");
+    std::string outDir = os::path::join(temp.path, "out");
+    std::string outside = os::path::join(temp.path, "outside");
+    CHECK(os::makedirs(outDir) && os::makedirs(outside));
+    CHECK(::symlink(outside.c_str(), os::path::join(outDir, "link").c_str()) == 0);
+    CHECK(os::write_file(os::path::join(outDir, "keep.txt"), std::string("keep")));
+    {
+        safepath::Root root(outDir);
+        AsyncFileWriter writer(4, 1 << 20);
+        for (int i = 0; i < 50; ++i) {
+            uint64_t handle = writer.open_at(root, "dir" + std::to_string(i % 5) + "/f" + std::to_string(i), safepath::Existing::Replace);
+            writer.write(handle, std::vector<char>(1000, static_cast<char>('a' + i % 26)));
+            writer.close(handle, 1500000000);
+        }
+        uint64_t escape = writer.open_at(root, "link/evil", safepath::Existing::Replace);
+        writer.write(escape, std::vector<char>(10, 'e'));
+        writer.close(escape);
+        uint64_t kept = writer.open_at(root, "keep.txt", safepath::Existing::Skip);
+        writer.write(kept, std::vector<char>(10, 'k'));
+        writer.close(kept);
+        //Opened and never closed: the writer closes it when destroyed
+        uint64_t open = writer.open_at(root, "unfinished", safepath::Existing::Replace);
+        writer.write(open, std::vector<char>(10, 'u'));
+        writer.wait();
+        auto errors = writer.errors();
+        CHECK(errors.size() == 1 && errors[0].first == "link/evil");
+    }
+    CHECK(os::read_file(os::path::join(outDir, "dir3", "f13")) == std::string(1000, 'a' + 13));
+    CHECK(os::path::getmtime(os::path::join(outDir, "dir3", "f13")) == 1500000000);
+    CHECK(!os::path::exists(os::path::join(outside, "evil")) && os::read_file(os::path::join(outDir, "keep.txt")) == "keep");
+}
+
+int main(){
+    const std::vector<std::pair<const char*, void (*)()>> tests = {
+        { "zipdir", test_zipdir },
+        { "zip_patches", test_zip_patches },
+        { "tarnative", test_tarnative },
+        { "member_splitter", test_member_splitter },
+        { "xz_index", test_xz_index },
+        { "blockcache", test_blockcache },
+        { "trees", test_trees },
+        { "safepath", test_safepath },
+        { "tar_extract", test_tar_extract },
+        { "async_writer", test_async_writer },
+    };
+    for (const auto& test : tests) {
+        int before = failures;
+        test.second();
+        std::cout << (failures == before ? "ok   " : "FAIL ") << test.first << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}